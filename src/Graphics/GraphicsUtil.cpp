@@ -20,11 +20,17 @@
 #include "Settings.h"
 #include "Size.h"
 #include "Sound.h"
+#include "Texture.h"
 
 #include "DebugUtils.h"
 
 #define DEBUG_FLAG DEBUG_GRAPHICS
 
+// Define as 1 to periodically log texture atlas occupancy and texture binds per frame
+#define REPORT_TEXTURE_STATS 0
+
+const unsigned int GraphicsUtil::TEXTURE_STATS_REPORT_INTERVAL = 300;
+
 void GraphicsUtil::initialize()
 {
    m_window = nullptr;
@@ -37,6 +43,7 @@ void GraphicsUtil::initialize()
 
    m_currentXOffset = 0;
    m_currentYOffset = 0;
+   m_framesSinceStatsReport = 0;
 
    initSDL();
    initRocket();
@@ -198,6 +205,16 @@ Rocket::Core::Context* GraphicsUtil::createRocketContext(const std::string& name
 void GraphicsUtil::flipScreen()
 {
    SDL_GL_SwapWindow(m_window);
+
+#if REPORT_TEXTURE_STATS
+   if(++m_framesSinceStatsReport == TEXTURE_STATS_REPORT_INTERVAL)
+   {
+      DEBUG("Texture binds per frame: %.1f", Texture::getBindCount() / float(m_framesSinceStatsReport));
+      DEBUG("%s", m_textureAtlas.getReport().c_str());
+      Texture::resetBindCount();
+      m_framesSinceStatsReport = 0;
+   }
+#endif
 }
 
 bool GraphicsUtil::isVideoModeRefreshRequired() const
@@ -240,6 +257,11 @@ OpenGLExtensions& GraphicsUtil::getExtensions()
    return m_openGLExtensions;
 }
 
+TextureAtlas& GraphicsUtil::getTextureAtlas()
+{
+   return m_textureAtlas;
+}
+
 int GraphicsUtil::getWidth() const
 {
    return m_width;
@@ -13,6 +13,7 @@
 #include "RocketContextRegistry.h"
 #include "EdenRocketRenderInterface.h"
 #include "EdenRocketSystemInterface.h"
+#include "TextureAtlas.h"
 
 #include <memory>
 #include <tuple>
@@ -40,6 +41,9 @@ typedef unsigned int GLuint;
  */
 class GraphicsUtil final : public Singleton<GraphicsUtil>
 {
+   /** The number of frames between texture statistics reports */
+   static const unsigned int TEXTURE_STATS_REPORT_INTERVAL;
+
    /** The main window */
    SDL_Window* m_window;
 
@@ -49,6 +53,9 @@ class GraphicsUtil final : public Singleton<GraphicsUtil>
    /** The OpenGL Extensions */
    OpenGLExtensions m_openGLExtensions;
 
+   /** The atlas that shares textures between loaded images */
+   TextureAtlas m_textureAtlas;
+
    /** The render interface that Rocket will use. */
    EdenRocketRenderInterface m_rocketRenderInterface;
 
@@ -75,6 +82,9 @@ class GraphicsUtil final : public Singleton<GraphicsUtil>
    /** The y-offset to draw at (in pixels). */
    int m_currentYOffset;
 
+   /** The number of frames drawn since texture statistics were last reported */
+   unsigned int m_framesSinceStatsReport;
+
    /**
     * Initializes SDL audio and video bindings
     * Initializes SDL mixer and TTF libraries
@@ -123,6 +133,11 @@ class GraphicsUtil final : public Singleton<GraphicsUtil>
        * @return The extension manager for this graphical context.
        */
       OpenGLExtensions& getExtensions();
+
+      /**
+       * @return The texture atlas used to pack loaded images together.
+       */
+      TextureAtlas& getTextureAtlas();
    
       /**
        * @return The width of the screen
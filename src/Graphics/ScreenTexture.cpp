@@ -13,13 +13,17 @@
 #define DEBUG_FLAG DEBUG_GRAPHICS
 
 ScreenTexture::ScreenTexture() :
+   ScreenTexture(geometry::Size(GraphicsUtil::getInstance()->getWidth(), GraphicsUtil::getInstance()->getHeight()))
+{
+}
+
+ScreenTexture::ScreenTexture(const geometry::Size& size) :
    m_frameBuffer(0)
 {
-   auto graphics = GraphicsUtil::getInstance();
-   auto& extensions = graphics->getExtensions();
+   auto& extensions = GraphicsUtil::getInstance()->getExtensions();
 
    glGenTextures(1, &m_textureHandle);
-   m_size = geometry::Size(graphics->getWidth(), graphics->getHeight());
+   m_size = size;
    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
 
    glEnable(GL_TEXTURE_2D);
@@ -81,20 +85,71 @@ ScreenTexture ScreenTexture::create(GameState& gameState)
          gameState.activate();
       }
 
-      extensions.glBindFramebuffer(GL_FRAMEBUFFER, texture.m_frameBuffer);
-      extensions.glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.m_textureHandle, 0);
-      
-      gameState.drawFrame();
-
-      extensions.glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      texture.capture([&gameState]() { gameState.drawFrame(); });
 
       if(!wasActive)
       {
          gameState.deactivate();
       }
+   }
+
+   return texture;
+}
+
+ScreenTexture ScreenTexture::create(const geometry::Size& size, const std::function<void()>& drawFunc)
+{
+   ScreenTexture texture(size);
+
+   if(GraphicsUtil::getInstance()->getExtensions().isFrameBuffersEnabled())
+   {
+      texture.capture([&size, &drawFunc]()
+      {
+         // Set up the texture as a screen of its own, with the same orientation as the real screen
+         glPushAttrib(GL_VIEWPORT_BIT | GL_SCISSOR_BIT | GL_COLOR_BUFFER_BIT);
+         glDisable(GL_SCISSOR_TEST);
+         glViewport(0, 0, size.width, size.height);
 
-      texture.m_valid = true;
+         glMatrixMode(GL_PROJECTION);
+         glPushMatrix();
+         glLoadIdentity();
+         glOrtho(0.0f, (float)size.width, (float)size.height, 0.0f, -1, 1);
+
+         glMatrixMode(GL_MODELVIEW);
+         glPushMatrix();
+         glLoadIdentity();
+
+         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+         glClear(GL_COLOR_BUFFER_BIT);
+
+         drawFunc();
+
+         glPopMatrix();
+         glMatrixMode(GL_PROJECTION);
+         glPopMatrix();
+         glMatrixMode(GL_MODELVIEW);
+
+         glPopAttrib();
+      });
    }
 
    return texture;
 }
+
+void ScreenTexture::capture(const std::function<void()>& drawFunc)
+{
+   auto& extensions = GraphicsUtil::getInstance()->getExtensions();
+
+   // Captures can be nested (e.g. when a captured frame fills a cache of its own),
+   // so hand the previous frame buffer back when done instead of the screen.
+   GLint previousFrameBuffer = 0;
+   glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFrameBuffer);
+
+   extensions.glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+   extensions.glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_textureHandle, 0);
+
+   drawFunc();
+
+   extensions.glBindFramebuffer(GL_FRAMEBUFFER, previousFrameBuffer);
+
+   m_valid = true;
+}
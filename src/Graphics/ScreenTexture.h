@@ -9,10 +9,17 @@
 
 typedef unsigned int GLuint;
 
+#include <functional>
+
 #include "Texture.h"
 
 class GameState;
 
+namespace geometry
+{
+   struct Size;
+};
+
 /**
  * A texture created from a capture of the screen's state.
  * Call startCapture to redirect drawing operations to this
@@ -37,13 +44,29 @@ class ScreenTexture final : public Texture
        */
       GLuint m_frameBuffer;
 
+      /**
+       * Redirects the given drawing operations into the texture through its FBO.
+       * Whatever frame buffer was bound beforehand is bound again afterwards.
+       *
+       * @param drawFunc The drawing operations to capture.
+       */
+      void capture(const std::function<void()>& drawFunc);
+
    public:
       /**
        * Constructor.
-       * Initializes the FBO used to record the OpenGL drawing operations.
+       * Initializes a screen-sized texture and the FBO used to record the OpenGL drawing operations.
        */
       ScreenTexture();
 
+      /**
+       * Constructor.
+       * Initializes a texture of the given size and the FBO used to record the OpenGL drawing operations.
+       *
+       * @param size The size of the texture (in pixels).
+       */
+      explicit ScreenTexture(const geometry::Size& size);
+
       /**
        * Copying is disallowed.
        */
@@ -67,6 +90,16 @@ class ScreenTexture final : public Texture
        * captures it into the texture.
        */
       static ScreenTexture create(GameState& gameState);
+
+      /**
+       * Captures the given drawing operations into a texture of the given size.
+       * The drawing operations see the texture as a screen of its own, starting out
+       * clear and with no transformations applied.
+       *
+       * @param size The size of the texture (in pixels).
+       * @param drawFunc The drawing operations to capture.
+       */
+      static ScreenTexture create(const geometry::Size& size, const std::function<void()>& drawFunc);
 };
 
 #endif
@@ -0,0 +1,86 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "SpriteBatch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+#include "GraphicsUtil.h"
+#include "Texture.h"
+
+void SpriteBatch::add(Texture& texture, const geometry::Rectangle& source, const geometry::Rectangle& destination, int depth)
+{
+   m_quads.push_back({&texture, source, destination, depth});
+}
+
+void SpriteBatch::flush()
+{
+   if(m_quads.empty())
+   {
+      return;
+   }
+
+   std::stable_sort(m_quads.begin(), m_quads.end(), [](const Quad& lhs, const Quad& rhs)
+   {
+      return lhs.depth < rhs.depth || (lhs.depth == rhs.depth && std::less<Texture*>()(lhs.texture, rhs.texture));
+   });
+
+   m_vertices.clear();
+   m_vertices.reserve(m_quads.size() * 4);
+   for(const auto& quad : m_quads)
+   {
+      const geometry::Size& textureSize = quad.texture->getSize();
+
+      const float left = quad.source.left / float(textureSize.width);
+      const float right = quad.source.right / float(textureSize.width);
+      const float top = quad.source.top / float(textureSize.height);
+      const float bottom = quad.source.bottom / float(textureSize.height);
+
+      const auto& destination = quad.destination;
+      m_vertices.push_back({float(destination.left), float(destination.top), left, top});
+      m_vertices.push_back({float(destination.right), float(destination.top), right, top});
+      m_vertices.push_back({float(destination.right), float(destination.bottom), right, bottom});
+      m_vertices.push_back({float(destination.left), float(destination.bottom), left, bottom});
+   }
+
+   // NOTE: Alpha testing doesn't do transparency; it either draws a pixel or it doesn't
+   // If we want partial transparency, we would need to use alpha blending
+   glPushAttrib(GL_COLOR_BUFFER_BIT);
+   glEnable(GL_ALPHA_TEST);
+   glAlphaFunc(GL_GREATER, 0.1f);
+
+   glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+   const char* vertexData = reinterpret_cast<const char*>(m_vertices.data());
+   glVertexPointer(2, GL_FLOAT, sizeof(VertexBuffer::Vertex), vertexData + offsetof(VertexBuffer::Vertex, x));
+   glTexCoordPointer(2, GL_FLOAT, sizeof(VertexBuffer::Vertex), vertexData + offsetof(VertexBuffer::Vertex, u));
+
+   // Draw each run of quads that share a texture at once
+   std::size_t runStart = 0;
+   while(runStart < m_quads.size())
+   {
+      Texture* texture = m_quads[runStart].texture;
+
+      std::size_t runEnd = runStart + 1;
+      while(runEnd < m_quads.size() && m_quads[runEnd].texture == texture)
+      {
+         ++runEnd;
+      }
+
+      texture->bind();
+      glDrawArrays(GL_QUADS, runStart * 4, (runEnd - runStart) * 4);
+      runStart = runEnd;
+   }
+
+   glPopClientAttrib();
+   glPopAttrib();
+
+   m_quads.clear();
+}
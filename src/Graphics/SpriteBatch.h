@@ -0,0 +1,70 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <vector>
+
+#include "Rectangle.h"
+#include "VertexBuffer.h"
+
+class Texture;
+
+/**
+ * Collects textured quads (e.g. sprite frames) so that they can be drawn together.
+ * When the batch is flushed, the quads are ordered by depth (and by texture within
+ * the same depth), and each run of quads sharing a texture is drawn with a single call.
+ *
+ * Quads with the same depth and texture are drawn in the order they were added.
+ *
+ * @author Noam Chitayat
+ */
+class SpriteBatch final
+{
+   /**
+    * A quad waiting to be drawn.
+    */
+   struct Quad
+   {
+      /** The texture to draw the quad with */
+      Texture* texture;
+
+      /** The area of the texture to draw (in pixels) */
+      geometry::Rectangle source;
+
+      /** The area to draw the quad to */
+      geometry::Rectangle destination;
+
+      /** The depth of the quad (quads with a lower depth are drawn first) */
+      int depth;
+   };
+
+   /** The quads added since the last flush */
+   std::vector<Quad> m_quads;
+
+   /** Scratch space for the vertices of the quads being flushed */
+   std::vector<VertexBuffer::Vertex> m_vertices;
+
+   public:
+      /**
+       * Adds a quad to the batch.
+       *
+       * @param texture The texture to draw the quad with.
+       * @param source The area of the texture to draw (in pixels).
+       * @param destination The area to draw the quad to.
+       * @param depth The depth of the quad (quads with a lower depth are drawn first).
+       */
+      void add(Texture& texture, const geometry::Rectangle& source, const geometry::Rectangle& destination, int depth);
+
+      /**
+       * Draws all the quads added to the batch since the last flush, and empties the batch.
+       * Transparent parts of the quads' textures are not drawn.
+       */
+      void flush();
+};
+
+#endif
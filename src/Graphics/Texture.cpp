@@ -15,6 +15,8 @@
 
 #define DEBUG_FLAG DEBUG_GRAPHICS
 
+unsigned int Texture::bindCount = 0;
+
 Texture::Texture() = default;
 
 Texture::Texture(const std::string& imagePath)
@@ -120,6 +122,7 @@ void Texture::bind()
 {
    // Any texture ops on GL_TEXTURE_2D will become associated with this texture
    glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+   ++bindCount;
 }
 
 bool Texture::isValid() const
@@ -132,6 +135,16 @@ const geometry::Size& Texture::getSize() const
    return m_size;
 }
 
+unsigned int Texture::getBindCount()
+{
+   return bindCount;
+}
+
+void Texture::resetBindCount()
+{
+   bindCount = 0;
+}
+
 Texture::~Texture()
 {
    if(m_textureHandle != 0)
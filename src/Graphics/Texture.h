@@ -21,6 +21,9 @@ typedef unsigned int GLenum;
  */
 class Texture
 {
+   /** The number of texture binds since the count was last reset */
+   static unsigned int bindCount;
+
    protected:
       /** The texture handle */
       GLuint m_textureHandle = 0;
@@ -96,6 +99,16 @@ class Texture
        * @return the dimensions of the texture in pixels.
        */
       const geometry::Size& getSize() const;
+
+      /**
+       * @return The number of texture binds since the count was last reset.
+       */
+      static unsigned int getBindCount();
+
+      /**
+       * Resets the count of texture binds to 0.
+       */
+      static void resetBindCount();
 };
 
 #endif
@@ -0,0 +1,277 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include "SDL_image.h"
+
+#include "SkylinePacker.h"
+#include "Texture.h"
+
+#include "DebugUtils.h"
+
+#define DEBUG_FLAG DEBUG_GRAPHICS
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+const int TextureAtlas::PADDING = 1;
+const int TextureAtlas::MAX_PAGE_SIZE = 2048;
+
+struct TextureAtlas::Page
+{
+   /** The page texture */
+   Texture texture;
+
+   /** Tracks the free space on the page */
+   SkylinePacker packer;
+
+   /** The number of images on the page */
+   unsigned int regionCount = 0;
+
+   /** The number of pixels on the page used by images */
+   std::size_t usedArea = 0;
+
+   /**
+    * Constructor.
+    *
+    * @param size The size of the page (in pixels).
+    * @param repeatable true iff the page holds a single image that is tiled by wrapping its texture coordinates.
+    */
+   Page(const geometry::Size& size, bool repeatable) :
+      texture(nullptr, GL_RGBA, size, 4),
+      packer(size)
+   {
+      // Unless the image is meant to tile, keep images at the edges of the page from wrapping around to sample the opposite edge
+      const GLint wrapMode = repeatable ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+      texture.bind();
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+   }
+
+   /**
+    * Frees the area used by an image on the page.
+    * Once the page is empty, all of its space can be reused.
+    *
+    * @param bounds The area that held the image.
+    */
+   void release(const geometry::Rectangle& bounds)
+   {
+      usedArea -= bounds.getSize().getArea();
+      if(--regionCount == 0)
+      {
+         packer.clear();
+      }
+   }
+};
+
+namespace
+{
+   /**
+    * Copies RGBA image data into an area of a texture.
+    */
+   void uploadPixels(Texture& texture, const geometry::Point2D& location, const geometry::Size& size, const std::uint8_t* pixels, std::size_t pitch)
+   {
+      glPushAttrib(GL_TEXTURE_BIT);
+      glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / 4);
+
+      texture.bind();
+      glTexSubImage2D(GL_TEXTURE_2D, 0, location.x, location.y, size.width, size.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+      glPopClientAttrib();
+      glPopAttrib();
+   }
+};
+
+TextureAtlas::Region::Region() = default;
+
+TextureAtlas::Region::Region(const std::shared_ptr<Page>& page, const geometry::Rectangle& bounds) :
+   m_page(page),
+   m_bounds(bounds)
+{
+}
+
+TextureAtlas::Region::Region(Region&& rhs) :
+   m_page(std::move(rhs.m_page)),
+   m_bounds(rhs.m_bounds)
+{
+   rhs.m_page.reset();
+}
+
+TextureAtlas::Region& TextureAtlas::Region::operator=(Region&& rhs)
+{
+   std::swap(m_page, rhs.m_page);
+   std::swap(m_bounds, rhs.m_bounds);
+   return *this;
+}
+
+TextureAtlas::Region::~Region()
+{
+   if(m_page)
+   {
+      m_page->release(m_bounds);
+   }
+}
+
+bool TextureAtlas::Region::isValid() const
+{
+   return m_page != nullptr;
+}
+
+Texture& TextureAtlas::Region::getTexture() const
+{
+   return m_page->texture;
+}
+
+const geometry::Rectangle& TextureAtlas::Region::getBounds() const
+{
+   return m_bounds;
+}
+
+geometry::Size TextureAtlas::Region::getSize() const
+{
+   return m_bounds.getSize();
+}
+
+TextureAtlas::TextureAtlas() = default;
+
+TextureAtlas::~TextureAtlas() = default;
+
+TextureAtlas::Region TextureAtlas::load(const std::string& imagePath, bool repeatable)
+{
+   DEBUG("Loading image %s into the texture atlas...", imagePath.c_str());
+   SDL_Surface* image = IMG_Load(imagePath.c_str());
+   if(!image)
+   {
+      DEBUG("Unable to load image: %s", IMG_GetError());
+      return Region();
+   }
+
+   // Convert the image so that its bytes are in RGBA order, whatever the byte order of the machine
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+   SDL_Surface* rgbaImage = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA8888, 0);
+#else
+   SDL_Surface* rgbaImage = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ABGR8888, 0);
+#endif
+   SDL_FreeSurface(image);
+
+   if(!rgbaImage)
+   {
+      DEBUG("Unable to convert image: %s", SDL_GetError());
+      return Region();
+   }
+
+   Region region = add(static_cast<const std::uint8_t*>(rgbaImage->pixels), geometry::Size(rgbaImage->w, rgbaImage->h), rgbaImage->pitch, repeatable);
+   SDL_FreeSurface(rgbaImage);
+
+   return region;
+}
+
+TextureAtlas::Region TextureAtlas::add(const std::uint8_t* pixels, const geometry::Size& size, std::size_t pitch, bool repeatable)
+{
+   if(m_pageSize == 0)
+   {
+      // The page size can't be determined until there is a graphics context
+      GLint maxTextureSize = 0;
+      glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+      m_pageSize = std::min(MAX_PAGE_SIZE, static_cast<int>(maxTextureSize));
+   }
+
+   const geometry::Size paddedSize(size.width + 2 * PADDING, size.height + 2 * PADDING);
+   if(repeatable || static_cast<int>(paddedSize.width) > m_pageSize || static_cast<int>(paddedSize.height) > m_pageSize)
+   {
+      if(repeatable)
+      {
+         DEBUG("Image of size %dx%d may be repeated, so it can't share an atlas page.", size.width, size.height);
+      }
+      else
+      {
+         DEBUG("Image of size %dx%d is too large to share an atlas page.", size.width, size.height);
+      }
+
+      auto page = std::make_shared<Page>(size, repeatable);
+      uploadPixels(page->texture, geometry::Point2D::ORIGIN, size, pixels, pitch);
+
+      ++page->regionCount;
+      page->usedArea += size.getArea();
+
+      m_dedicatedPages.erase(
+         std::remove_if(m_dedicatedPages.begin(), m_dedicatedPages.end(), [](const std::weak_ptr<Page>& dedicatedPage) { return dedicatedPage.expired(); }),
+         m_dedicatedPages.end());
+      m_dedicatedPages.push_back(page);
+
+      return Region(page, geometry::Rectangle(geometry::Point2D::ORIGIN, size));
+   }
+
+   std::shared_ptr<Page> page;
+   geometry::Point2D location;
+   for(const auto& sharedPage : m_sharedPages)
+   {
+      if(sharedPage->packer.pack(paddedSize, location))
+      {
+         page = sharedPage;
+         break;
+      }
+   }
+
+   if(!page)
+   {
+      DEBUG("Adding texture atlas page %d (%dx%d).", static_cast<int>(m_sharedPages.size()), m_pageSize, m_pageSize);
+      page = std::make_shared<Page>(geometry::Size(m_pageSize, m_pageSize), false);
+      page->packer.pack(paddedSize, location);
+      m_sharedPages.push_back(page);
+   }
+
+   // Upload the image along with its (transparent) padding, since a reused page may hold old images there
+   std::vector<std::uint8_t> paddedPixels(paddedSize.getArea() * 4, 0);
+   const std::size_t paddedPitch = paddedSize.width * 4;
+   for(unsigned int y = 0; y < size.height; ++y)
+   {
+      std::memcpy(&paddedPixels[(y + PADDING) * paddedPitch + PADDING * 4], pixels + y * pitch, size.width * 4);
+   }
+
+   uploadPixels(page->texture, location, paddedSize, paddedPixels.data(), paddedPitch);
+
+   ++page->regionCount;
+   page->usedArea += size.getArea();
+
+   return Region(page, geometry::Rectangle(geometry::Point2D(location.x + PADDING, location.y + PADDING), size));
+}
+
+std::string TextureAtlas::getReport() const
+{
+   std::ostringstream report;
+   report << "Texture atlas: " << m_sharedPages.size() << " shared page(s) of " << m_pageSize << "x" << m_pageSize;
+
+   for(unsigned int i = 0; i < m_sharedPages.size(); ++i)
+   {
+      const auto& page = *m_sharedPages[i];
+      const auto pageArea = page.packer.getSize().getArea();
+      report << "\n  Page " << i << ": " << page.regionCount << " image(s), "
+             << (100.0 * page.usedArea / pageArea) << "% occupied";
+   }
+
+   for(const auto& dedicatedPage : m_dedicatedPages)
+   {
+      if(const auto page = dedicatedPage.lock())
+      {
+         const auto& size = page->packer.getSize();
+         report << "\n  Dedicated page: " << size.width << "x" << size.height;
+      }
+   }
+
+   return report.str();
+}
@@ -0,0 +1,163 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Rectangle.h"
+#include "Size.h"
+
+class Texture;
+
+/**
+ * Packs loaded images into large shared textures ("pages"), so that drawing
+ * images from different assets doesn't require binding a different texture
+ * for each one, and so that the quads for those images can be drawn together.
+ *
+ * Each image is handed back as a Region: the page texture, along with the
+ * area of the page that holds the image. Images that are too large to share
+ * a page, or that are tiled by wrapping their texture coordinates, get a page
+ * of their own.
+ *
+ * @author Noam Chitayat
+ */
+class TextureAtlas final
+{
+   /**
+    * A texture shared by a set of packed images.
+    */
+   struct Page;
+
+   /** The gap (in pixels) left around each image, so that filtering doesn't blend neighbouring images together. */
+   static const int PADDING;
+
+   /** The largest size of a shared page (in pixels), if the device supports it. */
+   static const int MAX_PAGE_SIZE;
+
+   /** The size of each shared page (in pixels). */
+   int m_pageSize = 0;
+
+   /** The pages shared between images. Pages are kept for reuse even while they are empty. */
+   std::vector<std::shared_ptr<Page>> m_sharedPages;
+
+   /** The pages holding a single image that was too large to share a page, or that may be repeated. */
+   std::vector<std::weak_ptr<Page>> m_dedicatedPages;
+
+   public:
+      /**
+       * An image packed into the atlas.
+       * The image's area of the atlas is freed for reuse when the Region is destroyed.
+       */
+      class Region final
+      {
+         friend class TextureAtlas;
+
+         /** The page holding the image. */
+         std::shared_ptr<Page> m_page;
+
+         /** The area of the page texture that holds the image (in pixels). */
+         geometry::Rectangle m_bounds;
+
+         /**
+          * Constructor.
+          *
+          * @param page The page holding the image.
+          * @param bounds The area of the page texture that holds the image (in pixels).
+          */
+         Region(const std::shared_ptr<Page>& page, const geometry::Rectangle& bounds);
+
+         public:
+            /**
+             * Default constructor.
+             * Creates an empty (invalid) region.
+             */
+            Region();
+
+            /**
+             * Disallow copying.
+             */
+            Region(const Region& rhs) = delete;
+            Region& operator=(const Region& rhs) = delete;
+
+            /**
+             * Move constructor and assignment.
+             */
+            Region(Region&& rhs);
+            Region& operator=(Region&& rhs);
+
+            /**
+             * Destructor. Frees the image's area of the page.
+             */
+            ~Region();
+
+            /**
+             * @return true iff this region holds an image.
+             */
+            bool isValid() const;
+
+            /**
+             * @return The texture of the page holding the image.
+             */
+            Texture& getTexture() const;
+
+            /**
+             * @return The area of the page texture that holds the image (in pixels).
+             */
+            const geometry::Rectangle& getBounds() const;
+
+            /**
+             * @return The size of the image (in pixels).
+             */
+            geometry::Size getSize() const;
+      };
+
+      /**
+       * Constructor.
+       */
+      TextureAtlas();
+
+      /**
+       * Destructor.
+       */
+      ~TextureAtlas();
+
+      /**
+       * Loads an image from file and packs it into the atlas.
+       *
+       * @param imagePath The path to the image to load.
+       * @param repeatable true iff the image may be drawn with texture coordinates outside of [0,1] to tile it.
+       *                   Such images get a page of their own, whose texture coordinates wrap around.
+       *
+       * @return The region holding the image, or an invalid region if the image could not be loaded.
+       */
+      Region load(const std::string& imagePath, bool repeatable = false);
+
+      /**
+       * Packs an image into the atlas.
+       *
+       * @param pixels The image data, with 4 bytes (RGBA) for each pixel.
+       * @param size The size of the image (in pixels).
+       * @param pitch The number of bytes in each row of the image data.
+       * @param repeatable true iff the image may be drawn with texture coordinates outside of [0,1] to tile it.
+       *                   Such images get a page of their own, whose texture coordinates wrap around.
+       *
+       * @return The region holding the image.
+       */
+      Region add(const std::uint8_t* pixels, const geometry::Size& size, std::size_t pitch, bool repeatable = false);
+
+      /**
+       * @return A description of the atlas pages and how much of each one is in use.
+       */
+      std::string getReport() const;
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "VertexBuffer.h"
+#include "GraphicsUtil.h"
+
+#include <cstddef>
+#include <utility>
+
+#include "DebugUtils.h"
+
+#define DEBUG_FLAG DEBUG_GRAPHICS
+
+VertexBuffer::VertexBuffer() = default;
+
+VertexBuffer::VertexBuffer(std::vector<Vertex> vertices) :
+   m_vertexCount(vertices.size())
+{
+   auto& extensions = GraphicsUtil::getInstance()->getExtensions();
+   if(!extensions.isBufferObjectsEnabled() || vertices.empty())
+   {
+      // Fall back to drawing straight from client memory.
+      m_vertices = std::move(vertices);
+      return;
+   }
+
+   DEBUG("Uploading %u vertices to a buffer object.", m_vertexCount);
+   extensions.glGenBuffers(1, &m_buffer);
+   extensions.glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+   extensions.glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(Vertex)), vertices.data(), GL_STATIC_DRAW);
+   extensions.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+VertexBuffer::VertexBuffer(VertexBuffer&& rhs) :
+   m_buffer(rhs.m_buffer),
+   m_vertexCount(rhs.m_vertexCount),
+   m_vertices(std::move(rhs.m_vertices))
+{
+   rhs.m_buffer = 0;
+   rhs.m_vertexCount = 0;
+}
+
+VertexBuffer& VertexBuffer::operator=(VertexBuffer&& rhs)
+{
+   std::swap(m_buffer, rhs.m_buffer);
+   std::swap(m_vertexCount, rhs.m_vertexCount);
+   std::swap(m_vertices, rhs.m_vertices);
+   return *this;
+}
+
+VertexBuffer::~VertexBuffer()
+{
+   if(m_buffer != 0)
+   {
+      GraphicsUtil::getInstance()->getExtensions().glDeleteBuffers(1, &m_buffer);
+   }
+}
+
+void VertexBuffer::draw(GLenum mode, unsigned int first, unsigned int count) const
+{
+   if(count == 0)
+   {
+      return;
+   }
+
+   auto& extensions = GraphicsUtil::getInstance()->getExtensions();
+
+   // With a buffer object bound, the vertex pointers are offsets into the buffer.
+   const char* vertexData = nullptr;
+   if(m_buffer != 0)
+   {
+      extensions.glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+   }
+   else
+   {
+      vertexData = reinterpret_cast<const char*>(m_vertices.data());
+   }
+
+   glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+   glVertexPointer(2, GL_FLOAT, sizeof(Vertex), vertexData + offsetof(Vertex, x));
+   glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), vertexData + offsetof(Vertex, u));
+
+   glDrawArrays(mode, first, count);
+
+   glPopClientAttrib();
+
+   if(m_buffer != 0)
+   {
+      extensions.glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
+unsigned int VertexBuffer::getVertexCount() const
+{
+   return m_vertexCount;
+}
@@ -0,0 +1,96 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef VERTEX_BUFFER_H
+#define VERTEX_BUFFER_H
+
+#include <vector>
+
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef float GLfloat;
+
+/**
+ * Holds a static set of textured 2D vertices for drawing.
+ * The vertices are uploaded to a buffer object on the graphics card when
+ * buffer objects are supported, and kept in client memory (as a vertex array) otherwise.
+ * Either way, any range of the vertices can be drawn with a single call.
+ *
+ * @author Noam Chitayat
+ */
+class VertexBuffer final
+{
+   public:
+      /**
+       * A vertex, with its location and texture coordinates.
+       */
+      struct Vertex
+      {
+         /** The location of the vertex */
+         GLfloat x, y;
+
+         /** The texture coordinates of the vertex */
+         GLfloat u, v;
+      };
+
+   private:
+      /** The buffer object handle (0 if buffer objects are not in use) */
+      GLuint m_buffer = 0;
+
+      /** The number of vertices in the buffer */
+      unsigned int m_vertexCount = 0;
+
+      /** The vertices, kept only when they could not be uploaded to a buffer object */
+      std::vector<Vertex> m_vertices;
+
+   public:
+      /**
+       * Default constructor.
+       * Creates an empty vertex buffer.
+       */
+      VertexBuffer();
+
+      /**
+       * Constructor.
+       * Uploads the given vertices to a buffer object, if buffer objects are supported.
+       *
+       * @param vertices The vertices to hold in the buffer.
+       */
+      explicit VertexBuffer(std::vector<Vertex> vertices);
+
+      /**
+       * Disallow copying.
+       */
+      VertexBuffer(const VertexBuffer& rhs) = delete;
+      VertexBuffer& operator=(const VertexBuffer& rhs) = delete;
+
+      /**
+       * Move constructor and assignment.
+       */
+      VertexBuffer(VertexBuffer&& rhs);
+      VertexBuffer& operator=(VertexBuffer&& rhs);
+
+      /**
+       * Destructor.
+       */
+      ~VertexBuffer();
+
+      /**
+       * Draws a range of the vertices with the currently bound texture.
+       *
+       * @param mode The primitive to draw with the vertices (e.g. GL_QUADS).
+       * @param first The index of the first vertex to draw.
+       * @param count The number of vertices to draw.
+       */
+      void draw(GLenum mode, unsigned int first, unsigned int count) const;
+
+      /**
+       * @return The number of vertices in the buffer.
+       */
+      unsigned int getVertexCount() const;
+};
+
+#endif
@@ -128,8 +128,14 @@ void Sprite::step(long timePassed)
    }
 }
 
-void Sprite::draw(const geometry::Point2D& point) const
+void Sprite::draw(SpriteBatch& batch, const geometry::Point2D& point, int depth) const
 {
    int indexToDraw = m_animation != nullptr ? m_animation->getIndex() : m_frameIndex;
-   m_sheet->draw(point, indexToDraw);
+   m_sheet->draw(batch, point, indexToDraw, depth);
+}
+
+geometry::Size Sprite::getSize() const
+{
+   int indexToDraw = m_animation != nullptr ? m_animation->getIndex() : m_frameIndex;
+   return m_sheet->getFrameSize(indexToDraw);
 }
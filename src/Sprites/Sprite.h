@@ -11,6 +11,7 @@
 #include <string>
 
 #include "Direction.h"
+#include "Size.h"
 
 namespace geometry
 {
@@ -18,6 +19,7 @@ namespace geometry
 };
 
 class Spritesheet;
+class SpriteBatch;
 class Animation;
 
 /**
@@ -102,9 +104,16 @@ class Sprite final
       /**
        * Draws the sprite at the specified location.
        *
+       * @param batch The sprite batch to draw the sprite with.
        * @param point The location to draw at.
+       * @param depth The depth to draw the sprite at (sprites with a lower depth are drawn first).
        */
-      void draw(const geometry::Point2D& point) const;
+      void draw(SpriteBatch& batch, const geometry::Point2D& point, int depth) const;
+
+      /**
+       * @return The size of the sprite's current frame (in pixels).
+       */
+      geometry::Size getSize() const;
 };
 
 #endif
@@ -10,6 +10,7 @@
 #include "Rectangle.h"
 #include "Point2D.h"
 #include "Animation.h"
+#include "SpriteBatch.h"
 #include <queue>
 #include <fstream>
 #include <sstream>
@@ -41,7 +42,12 @@ void Spritesheet::load(const std::string& path)
    imgPath += IMG_EXTENSION;
 
    DEBUG("Loading spritesheet image \"%s\"...", imgPath.c_str());
-   m_texture = Texture(imgPath);
+   m_texture = GraphicsUtil::getInstance()->getTextureAtlas().load(imgPath);
+   if(!m_texture.isValid())
+   {
+      T_T(std::string("Error loading spritesheet image: ") + imgPath);
+   }
+
    m_size = m_texture.getSize();
 
    // Load in the spritesheet data file, which tells the engine where
@@ -196,6 +202,16 @@ void Spritesheet::parseAnimations(Json::Value& rootElement)
    }
 }
 
+geometry::Size Spritesheet::getFrameSize(const int frameIndex) const
+{
+   if(frameIndex < 0 || frameIndex >= static_cast<int>(m_frameList.size()))
+   {
+      return geometry::Size();
+   }
+
+   return m_frameList[frameIndex].getSize();
+}
+
 int Spritesheet::getFrameIndex(const std::string& frameName) const
 {
    const auto& frameIndex = m_frameIndices.find(frameName);
@@ -219,7 +235,7 @@ std::unique_ptr<Animation> Spritesheet::getAnimation(const std::string& animatio
 }
 
 
-void Spritesheet::draw(const geometry::Point2D& point, const int frameIndex)
+void Spritesheet::draw(SpriteBatch& batch, const geometry::Point2D& point, const int frameIndex, int depth)
 {
    if(!isInitialized())
    {
@@ -228,7 +244,7 @@ void Spritesheet::draw(const geometry::Point2D& point, const int frameIndex)
       return;
    }
 
-   if(frameIndex < 0 || frameIndex > m_numFrames)
+   if(frameIndex < 0 || frameIndex >= static_cast<int>(m_frameList.size()))
    {
       DEBUG("Spritesheet frame index %d out of bounds!", frameIndex);
       return;
@@ -236,44 +252,8 @@ void Spritesheet::draw(const geometry::Point2D& point, const int frameIndex)
 
    const geometry::Rectangle& frame = m_frameList[frameIndex];
 
-   /**
-    * \todo We can do all these calculations when the frames are initialized
-    *       in order to optimize the drawing code a bit more!
-    */
-   const int frameHeight = frame.getHeight();
-   const int frameWidth = frame.getWidth();
-
-   float frameTop = frame.top / float(m_size.height);
-   float frameBottom = frame.bottom / float(m_size.height);
-   float frameLeft = frame.left / float(m_size.width);
-   float frameRight = frame.right / float(m_size.width);
-
-   float destLeft = float(point.x);
-   float destBottom = float(point.y);
-   float destRight = destLeft + frameWidth;
-   float destTop = destBottom - frameHeight;
-
-   // NOTE: Alpha testing doesn't do transparency; it either draws a pixel or it doesn't
-   // If we want partial transparency, we would need to use alpha blending
-
-   // Retain old alpha test state, function and threshold
-   glPushAttrib(GL_COLOR_BUFFER_BIT);
-
-   // Enable alpha testing
-   glEnable(GL_ALPHA_TEST);
-
-   // Set the alpha blending evaluation function
-   glAlphaFunc(GL_GREATER, 0.1f);
-
-   m_texture.bind();
-
-   glBegin(GL_QUADS);
-      glTexCoord2f(frameLeft, frameTop); glVertex3f(destLeft, destTop, 0.0f);
-      glTexCoord2f(frameRight, frameTop); glVertex3f(destRight, destTop, 0.0f);
-      glTexCoord2f(frameRight, frameBottom); glVertex3f(destRight, destBottom, 0.0f);
-      glTexCoord2f(frameLeft, frameBottom); glVertex3f(destLeft, destBottom, 0.0f);
-   glEnd();
-
-   // We're done with alpha testing, return to default state
-   glPopAttrib();
+   // Frames are drawn up and to the right of the given point
+   const geometry::Point2D destTopLeft(point.x, point.y - frame.getHeight());
+   const geometry::Rectangle& bounds = m_texture.getBounds();
+   batch.add(m_texture.getTexture(), frame.translate(bounds.left, bounds.top), geometry::Rectangle(destTopLeft, frame.getSize()), depth);
 }
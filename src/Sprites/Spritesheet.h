@@ -17,7 +17,7 @@
 #include "FrameSequence.h"
 #include "Rectangle.h"
 #include "Size.h"
-#include "Texture.h"
+#include "TextureAtlas.h"
 
 namespace Json
 {
@@ -31,6 +31,7 @@ namespace geometry
 
 struct SpriteFrame;
 class Animation;
+class SpriteBatch;
 
 /**
  * The Spritesheet class represents an entire spritesheet image. It holds a
@@ -56,8 +57,8 @@ class Spritesheet : public Resource
     */
    static const std::string UNTITLED_LINE;
 
-   /** The spritesheet texture */
-   Texture m_texture;
+   /** The spritesheet image, packed into the texture atlas */
+   TextureAtlas::Region m_texture;
 
    /** Spritesheet size (in pixels) */
    geometry::Size m_size;
@@ -108,12 +109,21 @@ class Spritesheet : public Resource
       Spritesheet(ResourceKey name);
 
       /**
-       * Draws a given frame at a specified location.
+       * Adds a given frame to a sprite batch, to be drawn at a specified location.
        *
-       * @param point The location to draw at.
+       * @param batch The batch to draw the frame with.
+       * @param point The location to draw at (the bottom-left corner of the frame).
        * @param frameIndex The frame to draw.
+       * @param depth The depth to draw the frame at (frames with a lower depth are drawn first).
        */
-      void draw(const geometry::Point2D& point, const int frameIndex);
+      void draw(SpriteBatch& batch, const geometry::Point2D& point, const int frameIndex, int depth);
+
+      /**
+       * @param frameIndex The frame to measure.
+       *
+       * @return The size of the frame (in pixels), or an empty size if there is no such frame.
+       */
+      geometry::Size getFrameSize(const int frameIndex) const;
 
       /**
        * Get the index of a frame specified by the frame name.
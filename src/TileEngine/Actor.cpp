@@ -53,6 +53,13 @@ const geometry::Size& Actor::getSize() const
    return m_size;
 }
 
+geometry::Rectangle Actor::getDrawBounds() const
+{
+   // Sprites are drawn up and to the right from the bottom-left corner of the actor's top-left tile.
+   const geometry::Size spriteSize = m_sprite ? m_sprite->getSize() : geometry::Size();
+   return geometry::Rectangle(geometry::Point2D(m_pixelLoc.x, m_pixelLoc.y + TileEngine::TILE_SIZE - spriteSize.height), spriteSize);
+}
+
 void Actor::step(long timePassed)
 {
    if(m_sprite)
@@ -70,11 +77,13 @@ void Actor::step(long timePassed)
    }
 }
 
-void Actor::draw() const
+void Actor::draw(SpriteBatch& batch) const
 {
    if(m_sprite)
    {
-      m_sprite->draw({ m_pixelLoc.x, m_pixelLoc.y + TileEngine::TILE_SIZE });
+      // Actors further down the map are drawn over the ones behind them
+      const int depth = m_pixelLoc.y + m_size.height;
+      m_sprite->draw(batch, { m_pixelLoc.x, m_pixelLoc.y + TileEngine::TILE_SIZE }, depth);
    }
 
    if(!m_orders.empty())
@@ -12,10 +12,12 @@
 #include <memory>
 
 #include "Point2D.h"
+#include "Rectangle.h"
 #include "Size.h"
 
 class EntityGrid;
 class Sprite;
+class SpriteBatch;
 class Spritesheet;
 class Task;
 
@@ -105,6 +107,11 @@ class Actor
        */
       const geometry::Size& getSize() const;
 
+      /**
+       * @return The area covered by this Actor's sprite when it is drawn (in pixels).
+       */
+      geometry::Rectangle getDrawBounds() const;
+
       /**
        * Performs a logic step of this NPC. During the step, the NPC works on
        * enqueued Instructions if there are any.
@@ -116,8 +123,10 @@ class Actor
       /**
        * This function draws the actor in its current location with its current
        * sprite animation frame.
+       *
+       * @param batch The sprite batch to draw the actor's sprite with.
        */
-      virtual void draw() const;
+      virtual void draw(SpriteBatch& batch) const;
 
       /**
        * @return true iff the NPC is not chewing on any instructions
@@ -6,11 +6,15 @@
 
 #include "Actor.h"
 
+#include <algorithm>
+#include <iterator>
 #include <math.h>
 #include "SDL_opengl.h"
 
 #include "ActorMoveOrder.h"
 #include "Direction.h"
+#include "FlowField.h"
+#include "PathQuery.h"
 #include "TileEngine.h"
 
 #include "DebugUtils.h"
@@ -19,6 +23,9 @@
 // Define as 1 to draw the NPC's projected path to the screen
 #define DRAW_PATH 0
 
+const unsigned int Actor::MoveOrder::ROUTE_LOOKAHEAD = 8;
+const unsigned int Actor::MoveOrder::MAX_WAITING_PLANS = 2;
+
 Actor::MoveOrder::MoveOrder(Actor& actor, const std::shared_ptr<Task>& task, const geometry::Point2D& destination, EntityGrid& entityGrid) :
    Order(actor),
    m_dst(destination),
@@ -29,10 +36,17 @@ Actor::MoveOrder::MoveOrder(Actor& actor, const std::shared_ptr<Task>& task, con
 
 Actor::MoveOrder::~MoveOrder()
 {
+   if(m_moverAdded)
+   {
+      m_entityGrid.removeMover(m_dst, m_actor.getSize());
+   }
+
    if(m_movementBegun)
    {
       m_entityGrid.abortMovement(&m_actor, m_lastWaypoint, m_nextWaypoint);
    }
+
+   m_entityGrid.releaseReservations(&m_actor);
 }
 
 void Actor::MoveOrder::updateDirection(geometry::Direction newDirection, bool moving)
@@ -73,6 +87,55 @@ void Actor::MoveOrder::updateNextWaypoint(geometry::Point2D location, geometry::
    }
 }
 
+bool Actor::MoveOrder::updateRoute(const geometry::Point2D& location, geometry::Point2D& goal)
+{
+   while(!m_route.empty() && m_route.front() == location)
+   {
+      m_route.pop_front();
+   }
+
+   if(m_route.empty() && m_flowField)
+   {
+      geometry::Point2D waypoint = location;
+      geometry::Point2D nextWaypoint;
+      for(unsigned int i = 0; i < ROUTE_LOOKAHEAD && m_flowField->getNextWaypoint(waypoint, nextWaypoint); ++i)
+      {
+         m_route.push_back(nextWaypoint);
+         waypoint = nextWaypoint;
+      }
+   }
+
+   if(m_route.empty())
+   {
+      return false;
+   }
+
+   const int movementTileSize = m_entityGrid.getMovementTileSize();
+   const auto getSteps = [movementTileSize](const geometry::Point2D& src, const geometry::Point2D& dst)
+   {
+      return static_cast<unsigned int>(std::max(abs(src.x - dst.x), abs(src.y - dst.y)) / movementTileSize);
+   };
+
+   // The plan may cut the corners of the route on its way to the goal, so the
+   // waypoints before the goal are dropped rather than left for the Actor to go back to.
+   auto goalWaypoint = m_route.begin();
+   unsigned int steps = getSteps(location, *goalWaypoint);
+   for(auto waypoint = std::next(goalWaypoint); waypoint != m_route.end(); ++waypoint)
+   {
+      steps += getSteps(*std::prev(waypoint), *waypoint);
+      if(steps > ROUTE_LOOKAHEAD)
+      {
+         break;
+      }
+
+      goalWaypoint = waypoint;
+   }
+
+   m_route.erase(m_route.begin(), goalWaypoint);
+   goal = m_route.front();
+   return true;
+}
+
 bool Actor::MoveOrder::perform(long timePassed)
 {
    geometry::Point2D location = m_actor.getLocation();
@@ -80,26 +143,54 @@ bool Actor::MoveOrder::perform(long timePassed)
    const float vel = m_actor.getMovementSpeed();
    m_cumulativeDistanceCovered +=timePassed * vel;
    long distanceCovered = 0;
+   bool replanned = false;
    if(m_cumulativeDistanceCovered > 1.0)
    {
 	   distanceCovered = floor(m_cumulativeDistanceCovered);
 	   m_cumulativeDistanceCovered -= distanceCovered;
    }
-   // If first run, get the best pre-computed path (RFW), end frame
+   // If first run
+   //      if other Actors are heading to the same destination, get the flow field they share
+   //      else get the best pre-computed route (RFW or hierarchical graph)
+   //      end frame
+   // If obstacles have changed since the flow field was built, get a new one
+   // If waiting on a rerouted path, end frame until it is found
    // loop infinitely
    //      if there is no next vertex
-   //          if Actor is at the destination
+   //          drop the route's vertex if it has been reached
+   //          if the route is empty and following a flow field
+   //             add the next few vertices of the flow field to the route
+   //          if a cooperative plan toward the vertex a few steps along the route can be made (reserving the next few steps)
+   //             if the last few plans have only waited in place
+   //                request a rerouted path (A* on a worker thread)
+   //                end frame
+   //             add its vertices to the path
+   //          else if the route has a next vertex
+   //             move it to the path
+   //          else if Actor is at the destination
    //             end task
+   //          else if the destination has been walled off
+   //             end order
    //          else
-   //             create a rerouted path (A*)
+   //             request a rerouted path (A* on a worker thread)
    //             end frame
    //
+   //      if the plan says to wait at the current vertex
+   //          wait for as long as a step would take
+   //          continue
+   //
    //      face next vertex
    //      if vertex isn't yet acquired
-   //          try acquire vertex
+   //          try acquire vertex (and every tile on the way to it)
    //          if acquire failed
-   //             create a rerouted path (A*)
-   //             end frame
+   //             if vertex is more than a tile away
+   //                add the first tile on the way to it to the path
+   //                continue
+   //             else if following a cooperative plan
+   //                plan again
+   //             else
+   //                request a rerouted path (A* on a worker thread)
+   //                end frame
    //
    //      if vertex is within step
    //          move to vertex
@@ -112,12 +203,38 @@ bool Actor::MoveOrder::perform(long timePassed)
 
    if(!m_pathInitialized)
    {
-      DEBUG("Finding an ideal path from %d,%d to %d,%d", location.x, location.y, m_dst.x, m_dst.y);
-      m_path = m_entityGrid.findBestPath(location, m_dst, m_actor.getSize());
-      if(m_path.empty())
+      if(!m_moverAdded)
       {
-         // If this path is blocked, then there must be a permanent obstruction.
-         return true;
+         m_entityGrid.addMover(m_dst, m_actor.getSize());
+         m_moverAdded = true;
+      }
+
+      // A flow field is only available if other Actors are heading to the same destination.
+      m_flowField = m_entityGrid.getFlowField(m_dst, m_actor.getSize());
+      if(m_flowField)
+      {
+         DEBUG("Following a shared flow field from %d,%d to %d,%d", location.x, location.y, m_dst.x, m_dst.y);
+         if(!m_flowField->isReachable(location))
+         {
+            // If there is no path through the static obstacles, then there must be a permanent obstruction.
+            return true;
+         }
+      }
+      else if(location != m_dst)
+      {
+         DEBUG("Finding an ideal path from %d,%d to %d,%d", location.x, location.y, m_dst.x, m_dst.y);
+         m_route = m_entityGrid.findBestPath(location, m_dst, m_actor.getSize());
+         if(m_route.empty())
+         {
+            if(m_entityGrid.hasPathData(m_actor.getSize()) || !m_entityGrid.isReachable(location, m_dst))
+            {
+               // If this path is blocked, then there must be a permanent obstruction.
+               return true;
+            }
+
+            // There is no path data to plan with yet, so have the workers search around everything instead.
+            m_pathQuery = m_entityGrid.requestReroutedPath(location, m_dst, m_actor.getSize());
+         }
       }
 
       // If a path was found, note that we have a path and end the frame
@@ -125,15 +242,84 @@ bool Actor::MoveOrder::perform(long timePassed)
       return false;
    }
 
+   if(m_flowField && m_flowField->getCollisionEpoch() != m_entityGrid.getCollisionEpoch())
+   {
+      // The field may lead through the new obstacles, so the route taken from it is dropped too,
+      // along with the steps toward it except for the waypoint being moved to.
+      // The loop below plans again from the new field.
+      DEBUG("Obstacles changed since the flow field to %d,%d was built. Getting a new one.", m_dst.x, m_dst.y);
+      m_flowField = m_entityGrid.getFlowField(m_dst, m_actor.getSize());
+      m_route.clear();
+      m_path.resize(m_movementBegun ? 1 : 0);
+   }
+
+   if(m_pathQuery)
+   {
+      if(!m_pathQuery->isReady())
+      {
+         // Stand still until the rerouted path has been found.
+         return false;
+      }
+
+      m_route = m_pathQuery->getPath();
+      m_pathQuery.reset();
+      m_followingPlan = false;
+   }
+
    for(;;)
    {
       if(m_path.empty())
       {
+         m_followingPlan = false;
+         geometry::Point2D goal;
+         if(location != m_dst && updateRoute(location, goal))
+         {
+            m_path = m_entityGrid.planCooperativePath(&m_actor, location, goal);
+            if(!m_path.empty())
+            {
+               const bool waiting = std::all_of(m_path.begin(), m_path.end(), [&location](const geometry::Point2D& waypoint)
+               {
+                  return waypoint == location;
+               });
+
+               m_waitingPlans = waiting ? m_waitingPlans + 1 : 0;
+               if(m_waitingPlans <= MAX_WAITING_PLANS)
+               {
+                  m_followingPlan = true;
+                  continue;
+               }
+
+               // The Actor is waiting on Actors that won't make way, or on a goal that the plans can't see
+               // a way to within their window (which can happen if the RFW matrices aren't available).
+               // Either way, it needs a route around them.
+               DEBUG("Waited too long for a way to %d,%d. Rerouting.", goal.x, goal.y);
+               m_waitingPlans = 0;
+               m_entityGrid.releaseReservations(&m_actor);
+               m_route.clear();
+               m_path.clear();
+               m_pathQuery = m_entityGrid.requestReroutedPath(location, m_dst, m_actor.getSize());
+               updateDirection(m_actor.getDirection(), false);
+               m_actor.setLocation(location);
+               return false;
+            }
+
+            // No plan could be made, so head straight for the next waypoint and reroute if it's taken.
+            m_path.push_back(m_route.front());
+            m_route.pop_front();
+            continue;
+         }
+
          updateDirection(m_actor.getDirection(), false);
          m_actor.setLocation(location);
          if(location != m_dst)
          {
-            m_path = m_entityGrid.findReroutedPath(location, m_dst, m_actor.getSize());
+            if(!m_entityGrid.isReachable(location, m_dst))
+            {
+               // An obstacle has since walled off the destination, so rerouting won't help.
+               return true;
+            }
+
+            m_pathQuery = m_entityGrid.requestReroutedPath(location, m_dst, m_actor.getSize());
             return false;
          }
 
@@ -145,12 +331,59 @@ bool Actor::MoveOrder::perform(long timePassed)
          return true;
       }
 
+      if(m_followingPlan && m_path.front() == location)
+      {
+         // The plan has the Actor wait for a step, to let another Actor pass.
+         if(m_waitDistance == 0)
+         {
+            m_waitDistance = m_entityGrid.getMovementTileSize();
+            updateDirection(m_actor.getDirection(), false);
+         }
+
+         if(distanceCovered < m_waitDistance)
+         {
+            m_waitDistance -= distanceCovered;
+            m_actor.setLocation(location);
+            return false;
+         }
+
+         distanceCovered -= m_waitDistance;
+         m_waitDistance = 0;
+         m_path.pop_front();
+         continue;
+      }
+
       if(!m_movementBegun)
       {
-         m_movementBegun = m_entityGrid.beginMovement(&m_actor, m_path.front());
+         m_movementBegun = m_entityGrid.beginMovement(&m_actor, location, m_path.front());
+         if(!m_movementBegun)
+         {
+            const geometry::Point2D firstStep = Pathfinder::getSegmentStep(location, m_path.front(), m_entityGrid.getMovementTileSize());
+            if(firstStep != m_path.front())
+            {
+               // The waypoint is several tiles away, and some tile along the way is taken.
+               // Try to make progress by moving a single tile along the same line.
+               m_path.push_front(firstStep);
+               continue;
+            }
+         }
+
+         if(!m_movementBegun && m_followingPlan && !replanned)
+         {
+            // Someone strayed from their reservations (or never made any), so plan again.
+            // The first step of the new plan is checked against the current locations of
+            // other entities, so planning more than once per frame would not help.
+            DEBUG("Planned waypoint %d,%d is taken. Planning again.", m_path.front().x, m_path.front().y);
+            replanned = true;
+            m_path.clear();
+            continue;
+         }
+
          if(!m_movementBegun)
          {
-            m_path = m_entityGrid.findReroutedPath(location, m_dst, m_actor.getSize());
+            m_route.clear();
+            m_path.clear();
+            m_pathQuery = m_entityGrid.requestReroutedPath(location, m_dst, m_actor.getSize());
             updateDirection(m_actor.getDirection(), false);
             m_actor.setLocation(location);
             return false;
@@ -10,6 +10,8 @@
 #include "ActorOrder.h"
 #include "EntityGrid.h"
 
+class FlowField;
+
 /**
  * An order that causes the Actor to move to a specified
  * destination point on the map.
@@ -18,12 +20,25 @@
  */
 class Actor::MoveOrder final : public Actor::Order
 {
+   /**
+    * How far along the route (in steps) the Actor plans toward. This is kept within the
+    * planning window, so that the search can find its way to the goal even when the
+    * heuristic leads it into a dead end.
+    */
+   static const unsigned int ROUTE_LOOKAHEAD;
+
+   /** The number of consecutive plans that may only wait in place before the Actor reroutes. */
+   static const unsigned int MAX_WAITING_PLANS;
+
    /**
     * Tracks if the move order has calculated a path from
     * the Actor's current location to the destination.
     */
    bool m_pathInitialized = false;
 
+   /** Tracks if the move order has been counted among the movers heading to its destination. */
+   bool m_moverAdded = false;
+
    /**
     * Tracks if the Actor has begun movement
     * towards the next node in its path.
@@ -44,9 +59,37 @@ class Actor::MoveOrder final : public Actor::Order
    /** The grid that the Actor is moving along. */
    EntityGrid& m_entityGrid;
 
-   /** The path that the Actor will use to get to the destination. */
+   /**
+    * The remaining waypoints of the route to the destination, found through the static obstacles
+    * (or around the entities, once rerouted). The Actor's steps toward each waypoint are planned
+    * cooperatively with the other moving Actors.
+    */
+   EntityGrid::Path m_route;
+
+   /** The waypoints that the Actor is moving through toward the next waypoint of its route. */
    EntityGrid::Path m_path;
 
+   /**
+    * The flow field leading to the destination, if other Actors are heading there too (nullptr otherwise).
+    * Whenever the route runs out, its next waypoint is taken from the field.
+    */
+   std::shared_ptr<const FlowField> m_flowField;
+
+   /** The pending request for a path around the entities blocking the Actor, if any. */
+   std::shared_ptr<const Pathfinder::PathQuery> m_pathQuery;
+
+   /**
+    * Tracks if the path was planned cooperatively with the other moving Actors,
+    * in which case a waypoint at the Actor's current location means that it waits there for a step.
+    */
+   bool m_followingPlan = false;
+
+   /** The number of consecutive plans that only had the Actor wait in place. */
+   unsigned int m_waitingPlans = 0;
+
+   /** The distance left to cover (in pixels) while waiting in place, if the Actor is waiting. */
+   long m_waitDistance = 0;
+
    /** Total distance for the character to move. */
    float m_cumulativeDistanceCovered = 0;
 
@@ -59,6 +102,17 @@ class Actor::MoveOrder final : public Actor::Order
    void updateDirection(geometry::Direction newDirection, bool moving);
    void updateNextWaypoint(geometry::Point2D location, geometry::Direction& direction);
 
+   /**
+    * Picks the waypoint of the route to plan toward, a few steps along the route,
+    * and drops the waypoints before it. The route is extended from the flow field as needed.
+    *
+    * @param location The current coordinates of the Actor (in pixels).
+    * @param goal Set to the waypoint to plan toward.
+    *
+    * @return true iff the route has a next waypoint.
+    */
+   bool updateRoute(const geometry::Point2D& location, geometry::Point2D& goal);
+
    public:
       /**
        * Constructor.
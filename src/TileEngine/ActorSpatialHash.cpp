@@ -0,0 +1,185 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "ActorSpatialHash.h"
+#include "Actor.h"
+#include "TileEngine.h"
+
+#include <algorithm>
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_ENTITY_GRID
+
+const int ActorSpatialHash::CELL_SIZE = TileEngine::TILE_SIZE * 4;
+
+int ActorSpatialHash::getCellCoordinate(int coordinate)
+{
+   // Round towards negative infinity, so that actors just outside the map get their own cells.
+   return coordinate >= 0 ? coordinate / CELL_SIZE : (coordinate - CELL_SIZE + 1) / CELL_SIZE;
+}
+
+std::uint64_t ActorSpatialHash::getCellKey(int cellX, int cellY)
+{
+   return (std::uint64_t(std::uint32_t(cellX)) << 32) | std::uint32_t(cellY);
+}
+
+std::uint64_t ActorSpatialHash::getCellKey(const geometry::Point2D& location)
+{
+   return getCellKey(getCellCoordinate(location.x), getCellCoordinate(location.y));
+}
+
+ActorSpatialHash::Entry ActorSpatialHash::removeEntry(std::uint64_t cellKey, const Actor* actor)
+{
+   std::vector<Entry>& cell = m_cells[cellKey];
+   const auto entryIter = std::find_if(cell.begin(), cell.end(), [actor](const Entry& entry) { return entry.actor == actor; });
+   const Entry entry = *entryIter;
+
+   cell.erase(entryIter);
+   if(cell.empty())
+   {
+      m_cells.erase(cellKey);
+   }
+
+   return entry;
+}
+
+template<typename Callback> void ActorSpatialHash::forEachEntryNear(const geometry::Rectangle& area, Callback callback) const
+{
+   // An actor can reach into the area from any cell up to one actor-size above or to the left of it.
+   const int left = getCellCoordinate(area.left - static_cast<int>(m_maxActorSize.width) + 1);
+   const int top = getCellCoordinate(area.top - static_cast<int>(m_maxActorSize.height) + 1);
+   const int right = getCellCoordinate(area.right - 1);
+   const int bottom = getCellCoordinate(area.bottom - 1);
+
+   for(int y = top; y <= bottom; ++y)
+   {
+      for(int x = left; x <= right; ++x)
+      {
+         const auto cellIter = m_cells.find(getCellKey(x, y));
+         if(cellIter == m_cells.end())
+         {
+            continue;
+         }
+
+         for(const auto& entry : cellIter->second)
+         {
+            callback(entry);
+         }
+      }
+   }
+}
+
+void ActorSpatialHash::clear()
+{
+   m_cells.clear();
+   m_actorCells.clear();
+   m_maxActorSize = geometry::Size();
+}
+
+void ActorSpatialHash::addActor(Actor* actor, const geometry::Point2D& location)
+{
+   removeActor(actor);
+
+   const geometry::Size& size = actor->getSize();
+   m_maxActorSize.width = std::max(m_maxActorSize.width, size.width);
+   m_maxActorSize.height = std::max(m_maxActorSize.height, size.height);
+
+   const std::uint64_t cellKey = getCellKey(location);
+   m_cells[cellKey].push_back({actor, location, size});
+   m_actorCells[actor] = cellKey;
+}
+
+void ActorSpatialHash::moveActor(const Actor* actor, const geometry::Point2D& location)
+{
+   const auto actorCellIter = m_actorCells.find(actor);
+   if(actorCellIter == m_actorCells.end())
+   {
+      return;
+   }
+
+   const std::uint64_t oldCellKey = actorCellIter->second;
+   const std::uint64_t newCellKey = getCellKey(location);
+   if(oldCellKey == newCellKey)
+   {
+      // Most moves stay within the same cell, so the entry can be updated in place.
+      for(auto& entry : m_cells[oldCellKey])
+      {
+         if(entry.actor == actor)
+         {
+            entry.location = location;
+            break;
+         }
+      }
+
+      return;
+   }
+
+   Entry entry = removeEntry(oldCellKey, actor);
+   entry.location = location;
+   m_cells[newCellKey].push_back(entry);
+   actorCellIter->second = newCellKey;
+}
+
+void ActorSpatialHash::removeActor(const Actor* actor)
+{
+   const auto actorCellIter = m_actorCells.find(actor);
+   if(actorCellIter == m_actorCells.end())
+   {
+      return;
+   }
+
+   removeEntry(actorCellIter->second, actor);
+   m_actorCells.erase(actorCellIter);
+}
+
+std::vector<Actor*> ActorSpatialHash::findActorsInArea(const geometry::Rectangle& area) const
+{
+   std::vector<Actor*> actors;
+   if(!area.isValid())
+   {
+      return actors;
+   }
+
+   forEachEntryNear(area, [&area, &actors](const Entry& entry)
+   {
+      // Rectangle::intersects also accepts rectangles that only share an edge, so test the overlap directly.
+      if(entry.location.x < area.right && area.left < entry.location.x + static_cast<int>(entry.size.width) &&
+            entry.location.y < area.bottom && area.top < entry.location.y + static_cast<int>(entry.size.height))
+      {
+         actors.push_back(entry.actor);
+      }
+   });
+
+   return actors;
+}
+
+std::vector<Actor*> ActorSpatialHash::findActorsInRadius(const geometry::Point2D& center, int radius) const
+{
+   std::vector<Actor*> actors;
+   if(radius < 0)
+   {
+      return actors;
+   }
+
+   const geometry::Rectangle searchArea(center.y - radius, center.x - radius, center.y + radius + 1, center.x + radius + 1);
+   const long long radiusSquared = static_cast<long long>(radius) * radius;
+
+   forEachEntryNear(searchArea, [&center, radiusSquared, &actors](const Entry& entry)
+   {
+      // Measure the distance from the center to the closest point of the actor's area.
+      const int right = entry.location.x + static_cast<int>(entry.size.width) - 1;
+      const int bottom = entry.location.y + static_cast<int>(entry.size.height) - 1;
+      const long long dx = std::max({entry.location.x - center.x, 0, center.x - right});
+      const long long dy = std::max({entry.location.y - center.y, 0, center.y - bottom});
+
+      if(dx * dx + dy * dy <= radiusSquared)
+      {
+         actors.push_back(entry.actor);
+      }
+   });
+
+   return actors;
+}
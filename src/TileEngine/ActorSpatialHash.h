@@ -0,0 +1,142 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ACTOR_SPATIAL_HASH_H
+#define ACTOR_SPATIAL_HASH_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Point2D.h"
+#include "Rectangle.h"
+#include "Size.h"
+
+class Actor;
+
+/**
+ * A spatial hash of the actors on a map. Actors are bucketed by the cell that
+ * their location falls in, so that finding the actors in an area or around a
+ * point only looks at the actors in the cells nearby, rather than at every
+ * actor (or every tile) on the map.
+ *
+ * @author Noam Chitayat
+ */
+class ActorSpatialHash final
+{
+   /** The size (in pixels) of each cell of the hash. */
+   static const int CELL_SIZE;
+
+   /**
+    * An actor in the hash, along with the area it covers.
+    */
+   struct Entry
+   {
+      /** The actor. */
+      Actor* actor;
+
+      /** The location of the actor (in pixels). */
+      geometry::Point2D location;
+
+      /** The size of the actor (in pixels). */
+      geometry::Size size;
+   };
+
+   /** The actors in each (non-empty) cell, keyed by the cell's coordinates. */
+   std::unordered_map<std::uint64_t, std::vector<Entry>> m_cells;
+
+   /** The key of the cell that each actor in the hash is in. */
+   std::unordered_map<const Actor*, std::uint64_t> m_actorCells;
+
+   /** The largest size of any actor added to the hash, which bounds how far an actor can reach outside of its cell. */
+   geometry::Size m_maxActorSize;
+
+   /**
+    * @param coordinate A coordinate (in pixels).
+    *
+    * @return The coordinate of the cell containing the given coordinate.
+    */
+   static int getCellCoordinate(int coordinate);
+
+   /**
+    * @param cellX The x-coordinate of a cell.
+    * @param cellY The y-coordinate of a cell.
+    *
+    * @return The key for the cell.
+    */
+   static std::uint64_t getCellKey(int cellX, int cellY);
+
+   /**
+    * @param location A location (in pixels).
+    *
+    * @return The key for the cell containing the location.
+    */
+   static std::uint64_t getCellKey(const geometry::Point2D& location);
+
+   /**
+    * Removes an actor's entry from a cell.
+    *
+    * @param cellKey The key of the cell containing the actor.
+    * @param actor The actor to remove.
+    *
+    * @return The removed entry.
+    */
+   Entry removeEntry(std::uint64_t cellKey, const Actor* actor);
+
+   /**
+    * Calls a function on every entry whose area might intersect with the given area.
+    *
+    * @param area The area to search (in pixels).
+    * @param callback The function to call on each entry.
+    */
+   template<typename Callback> void forEachEntryNear(const geometry::Rectangle& area, Callback callback) const;
+
+   public:
+      /**
+       * Removes every actor from the hash.
+       */
+      void clear();
+
+      /**
+       * Adds an actor to the hash. If the actor is already in the hash, it is moved instead.
+       *
+       * @param actor The actor to add.
+       * @param location The location of the actor (in pixels).
+       */
+      void addActor(Actor* actor, const geometry::Point2D& location);
+
+      /**
+       * Updates the location of an actor. Actors that aren't in the hash are ignored.
+       *
+       * @param actor The actor that moved.
+       * @param location The new location of the actor (in pixels).
+       */
+      void moveActor(const Actor* actor, const geometry::Point2D& location);
+
+      /**
+       * Removes an actor from the hash, if it is in the hash.
+       *
+       * @param actor The actor to remove.
+       */
+      void removeActor(const Actor* actor);
+
+      /**
+       * @param area The area to search (in pixels).
+       *
+       * @return The actors that overlap the area.
+       */
+      std::vector<Actor*> findActorsInArea(const geometry::Rectangle& area) const;
+
+      /**
+       * @param center The center of the search (in pixels).
+       * @param radius The radius of the search (in pixels).
+       *
+       * @return The actors with any part of their area within the radius of the center.
+       */
+      std::vector<Actor*> findActorsInRadius(const geometry::Point2D& center, int radius) const;
+};
+
+#endif
@@ -47,6 +47,12 @@ geometry::Point2D Camera::getPointWithinScene(const geometry::Point2D& point) co
    };
 }
 
+geometry::Rectangle Camera::getVisibleSceneBounds() const
+{
+   const geometry::Rectangle viewportBounds(getPointWithinScene(m_offset), m_viewportSize);
+   return viewportBounds.getIntersection(geometry::Rectangle(geometry::Point2D::ORIGIN, m_sceneSize));
+}
+
 geometry::Point2D Camera::getClampedPoint(const geometry::Point2D& point) const
 {
    return {
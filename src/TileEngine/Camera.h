@@ -8,6 +8,7 @@
 #define CAMERA_H
 
 #include "Point2D.h"
+#include "Rectangle.h"
 #include "Size.h"
 
 /**
@@ -70,6 +71,11 @@ class Camera
        */
       geometry::Point2D getPointWithinScene(const geometry::Point2D& point) const;
 
+      /**
+       * @return The area of the scene that is currently visible through the camera's viewport (in scene coordinates).
+       */
+      geometry::Rectangle getVisibleSceneBounds() const;
+
       /**
        * @param point The point to clamp.
        *
@@ -6,6 +6,8 @@
 
 #include "EntityGrid.h"
 
+#include <algorithm>
+
 #include "SDL_opengl.h"
 
 #include "Actor.h"
@@ -16,6 +18,7 @@
 #include "MapTriggerMessage.h"
 #include "MessagePipe.h"
 #include "Direction.h"
+#include "FlowField.h"
 #include "PlayerCharacter.h"
 #include "Point2D.h"
 #include "Rectangle.h"
@@ -29,16 +32,36 @@
 // Define as 1 to draw the entity grid's state instead of the map
 #define DRAW_ENTITY_GRID 0
 
-// Movement tile size can be set to a divisor of drawn tile size to increase the pathfinding graph size
-// For now, no need for the additional granularity
-const int EntityGrid::MOVEMENT_TILE_SIZE = 32;
+// Define as 1 to draw the map's background layers from pre-rendered chunks (when FBOs are supported)
+#define CACHE_MAP_BACKGROUND 1
 
 const float EntityGrid::ROOT_2 = 1.41421356f;
+const unsigned int EntityGrid::MAX_CACHED_FLOW_FIELDS = 8;
+const unsigned int EntityGrid::MIN_FLOW_FIELD_MOVERS = 2;
 const float EntityGrid::INFINITY = std::numeric_limits<float>::infinity();
+const int EntityGrid::MAX_CLEARANCE = 16;
+const unsigned int EntityGrid::NO_COMPONENT = 0;
+const unsigned int EntityGrid::UNLABELLED_COMPONENT = std::numeric_limits<unsigned int>::max();
+const unsigned int EntityGrid::RESERVATION_WINDOW = 8;
+
+namespace
+{
+   /**
+    * @param src The waypoint that a step starts at.
+    * @param dst The waypoint that a step ends at.
+    *
+    * @return The direction of the step, with each coordinate being -1, 0 or 1.
+    */
+   geometry::Point2D getStepDirection(const geometry::Point2D& src, const geometry::Point2D& dst)
+   {
+      return geometry::Point2D((dst.x > src.x) - (dst.x < src.x), (dst.y > src.y) - (dst.y < src.y));
+   }
+};
 
 EntityGrid::EntityGrid(const TileEngine& tileEngine, messaging::MessagePipe& messagePipe) :
    m_tileEngine(tileEngine),
-   m_messagePipe(messagePipe)
+   m_messagePipe(messagePipe),
+   m_movementTileSize(TileEngine::TILE_SIZE)
 {
    messagePipe.registerListener(this);
 }
@@ -53,7 +76,7 @@ geometry::Rectangle EntityGrid::getCollisionMapEdges(const geometry::Rectangle&
    const geometry::Point2D collisionMapTopLeft(area.left, area.top);
    const geometry::Point2D collisionMapBottomRight(area.right - 1, area.bottom - 1);
 
-   return geometry::Rectangle(collisionMapTopLeft / MOVEMENT_TILE_SIZE, collisionMapBottomRight / MOVEMENT_TILE_SIZE);
+   return geometry::Rectangle(collisionMapTopLeft / m_movementTileSize, collisionMapBottomRight / m_movementTileSize);
 }
 
 const geometry::Point2D& EntityGrid::getMapEntrance(const std::string& exitedMapName) const
@@ -76,12 +99,22 @@ void EntityGrid::setMapData(std::weak_ptr<const Map> mapData)
 {
    DEBUG("Resetting entity grid...");
    m_collisionMap.clear();
+   m_occupancyMap.clear();
+   m_clearanceMap.clear();
+   m_componentMap.clear();
+   m_flowFields.clear();
+   m_moverCounts.clear();
+   m_reservations.clear();
+   m_actorHash.clear();
+   m_backgroundCache.clear();
    m_map = mapData;
 
    std::shared_ptr<const Map> map(m_map.lock());
    if(!map) return;
 
-   const int collisionTileRatio = TileEngine::TILE_SIZE / MOVEMENT_TILE_SIZE;
+   // The map decides how finely its tiles are divided for collision and movement.
+   m_movementTileSize = map->getMovementTileSize();
+   const int collisionTileRatio = TileEngine::TILE_SIZE / m_movementTileSize;
 
    auto collisionMapSize = map->getBounds().getSize() * collisionTileRatio;
    m_collisionMapBounds = geometry::Rectangle(geometry::Point2D::ORIGIN, collisionMapSize);
@@ -90,16 +123,47 @@ void EntityGrid::setMapData(std::weak_ptr<const Map> mapData)
    const unsigned int collisionMapWidth = collisionMapSize.width;
 
    m_collisionMap.resize(collisionMapSize);
+   m_occupancyMap.resize(collisionMapSize);
    for(unsigned int x = 0; x < collisionMapWidth; ++x)
    {
       for(unsigned int y = 0; y < collisionMapHeight; ++y)
       {
-         bool passible = map->isPassible(x / collisionTileRatio, y / collisionTileRatio);
+         bool passible = map->isPassible(x, y);
          m_collisionMap(x, y).entityType = passible ? TileState::EntityType::FREE : TileState::EntityType::OBSTACLE;
+         m_occupancyMap.setSpan(y, x, x, !passible);
+      }
+   }
+
+   m_clearanceMap.resize(collisionMapSize, 0);
+   updateClearance(geometry::Rectangle(0, 0, collisionMapHeight - 1, collisionMapWidth - 1));
+
+   m_componentMap.resize(collisionMapSize, NO_COMPONENT);
+   m_nextComponent = NO_COMPONENT + 1;
+   for(unsigned int y = 0; y < collisionMapHeight; ++y)
+   {
+      for(unsigned int x = 0; x < collisionMapWidth; ++x)
+      {
+         if(m_collisionMap(x, y).entityType != TileState::EntityType::OBSTACLE)
+         {
+            m_componentMap(x, y) = UNLABELLED_COMPONENT;
+         }
+      }
+   }
+
+   for(unsigned int y = 0; y < collisionMapHeight; ++y)
+   {
+      for(unsigned int x = 0; x < collisionMapWidth; ++x)
+      {
+         if(m_componentMap(x, y) == UNLABELLED_COMPONENT)
+         {
+            labelComponent(geometry::Point2D(x, y), m_nextComponent++);
+         }
       }
    }
 
-   m_pathfinder.initialize(m_collisionMap, MOVEMENT_TILE_SIZE, m_collisionMapBounds);
+   DEBUG("Found %d connected regions in the entity grid.", m_nextComponent - NO_COMPONENT - 1);
+
+   m_pathfinder.initialize(m_collisionMap, m_occupancyMap, m_clearanceMap, m_componentMap, m_collisionEpoch, m_movementTileSize, m_collisionMapBounds);
    DEBUG("Entity grid initialized.");
 }
 
@@ -138,26 +202,165 @@ void EntityGrid::step(long timePassed)
    {
       map->step(timePassed);
    }
+
+   m_time += timePassed;
+
+   m_pathfinder.dispatchPathQueries();
+}
+
+bool EntityGrid::isReachable(const geometry::Point2D& src, const geometry::Point2D& dst) const
+{
+   if(m_componentMap.empty())
+   {
+      return false;
+   }
+
+   const geometry::Point2D sourceTile = src / m_movementTileSize;
+   const geometry::Point2D destinationTile = dst / m_movementTileSize;
+   if(!m_collisionMapBounds.contains(sourceTile) || !m_collisionMapBounds.contains(destinationTile))
+   {
+      return false;
+   }
+
+   const unsigned int component = m_componentMap(sourceTile.x, sourceTile.y);
+   return component != NO_COMPONENT && component == m_componentMap(destinationTile.x, destinationTile.y);
 }
 
 EntityGrid::Path EntityGrid::findBestPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size)
 {
-   return m_pathfinder.findBestPath(*this, src, dst, size);
+   return m_pathfinder.findBestPath(src, dst, size);
 }
 
-EntityGrid::Path EntityGrid::findReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size)
+bool EntityGrid::hasPathData(const geometry::Size& size) const
 {
-   return m_pathfinder.findReroutedPath(*this, src, dst, size);
+   return m_pathfinder.hasPathData(size);
+}
+
+EntityGrid::Path EntityGrid::findReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, Pathfinder::SearchAlgorithm algorithm)
+{
+   return m_pathfinder.findReroutedPath(src, dst, size, algorithm);
+}
+
+std::shared_ptr<const Pathfinder::PathQuery> EntityGrid::requestReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, Pathfinder::SearchAlgorithm algorithm)
+{
+   return m_pathfinder.requestReroutedPath(src, dst, size, algorithm);
+}
+
+EntityGrid::DestinationKey EntityGrid::getDestinationKey(const geometry::Point2D& dst, const geometry::Size& size) const
+{
+   const geometry::Point2D goalTile = dst / m_movementTileSize;
+   return DestinationKey(goalTile.x, goalTile.y, size.width, size.height);
+}
+
+void EntityGrid::addMover(const geometry::Point2D& dst, const geometry::Size& size)
+{
+   ++m_moverCounts[getDestinationKey(dst, size)];
+}
+
+void EntityGrid::removeMover(const geometry::Point2D& dst, const geometry::Size& size)
+{
+   const auto moverCount = m_moverCounts.find(getDestinationKey(dst, size));
+   if(moverCount != m_moverCounts.end() && --moverCount->second == 0)
+   {
+      m_moverCounts.erase(moverCount);
+   }
+}
+
+std::shared_ptr<const FlowField> EntityGrid::getFlowField(const geometry::Point2D& dst, const geometry::Size& size)
+{
+   if(m_collisionMap.empty())
+   {
+      return nullptr;
+   }
+
+   // Fields built before the obstacles last changed may lead through them. Movers still
+   // following one of them will notice the new epoch and ask for a new field.
+   m_flowFields.remove_if([this](const std::shared_ptr<FlowField>& flowField)
+   {
+      return flowField->getCollisionEpoch() != m_collisionEpoch;
+   });
+
+   const geometry::Point2D goalTile = dst / m_movementTileSize;
+   auto reusableField = m_flowFields.end();
+
+   for(auto iter = m_flowFields.begin(); iter != m_flowFields.end(); ++iter)
+   {
+      const auto& flowField = *iter;
+      if(flowField->getEntitySize() != size)
+      {
+         continue;
+      }
+
+      const geometry::Point2D fieldGoalTile = flowField->getGoal() / m_movementTileSize;
+      if(fieldGoalTile == goalTile)
+      {
+         m_flowFields.splice(m_flowFields.begin(), m_flowFields, iter);
+         return m_flowFields.front();
+      }
+
+      // A field can only be retargeted if nobody else is still following it to its old goal.
+      const bool adjacentGoal = abs(fieldGoalTile.x - goalTile.x) <= 1 && abs(fieldGoalTile.y - goalTile.y) <= 1;
+      if(adjacentGoal && flowField.use_count() == 1 && reusableField == m_flowFields.end())
+      {
+         reusableField = iter;
+      }
+   }
+
+   const auto moverCount = m_moverCounts.find(getDestinationKey(dst, size));
+   if(moverCount == m_moverCounts.end() || moverCount->second < MIN_FLOW_FIELD_MOVERS)
+   {
+      // Searching the whole map isn't worth it for a single mover.
+      return nullptr;
+   }
+
+   if(reusableField != m_flowFields.end() && (*reusableField)->moveGoal(dst))
+   {
+      m_flowFields.splice(m_flowFields.begin(), m_flowFields, reusableField);
+      return m_flowFields.front();
+   }
+
+   m_flowFields.push_front(std::make_shared<FlowField>(m_collisionMap, m_collisionMapBounds, m_movementTileSize, dst, size, m_collisionEpoch));
+
+   // Evict the least recently requested fields that are no longer being followed.
+   auto iter = m_flowFields.end();
+   while(m_flowFields.size() > MAX_CACHED_FLOW_FIELDS && iter != m_flowFields.begin())
+   {
+      --iter;
+      if(iter->use_count() == 1)
+      {
+         iter = m_flowFields.erase(iter);
+      }
+   }
+
+   return m_flowFields.front();
 }
 
 bool EntityGrid::addObstacle(const geometry::Point2D& location, const geometry::Size& size)
 {
-   return occupyArea(geometry::Rectangle(location, size), TileState(TileState::EntityType::OBSTACLE));
+   if(occupyArea(geometry::Rectangle(location, size), TileState(TileState::EntityType::OBSTACLE)))
+   {
+      const geometry::Rectangle obstacleTiles = getCollisionMapEdges(geometry::Rectangle(location, size));
+      splitComponents(obstacleTiles);
+      m_pathfinder.addObstacles(obstacleTiles);
+
+      // Flow fields only route around static obstacles, so they are all stale now.
+      // Movers still following one will get a new field (see getFlowField).
+      m_flowFields.clear();
+      return true;
+   }
+
+   return false;
 }
 
 bool EntityGrid::addActor(Actor* actor, const geometry::Point2D& area)
 {
-   return occupyArea(geometry::Rectangle(area, actor->getSize()), TileState(TileState::EntityType::ACTOR, actor));
+   if(occupyArea(geometry::Rectangle(area, actor->getSize()), TileState(TileState::EntityType::ACTOR, actor)))
+   {
+      m_actorHash.addActor(actor, area);
+      return true;
+   }
+
+   return false;
 }
 
 bool EntityGrid::changeActorLocation(Actor* actor, const geometry::Point2D& dst)
@@ -175,6 +378,8 @@ bool EntityGrid::changeActorLocation(Actor* actor, const geometry::Point2D& dst)
 
 void EntityGrid::removeActor(Actor* actor)
 {
+   m_reservations.release(actor);
+   m_actorHash.removeActor(actor);
    freeArea(geometry::Rectangle(actor->getLocation(), actor->getSize()));
 }
 
@@ -194,7 +399,7 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
       case geometry::Direction::LEFT:
       case geometry::Direction::DOWN_LEFT:
       {
-         adjacentLocation.x -= MOVEMENT_TILE_SIZE;
+         adjacentLocation.x -= actorSize.width;
          break;
       }
       case geometry::Direction::UP_RIGHT:
@@ -216,7 +421,7 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
       case geometry::Direction::UP:
       case geometry::Direction::UP_LEFT:
       {
-         adjacentLocation.y -= MOVEMENT_TILE_SIZE;
+         adjacentLocation.y -= actorSize.height;
          break;
       }
       case geometry::Direction::DOWN_LEFT:
@@ -232,26 +437,27 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
       }
    }
 
-   int rectLeft = std::max(0, adjacentLocation.x/MOVEMENT_TILE_SIZE);
-   int rectRight = std::min(m_collisionMapBounds.getWidth(), (adjacentLocation.x + actorSize.width - 1)/MOVEMENT_TILE_SIZE);
-   int rectTop = std::max(0, adjacentLocation.y/MOVEMENT_TILE_SIZE);
-   int rectBottom = std::min(m_collisionMapBounds.getHeight(), (adjacentLocation.y + actorSize.height - 1)/MOVEMENT_TILE_SIZE);
-
-   for(int rectY = rectTop; rectY <= rectBottom; ++rectY)
+   for(Actor* adjacentActor : m_actorHash.findActorsInArea(geometry::Rectangle(adjacentLocation, actorSize)))
    {
-      for(int rectX = rectLeft; rectX <= rectRight; ++rectX)
+      if(adjacentActor != actor)
       {
-         const TileState& collisionTile = m_collisionMap(rectX, rectY);
-         if(collisionTile.entityType == TileState::EntityType::ACTOR && collisionTile.entity != actor)
-         {
-            return static_cast<Actor*>(collisionTile.entity);
-         }
+         return adjacentActor;
       }
    }
 
    return nullptr;
 }
 
+std::vector<Actor*> EntityGrid::getActorsInArea(const geometry::Rectangle& area) const
+{
+   return m_actorHash.findActorsInArea(area);
+}
+
+std::vector<Actor*> EntityGrid::getActorsInRadius(const geometry::Point2D& center, int radius) const
+{
+   return m_actorHash.findActorsInRadius(center, radius);
+}
+
 bool EntityGrid::canOccupyArea(const geometry::Rectangle& area, TileState state) const
 {
    if(m_collisionMap.empty() || state.entityType == TileState::EntityType::FREE)
@@ -266,19 +472,25 @@ bool EntityGrid::canOccupyArea(const geometry::Rectangle& area, TileState state)
       return false;
    }
 
+   // Most areas are entirely free, which the clearance map can confirm with a single lookup.
+   if(hasClearance(areaRect))
+   {
+      return true;
+   }
+
    for(int collisionMapY = areaRect.top; collisionMapY <= areaRect.bottom; ++collisionMapY)
    {
-      for(int collisionMapX = areaRect.left; collisionMapX <= areaRect.right; ++collisionMapX)
+      // Only the tiles that aren't free need their states checked, and the occupancy map finds them a word at a time.
+      for(int collisionMapX = m_occupancyMap.findFirstSet(collisionMapY, areaRect.left, areaRect.right);
+          collisionMapX >= 0;
+          collisionMapX = m_occupancyMap.findFirstSet(collisionMapY, collisionMapX + 1, areaRect.right))
       {
          // We cannot occupy the point if it is reserved by an entity other than the entity attempting to occupy it.
          // For instance, we cannot occupy a tile already occupied by an obstacle or a different character.
          const TileState& collisionTile = m_collisionMap(collisionMapX, collisionMapY);
-         if(collisionTile.entityType != TileState::EntityType::FREE)
+         if(collisionTile.entityType != state.entityType || collisionTile.entity != state.entity)
          {
-            if(collisionTile.entityType != state.entityType || collisionTile.entity != state.entity)
-            {
-               return false;
-            }
+            return false;
          }
       }
    }
@@ -315,22 +527,122 @@ void EntityGrid::freeArea(const geometry::Point2D& previousLocation, const geome
    setArea(currentRect, state);
 }
 
+EntityGrid::Path EntityGrid::planCooperativePath(Actor* actor, const geometry::Point2D& location, const geometry::Point2D& dst)
+{
+   m_reservations.release(actor);
+
+   const float movementSpeed = actor->getMovementSpeed();
+   if(m_collisionMap.empty() || movementSpeed <= 0)
+   {
+      return Path();
+   }
+
+   const geometry::Size& size = actor->getSize();
+   const long stepDuration = std::max(1L, static_cast<long>(m_movementTileSize / movementSpeed));
+   Path path = m_pathfinder.findCooperativePath(location, dst, size, m_reservations, m_time, stepDuration, RESERVATION_WINDOW);
+   if(path.empty())
+   {
+      return path;
+   }
+
+   // Each step occupies both the tiles being left and the tiles being entered until the step is complete.
+   long stepStart = m_time;
+   geometry::Point2D previousWaypoint = location;
+   for(const auto& waypoint : path)
+   {
+      m_reservations.reserve(getCollisionMapEdges(geometry::Rectangle(previousWaypoint, size)), stepStart, stepStart + stepDuration, actor);
+      m_reservations.reserve(getCollisionMapEdges(geometry::Rectangle(waypoint, size)), stepStart, stepStart + stepDuration, actor);
+      previousWaypoint = waypoint;
+      stepStart += stepDuration;
+   }
+
+   // An Actor that arrives before the end of the window stays at its destination.
+   const long windowEnd = m_time + RESERVATION_WINDOW * stepDuration;
+   if(stepStart < windowEnd)
+   {
+      m_reservations.reserve(getCollisionMapEdges(geometry::Rectangle(previousWaypoint, size)), stepStart, windowEnd, actor);
+   }
+
+   // The rest of the window stays reserved, but is planned again (against
+   // newer reservations) before the Actor gets there.
+   const unsigned int stepsToFollow = (RESERVATION_WINDOW + 1) / 2;
+   while(path.size() > stepsToFollow)
+   {
+      path.pop_back();
+   }
+
+   // Consecutive steps in the same direction are merged into a single segment, which the Actor
+   // occupies all at once. A step is only merged if no one else has reserved its tiles at any
+   // point between the start of the segment and the end of the step.
+   Path mergedPath;
+   geometry::Point2D segmentStart = location;
+   long segmentStartTime = m_time;
+   unsigned int segmentSteps = 0;
+   stepStart = m_time;
+   previousWaypoint = location;
+   for(const auto& waypoint : path)
+   {
+      const long stepEnd = stepStart + stepDuration;
+      const geometry::Point2D stepDirection = getStepDirection(previousWaypoint, waypoint);
+
+      const bool continuesSegment = segmentSteps > 0 &&
+         segmentSteps * m_movementTileSize < Pathfinder::MAX_SEGMENT_LENGTH &&
+         stepDirection != geometry::Point2D(0, 0) &&
+         stepDirection == getStepDirection(segmentStart, previousWaypoint) &&
+         m_reservations.isAvailable(getCollisionMapEdges(geometry::Rectangle(waypoint, size)), segmentStartTime, stepEnd, actor);
+
+      if(continuesSegment)
+      {
+         mergedPath.back() = waypoint;
+         ++segmentSteps;
+      }
+      else
+      {
+         mergedPath.push_back(waypoint);
+         segmentStart = previousWaypoint;
+         segmentStartTime = stepStart;
+         segmentSteps = 1;
+      }
+
+      previousWaypoint = waypoint;
+      stepStart = stepEnd;
+   }
+
+   return mergedPath;
+}
+
+void EntityGrid::releaseReservations(const Actor* actor)
+{
+   m_reservations.release(actor);
+}
+
+int EntityGrid::getMovementTileSize() const
+{
+   return m_movementTileSize;
+}
+
+unsigned long EntityGrid::getCollisionEpoch() const
+{
+   return m_collisionEpoch;
+}
+
 bool EntityGrid::isAreaFree(const geometry::Rectangle& area) const
 {
    if(m_collisionMap.empty()) return false;
 
    geometry::Rectangle areaRect = getCollisionMapEdges(area);
 
-   for(int collisionMapY = areaRect.top; collisionMapY < areaRect.bottom; ++collisionMapY)
+   if(!m_collisionMapBounds.contains(areaRect))
+   {
+      return false;
+   }
+
+   for(int collisionMapY = areaRect.top; collisionMapY <= areaRect.bottom; ++collisionMapY)
    {
-      for(int collisionMapX = areaRect.left; collisionMapX < areaRect.right; ++collisionMapX)
+      // We cannot occupy the point if it is reserved by an obstacle or a character.
+      if(!m_occupancyMap.isSpanClear(collisionMapY, areaRect.left, areaRect.right))
       {
-         // We cannot occupy the point if it is reserved by an obstacle or a character.
-         const TileState& collisionTile = m_collisionMap(collisionMapX, collisionMapY);
-         if(collisionTile.entityType != TileState::EntityType::FREE)
-         {
-            return false;
-         }
+         return false;
       }
    }
 
@@ -347,24 +659,24 @@ bool EntityGrid::moveToClosestPoint(Actor* actor, int xDirection, int yDirection
    const geometry::Point2D& source = actor->getLocation();
    const geometry::Size& actorSize = actor->getSize();
 
-   const geometry::Size mapPixelSize = geometry::Size(m_collisionMapBounds.getWidth(), m_collisionMapBounds.getHeight()) * MOVEMENT_TILE_SIZE;
+   const geometry::Size mapPixelSize = geometry::Size(m_collisionMapBounds.getWidth(), m_collisionMapBounds.getHeight()) * m_movementTileSize;
 
    geometry::Point2D lastAvailablePoint = source;
 
    while(distance > 0)
    {
-      int distanceTraversed = std::min(distance, MOVEMENT_TILE_SIZE / 2);
+      int distanceTraversed = std::min(distance, m_movementTileSize / 2);
       distance -= distanceTraversed;
 
       // Get the next point for movement, and clamp it to the map Size
       geometry::Point2D nextPoint;
       nextPoint.x = lastAvailablePoint.x + xDirection * distanceTraversed;
       nextPoint.x = std::max(nextPoint.x, 0);
-      nextPoint.x = std::min(nextPoint.x, static_cast<int>(mapPixelSize.width) - MOVEMENT_TILE_SIZE);
+      nextPoint.x = std::min(nextPoint.x, static_cast<int>(mapPixelSize.width) - static_cast<int>(actorSize.width));
 
       nextPoint.y = lastAvailablePoint.y + yDirection * distanceTraversed;
       nextPoint.y = std::max(nextPoint.y, 0);
-      nextPoint.y = std::min(nextPoint.y, static_cast<int>(mapPixelSize.height) - MOVEMENT_TILE_SIZE);
+      nextPoint.y = std::min(nextPoint.y, static_cast<int>(mapPixelSize.height) - static_cast<int>(actorSize.height));
 
       if(lastAvailablePoint == nextPoint)
       {
@@ -412,36 +724,243 @@ bool EntityGrid::moveToClosestPoint(Actor* actor, int xDirection, int yDirection
    return false;
 }
 
-bool EntityGrid::beginMovement(Actor* actor, const geometry::Point2D& dst)
+bool EntityGrid::beginMovement(Actor* actor, const geometry::Point2D& src, const geometry::Point2D& dst)
 {
-   return occupyArea(geometry::Rectangle(dst, actor->getSize()), TileState(TileState::EntityType::ACTOR, actor));
+   const geometry::Size& size = actor->getSize();
+   const TileState actorState(TileState::EntityType::ACTOR, actor);
+
+   // Check the whole segment before occupying any of it, so that a blocked segment leaves the grid untouched.
+   for(geometry::Point2D step = src; step != dst;)
+   {
+      step = Pathfinder::getSegmentStep(step, dst, m_movementTileSize);
+      if(!canOccupyArea(geometry::Rectangle(step, size), actorState))
+      {
+         DEBUG("Couldn't occupy the segment from %d,%d to %d,%d (blocked at %d,%d)", src.x, src.y, dst.x, dst.y, step.x, step.y);
+         return false;
+      }
+   }
+
+   for(geometry::Point2D step = src; step != dst;)
+   {
+      step = Pathfinder::getSegmentStep(step, dst, m_movementTileSize);
+      setArea(getCollisionMapEdges(geometry::Rectangle(step, size)), actorState);
+   }
+
+   return true;
 }
 
 void EntityGrid::abortMovement(Actor* actor, const geometry::Point2D& src, const geometry::Point2D& dst)
 {
-   freeArea(src, actor->getLocation(), actor->getSize(), TileState(TileState::EntityType::ACTOR, actor));
-   freeArea(dst, actor->getLocation(), actor->getSize(), TileState(TileState::EntityType::ACTOR, actor));
+   const geometry::Size& size = actor->getSize();
+   for(geometry::Point2D step = src; step != dst; step = Pathfinder::getSegmentStep(step, dst, m_movementTileSize))
+   {
+      freeArea(geometry::Rectangle(step, size));
+   }
+
+   freeArea(dst, actor->getLocation(), size, TileState(TileState::EntityType::ACTOR, actor));
 }
 
 void EntityGrid::endMovement(Actor* actor, const geometry::Point2D& src, const geometry::Point2D& dst)
 {
-   freeArea(src, dst, actor->getSize(), TileState(TileState::EntityType::ACTOR, actor));
+   const geometry::Size& size = actor->getSize();
+   for(geometry::Point2D step = src; step != dst; step = Pathfinder::getSegmentStep(step, dst, m_movementTileSize))
+   {
+      freeArea(geometry::Rectangle(step, size));
+   }
+
+   setArea(getCollisionMapEdges(geometry::Rectangle(dst, size)), TileState(TileState::EntityType::ACTOR, actor));
 }
 
 void EntityGrid::setArea(const geometry::Rectangle& area, TileState state)
 {
    if(m_collisionMap.empty()) return;
 
+   bool obstaclesChanged = state.entityType == TileState::EntityType::OBSTACLE;
+   const bool occupied = state.entityType != TileState::EntityType::FREE;
    for(int collisionMapY = area.top; collisionMapY <= area.bottom; ++collisionMapY)
    {
       for(int collisionMapX = area.left; collisionMapX <= area.right; ++collisionMapX)
       {
-         m_collisionMap(collisionMapX, collisionMapY) = state;
+         TileState& tileState = m_collisionMap(collisionMapX, collisionMapY);
+         obstaclesChanged = obstaclesChanged || tileState.entityType == TileState::EntityType::OBSTACLE;
+         tileState = state;
       }
+
+      m_occupancyMap.setSpan(collisionMapY, area.left, area.right, occupied);
+   }
+
+   if(obstaclesChanged)
+   {
+      ++m_collisionEpoch;
+   }
+
+   m_pathfinder.markChanged(updateClearance(area));
+}
+
+std::uint8_t EntityGrid::calculateClearance(int x, int y) const
+{
+   if(m_collisionMap(x, y).entityType != TileState::EntityType::FREE)
+   {
+      return 0;
    }
+
+   const int width = m_collisionMapBounds.getWidth();
+   const int height = m_collisionMapBounds.getHeight();
+   const bool hasRight = x + 1 < width;
+   const bool hasBelow = y + 1 < height;
+
+   // The largest free square at this tile is one larger than the smallest of the squares to the right, below and diagonally below-right.
+   const int rightClearance = hasRight ? m_clearanceMap(x + 1, y) : 0;
+   const int belowClearance = hasBelow ? m_clearanceMap(x, y + 1) : 0;
+   const int diagonalClearance = hasRight && hasBelow ? m_clearanceMap(x + 1, y + 1) : 0;
+
+   return std::min(MAX_CLEARANCE, 1 + std::min(rightClearance, std::min(belowClearance, diagonalClearance)));
 }
 
-void EntityGrid::drawBackground(int y) const
+geometry::Rectangle EntityGrid::updateClearance(const geometry::Rectangle& area)
+{
+   const int width = m_collisionMapBounds.getWidth();
+   const int height = m_collisionMapBounds.getHeight();
+
+   // The top-left corner of the tiles whose clearance changed, along with the area.
+   int changedTop = area.top;
+   int changedLeftmost = area.left;
+
+   // The columns whose clearance changed in the row below the one being updated.
+   int changedLeft = width;
+   int changedRight = -1;
+
+   for(int y = std::min(area.bottom, height - 1); y >= 0; --y)
+   {
+      const bool rowInArea = y >= area.top;
+      const bool rowBelowChanged = changedLeft <= changedRight;
+      if(!rowInArea && !rowBelowChanged)
+      {
+         break;
+      }
+
+      // A tile's clearance can only change if the tile is in the area, or if the tile
+      // below it, below-right of it or to the right of it had its clearance changed.
+      int firstColumn = -1;
+      int lastColumn = width;
+      if(rowBelowChanged)
+      {
+         firstColumn = changedRight;
+         lastColumn = std::max(changedLeft - 1, 0);
+      }
+
+      if(rowInArea)
+      {
+         firstColumn = std::max(firstColumn, std::min(area.right, width - 1));
+         lastColumn = std::min(lastColumn, std::max(area.left, 0));
+      }
+
+      changedLeft = width;
+      changedRight = -1;
+
+      bool rightChanged = false;
+      for(int x = firstColumn; x >= 0 && (x >= lastColumn || rightChanged); --x)
+      {
+         const std::uint8_t clearance = calculateClearance(x, y);
+         rightChanged = clearance != m_clearanceMap(x, y);
+         if(rightChanged)
+         {
+            m_clearanceMap(x, y) = clearance;
+            changedLeft = x;
+            changedRight = std::max(changedRight, x);
+            changedTop = std::min(changedTop, y);
+            changedLeftmost = std::min(changedLeftmost, x);
+         }
+      }
+   }
+
+   return geometry::Rectangle(changedTop, changedLeftmost, std::min(area.bottom, height - 1), std::min(area.right, width - 1));
+}
+
+void EntityGrid::labelComponent(const geometry::Point2D& tile, unsigned int component)
+{
+   // Diagonal moves are only allowed when both adjacent straight moves are, so the
+   // regions are the same whether or not diagonal neighbours are considered.
+   static const int ADJACENT_OFFSETS[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+   const unsigned int previousComponent = m_componentMap(tile.x, tile.y);
+   if(previousComponent == component)
+   {
+      return;
+   }
+
+   std::vector<geometry::Point2D> tilesToVisit(1, tile);
+   m_componentMap(tile.x, tile.y) = component;
+
+   while(!tilesToVisit.empty())
+   {
+      const geometry::Point2D currentTile = tilesToVisit.back();
+      tilesToVisit.pop_back();
+
+      for(const auto& offset : ADJACENT_OFFSETS)
+      {
+         const geometry::Point2D adjacentTile(currentTile.x + offset[0], currentTile.y + offset[1]);
+         if(m_collisionMapBounds.contains(adjacentTile) && m_componentMap(adjacentTile.x, adjacentTile.y) == previousComponent)
+         {
+            m_componentMap(adjacentTile.x, adjacentTile.y) = component;
+            tilesToVisit.push_back(adjacentTile);
+         }
+      }
+   }
+}
+
+void EntityGrid::splitComponents(const geometry::Rectangle& area)
+{
+   for(int y = area.top; y <= area.bottom; ++y)
+   {
+      for(int x = area.left; x <= area.right; ++x)
+      {
+         m_componentMap(x, y) = NO_COMPONENT;
+      }
+   }
+
+   // Every piece of a region split by the obstacle borders the obstacle,
+   // so relabelling from each bordering tile gives each piece its own label.
+   // Pieces that are still connected are relabelled once and then skipped.
+   const unsigned int firstNewComponent = m_nextComponent;
+   const auto relabel = [this, firstNewComponent](int x, int y)
+   {
+      if(m_collisionMapBounds.contains(geometry::Point2D(x, y)))
+      {
+         const unsigned int component = m_componentMap(x, y);
+         if(component != NO_COMPONENT && component < firstNewComponent)
+         {
+            labelComponent(geometry::Point2D(x, y), m_nextComponent++);
+         }
+      }
+   };
+
+   for(int x = area.left; x <= area.right; ++x)
+   {
+      relabel(x, area.top - 1);
+      relabel(x, area.bottom + 1);
+   }
+
+   for(int y = area.top; y <= area.bottom; ++y)
+   {
+      relabel(area.left - 1, y);
+      relabel(area.right + 1, y);
+   }
+}
+
+bool EntityGrid::hasClearance(const geometry::Rectangle& area) const
+{
+   const int areaSize = std::max(area.right - area.left, area.bottom - area.top) + 1;
+   return m_clearanceMap(area.left, area.top) >= areaSize;
+}
+
+int EntityGrid::getMaxHeightOffset() const
+{
+   std::shared_ptr<const Map> map(m_map.lock());
+   return map ? map->getMaxHeightOffset() : 0;
+}
+
+void EntityGrid::drawBackground(const geometry::Rectangle& area) const
 {
    std::shared_ptr<const Map> map(m_map.lock());
    if(!map)
@@ -451,78 +970,95 @@ void EntityGrid::drawBackground(int y) const
 
    if(DRAW_ENTITY_GRID)
    {
-      for(unsigned int x = 0; x < m_collisionMapBounds.getWidth(); ++x)
+      const int movementTilesPerTile = TileEngine::TILE_SIZE / m_movementTileSize;
+      const int firstRow = std::max(area.top * movementTilesPerTile, 0);
+      const int lastRow = std::min(area.bottom * movementTilesPerTile, static_cast<int>(m_collisionMapBounds.getHeight()));
+      const int firstColumn = std::max(area.left * movementTilesPerTile, 0);
+      const int lastColumn = std::min(area.right * movementTilesPerTile, static_cast<int>(m_collisionMapBounds.getWidth()));
+
+      for(int y = firstRow; y < lastRow; ++y)
       {
-         float destLeft = float(x * MOVEMENT_TILE_SIZE);
-         float destRight = float((x + 1) * MOVEMENT_TILE_SIZE);
-         float destTop = float(y * MOVEMENT_TILE_SIZE);
-         float destBottom = float((y + 1) * MOVEMENT_TILE_SIZE);
+         for(int x = firstColumn; x < lastColumn; ++x)
+         {
+            float destLeft = float(x * m_movementTileSize);
+            float destRight = float((x + 1) * m_movementTileSize);
+            float destTop = float(y * m_movementTileSize);
+            float destBottom = float((y + 1) * m_movementTileSize);
 
-         glDisable(GL_TEXTURE_2D);
-         glBegin(GL_QUADS);
+            glDisable(GL_TEXTURE_2D);
+            glBegin(GL_QUADS);
 
-         switch(m_collisionMap(x, y).entityType)
-         {
-            case TileState::EntityType::FREE:
-            {
-               glColor3f(0.0f, 0.5f, 0.0f);
-               break;
-            }
-            case TileState::EntityType::ACTOR:
+            switch(m_collisionMap(x, y).entityType)
             {
-               if(m_collisionMap(x, y).entity == nullptr)
+               case TileState::EntityType::FREE:
                {
-                  glColor3f(0.5f, 0.0f, 0.0f);
+                  glColor3f(0.0f, 0.5f, 0.0f);
+                  break;
                }
-               else
+               case TileState::EntityType::ACTOR:
                {
-                  glColor3f(0.0f, 0.0f, 0.5f);
+                  if(m_collisionMap(x, y).entity == nullptr)
+                  {
+                     glColor3f(0.5f, 0.0f, 0.0f);
+                  }
+                  else
+                  {
+                     glColor3f(0.0f, 0.0f, 0.5f);
+                  }
+                  break;
+               }
+               case TileState::EntityType::OBSTACLE:
+               default:
+               {
+                  glColor3f(0.5f, 0.5f, 0.0f);
+                  break;
                }
-               break;
-            }
-            case TileState::EntityType::OBSTACLE:
-            default:
-            {
-               glColor3f(0.5f, 0.5f, 0.0f);
-               break;
             }
-         }
 
-         glVertex3f(destLeft, destTop, 0.0f);
-         glVertex3f(destRight, destTop, 0.0f);
-         glVertex3f(destRight, destBottom, 0.0f);
-         glVertex3f(destLeft, destBottom, 0.0f);
-         glColor3f(1.0f, 1.0f, 1.0f);
-         glEnd();
-         glEnable(GL_TEXTURE_2D);
+            glVertex3f(destLeft, destTop, 0.0f);
+            glVertex3f(destRight, destTop, 0.0f);
+            glVertex3f(destRight, destBottom, 0.0f);
+            glVertex3f(destLeft, destBottom, 0.0f);
+            glColor3f(1.0f, 1.0f, 1.0f);
+            glEnd();
+            glEnable(GL_TEXTURE_2D);
+         }
       }
    }
+   else if(CACHE_MAP_BACKGROUND && MapBackgroundCache::isSupported())
+   {
+      m_backgroundCache.draw(*map, area);
+   }
    else
    {
-      map->drawBackground(y);
+      map->drawBackground(area);
    }
 }
 
-void EntityGrid::drawForeground(int y) const
+void EntityGrid::drawForeground(int y, const geometry::Rectangle& area) const
 {
    std::shared_ptr<const Map> map(m_map.lock());
    if(map)
    {
-      map->drawForeground(y);
+      map->drawForeground(y, area);
    }
 }
 
 void EntityGrid::receive(const ActorMoveMessage& message)
 {
+   m_actorHash.moveActor(message.movingActor, message.newLocation);
+
    std::shared_ptr<const Map> map(m_map.lock());
    if(!map)
    {
       return;
    }
 
+   // Only the zones sharing an index cell with the new location can contain it.
    const std::vector<MapExit>& mapExits = map->getMapExits();
-   for(const auto& mapExit : mapExits)
+   for(const auto mapExitIndex : map->getMapExitsNear(message.newLocation))
    {
+      const MapExit& mapExit = mapExits[mapExitIndex];
       if(m_tileEngine.isPlayerCharacter(message.movingActor) &&
             !mapExit.getBounds().contains(message.oldLocation) &&
             mapExit.getBounds().contains(message.newLocation))
@@ -533,8 +1069,9 @@ void EntityGrid::receive(const ActorMoveMessage& message)
    }
 
    const std::vector<TriggerZone>& triggerZones = map->getTriggerZones();
-   for(const auto& triggerZone : triggerZones)
+   for(const auto triggerZoneIndex : map->getTriggerZonesNear(message.newLocation))
    {
+      const TriggerZone& triggerZone = triggerZones[triggerZoneIndex];
       if(!triggerZone.getBounds().contains(message.oldLocation)
             && triggerZone.getBounds().contains(message.newLocation))
       {
@@ -7,17 +7,25 @@
 #ifndef ENTITY_GRID_H
 #define ENTITY_GRID_H
 
+#include <cstdint>
 #include <limits>
 #include <string>
 #include <list>
+#include <map>
 #include <memory>
+#include <tuple>
 #include <vector>
 
+#include "ActorSpatialHash.h"
+#include "BitGrid.h"
 #include "Grid.h"
 #include "Listener.h"
+#include "MapBackgroundCache.h"
 #include "Pathfinder.h"
 #include "Rectangle.h"
+#include "ReservationTable.h"
 
+class FlowField;
 class Obstacle;
 class Map;
 class Actor;
@@ -49,17 +57,36 @@ struct TileState;
  */
 class EntityGrid final : messaging::Listener<ActorMoveMessage>
 {
-   friend class Pathfinder;
-
-   /** The size of a movement tile (used to control pathfinding granularity) */
-   static const int MOVEMENT_TILE_SIZE;
-
    /** The square root of 2. */
    static const float ROOT_2;
 
+   /** The number of flow fields to keep cached once they are no longer being followed. */
+   static const unsigned int MAX_CACHED_FLOW_FIELDS;
+
+   /**
+    * The number of move orders that must share a destination before a flow field is built for it.
+    * A lone mover is served far more cheaply by a best path query than by a search of the whole map.
+    */
+   static const unsigned int MIN_FLOW_FIELD_MOVERS;
+
    /** Floating-point notation for infinity. */
    static const float INFINITY;
 
+   /** The largest clearance (in tiles) recorded in the clearance map. Larger areas are checked tile by tile. */
+   static const int MAX_CLEARANCE;
+
+   /** The component label of tiles blocked by obstacles. */
+   static const unsigned int NO_COMPONENT;
+
+   /** The component label of passable tiles that have not been labelled yet. */
+   static const unsigned int UNLABELLED_COMPONENT;
+
+   /**
+    * The number of steps that Actors plan (and reserve) ahead when moving cooperatively.
+    * Only the first half of each plan is followed before planning again.
+    */
+   static const unsigned int RESERVATION_WINDOW;
+
    /** The tile engine that moderates this grid. */
    const TileEngine& m_tileEngine;
 
@@ -78,6 +105,65 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
    /** The bounds of the pathfinder map. */
    geometry::Rectangle m_collisionMapBounds;
 
+   /**
+    * One bit per tile, set for every tile that isn't free. Kept in sync with the collision map by setArea,
+    * so that a row of tiles can be checked 64 tiles at a time instead of loading every tile's state.
+    */
+   BitGrid m_occupancyMap;
+
+   /** The size (in pixels) of a movement tile, which controls collision and pathfinding granularity. Set by each map. */
+   int m_movementTileSize;
+
+   /**
+    * The size (in tiles, up to MAX_CLEARANCE) of the largest free square whose top-left corner is at each tile.
+    * Kept up to date whenever tiles change state, so that a free area can be confirmed with a single lookup.
+    */
+   Grid<std::uint8_t> m_clearanceMap;
+
+   /**
+    * The connected region that each tile belongs to, considering only obstacles (and not actors),
+    * or NO_COMPONENT for tiles blocked by obstacles. There is no way to travel between tiles with different labels.
+    */
+   Grid<unsigned int> m_componentMap;
+
+   /** The label to give to the next connected region that is found. */
+   unsigned int m_nextComponent = NO_COMPONENT + 1;
+
+   /**
+    * Incremented whenever static obstacles are added to or removed from the grid (but not when entities move),
+    * so that path data derived from the obstacles can tell when it is out of date.
+    */
+   unsigned long m_collisionEpoch = 0;
+
+   /** The flow fields built for this map, ordered from most to least recently requested. */
+   std::list<std::shared_ptr<FlowField>> m_flowFields;
+
+   /** Identifies a destination by its tile coordinates and the size of the entities heading there. */
+   typedef std::tuple<int, int, unsigned int, unsigned int> DestinationKey;
+
+   /** The number of move orders heading to each destination. */
+   std::map<DestinationKey, unsigned int> m_moverCounts;
+
+   /**
+    * @param dst The coordinates of the destination (in pixels).
+    * @param size The size of the moving entities.
+    *
+    * @return The key identifying the destination in the mover counts.
+    */
+   DestinationKey getDestinationKey(const geometry::Point2D& dst, const geometry::Size& size) const;
+
+   /** The time (in milliseconds) that has passed on the grid, used to schedule reservations. */
+   long m_time = 0;
+
+   /** The tiles that moving Actors have reserved for their next few steps. */
+   ReservationTable m_reservations;
+
+   /** The Actors on the grid, bucketed by location for neighbourhood queries. */
+   ActorSpatialHash m_actorHash;
+
+   /** Pre-rendered chunks of the map's background layers (filled in as they are drawn). */
+   mutable MapBackgroundCache m_backgroundCache;
+
    /**
     * @param area The pixel-coordinate rectangle to determine boundaries for.
     *
@@ -131,6 +217,49 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
     */
    void setArea(const geometry::Rectangle& area, TileState state);
 
+   /**
+    * @param x The x-coordinate of the tile.
+    * @param y The y-coordinate of the tile.
+    *
+    * @return The clearance of the tile, based on the state of the tile and the clearance of its neighbours to the right and below.
+    */
+   std::uint8_t calculateClearance(int x, int y) const;
+
+   /**
+    * Updates the clearance map after the tiles in an area have changed state.
+    * Only the tiles whose clearance can depend on the area (above and to the left of it) are revisited,
+    * and each row stops as soon as the clearance values stop changing.
+    *
+    * @param area The rectangular area that changed (with edge coordinates in tiles)
+    *
+    * @return The area extended to cover every tile whose clearance changed (with edge coordinates in tiles)
+    */
+   geometry::Rectangle updateClearance(const geometry::Rectangle& area);
+
+   /**
+    * @param area The rectangular area to check (with edge coordinates in tiles)
+    *
+    * @return true iff the clearance map shows that every tile in the area is free.
+    * A false result means that the area has to be checked tile by tile.
+    */
+   bool hasClearance(const geometry::Rectangle& area) const;
+
+   /**
+    * Gives a new label to every tile connected to the given tile that shares its current label.
+    *
+    * @param tile The tile to start labelling from.
+    * @param component The new label.
+    */
+   void labelComponent(const geometry::Point2D& tile, unsigned int component);
+
+   /**
+    * Updates the component labels after an obstacle is placed over an area,
+    * relabelling the region the obstacle was placed in, which may have been split in pieces.
+    *
+    * @param area The rectangular area covered by the new obstacle (with edge coordinates in tiles)
+    */
+   void splitComponents(const geometry::Rectangle& area);
+
    public:
       /** A set of waypoints to move through in order to go from one point to another. */
       typedef std::list<geometry::Point2D> Path;
@@ -189,20 +318,41 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
       bool withinMap(const geometry::Point2D& point) const;
 
       /**
-       * Process logic for the map and its obstacles.
+       * Process logic for the map and its obstacles,
+       * and hand any queued path requests to the pathfinder's workers.
        */
       void step(long timePassed);
 
+      /**
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       *
+       * @return true iff the destination can be reached from the source around the obstacles on the map (ignoring actors).
+       */
+      bool isReachable(const geometry::Point2D& src, const geometry::Point2D& dst) const;
+
       /**
        * Finds an ideal path from the source coordinates to the destination.
+       * This is how a lone mover finds its way; paths found with the precomputed path data
+       * are cached until obstacles change, so repeated moves (like patrol loops) are cheap.
        *
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
        *
-       * @return The ideal best path from the source point to the destination point.
+       * @return The ideal best path from the source point to the destination point,
+       * or an empty path if there is none or there is no precomputed path data for the entity (see hasPathData).
        */
       Path findBestPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size);
 
+      /**
+       * @param size The size of a moving entity.
+       *
+       * @return true iff there is precomputed path data to find best paths for the entity with,
+       *         so that an empty best path means there is no path at all.
+       */
+      bool hasPathData(const geometry::Size& size) const;
+
       /**
        * Finds the shortest path from the source coordinates to the destination
        * around all obstacles and entities.
@@ -210,17 +360,96 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        * @param size The size of the moving entity.
+       * @param algorithm The search algorithm to use.
        *
        * @return The shortest unobstructed path from the source point to the destination point.
        */
-      Path findReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size);
+      Path findReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, Pathfinder::SearchAlgorithm algorithm = Pathfinder::SearchAlgorithm::A_STAR);
+
+      /**
+       * Requests the shortest path from the source coordinates to the destination
+       * around all obstacles and entities, to be found on a worker thread.
+       * Requests are handed to the workers in batches (of limited size) each time the grid steps.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       * @param algorithm The search algorithm to use.
+       *
+       * @return A handle to poll for the path. Releasing the handle abandons the request.
+       */
+      std::shared_ptr<const Pathfinder::PathQuery> requestReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, Pathfinder::SearchAlgorithm algorithm = Pathfinder::SearchAlgorithm::A_STAR);
+
+      /**
+       * Records that a move order is heading to the given destination, so that the grid
+       * can tell which destinations are shared by several movers (see getFlowField).
+       *
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       */
+      void addMover(const geometry::Point2D& dst, const geometry::Size& size);
+
+      /**
+       * Records that a move order is no longer heading to the given destination.
+       *
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       */
+      void removeMover(const geometry::Point2D& dst, const geometry::Size& size);
+
+      /**
+       * Gets a flow field leading to the given destination, so that the entities heading there
+       * can share a single search. A new field is only built once at least MIN_FLOW_FIELD_MOVERS
+       * move orders are heading to the destination; a lone mover should use findBestPath instead.
+       * Fields are cached, and a cached field whose goal is one step away (and is no longer
+       * followed by anyone) is updated incrementally rather than rebuilt.
+       *
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entities.
+       *
+       * @return A flow field leading to the destination, or nullptr if there is no map data
+       *         or the destination isn't shared.
+       */
+      std::shared_ptr<const FlowField> getFlowField(const geometry::Point2D& dst, const geometry::Size& size);
+
+      /**
+       * Plans the next few steps of an Actor's movement toward a destination, cooperatively
+       * with the other moving Actors (WHCA*). The Actor's previous reservations are released, and the tiles
+       * it will occupy over the planned window are reserved so that other Actors plan around them.
+       *
+       * @param actor The actor that is moving.
+       * @param location The current coordinates of the actor (in pixels).
+       * @param dst The coordinates to move toward (in pixels), usually the next waypoint of the Actor's route.
+       *
+       * @return The waypoints to move through before planning again. A waypoint equal to the previous one
+       *         means that the Actor should wait in place for a step. The path is empty if the Actor can't move at all.
+       */
+      Path planCooperativePath(Actor* actor, const geometry::Point2D& location, const geometry::Point2D& dst);
+
+      /**
+       * Releases the tiles reserved by an Actor's cooperative path.
+       *
+       * @param actor The actor that is no longer following its path.
+       */
+      void releaseReservations(const Actor* actor);
+
+      /**
+       * @return The size (in pixels) of a movement tile, which is the distance covered by a single step of a path.
+       */
+      int getMovementTileSize() const;
+
+      /**
+       * @return A counter that is incremented whenever static obstacles are added to or removed from the grid.
+       *         Flow fields built at an earlier epoch may lead through the new obstacles.
+       */
+      unsigned long getCollisionEpoch() const;
 
       /**
        * Checks an area for obstacles or entities.
        *
        * @param area The area to check (in pixels)
        *
-       * @return true iff a given area is entirely free of obstacles and entities.
+       * @return true iff a given area is within the grid and entirely free of obstacles and entities.
        */
       bool isAreaFree(const geometry::Rectangle& area) const;
 
@@ -271,6 +500,21 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
        */
       Actor* getAdjacentActor(Actor* actor) const;
 
+      /**
+       * @param area The area to search (in pixels).
+       *
+       * @return The actors on the grid that overlap the area.
+       */
+      std::vector<Actor*> getActorsInArea(const geometry::Rectangle& area) const;
+
+      /**
+       * @param center The center of the search (in pixels).
+       * @param radius The radius of the search (in pixels).
+       *
+       * @return The actors on the grid with any part of them within the radius of the center.
+       */
+      std::vector<Actor*> getActorsInRadius(const geometry::Point2D& center, int radius) const;
+
       /**
        * Given the distance the entity can move and the direction, moves as far as possible until an obstacle is encountered.
        *
@@ -285,14 +529,17 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
 
       /**
        * Request permission from the EntityGrid to move an Actor from the source to the given destination.
+       * The destination may be several tiles away, in which case every tile that the actor passes through
+       * along the way (see Pathfinder::getSegmentStep) is occupied, or none of them are.
        * NOTE: After the actor has completed this movement, endMovement MUST be called in order to notify the EntityGrid to perform the appropriate clean-up.
        *
        * @param actor The actor that is moving.
+       * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        *
        * @return true iff the actor can move from the source to the destination.
        */
-      bool beginMovement(Actor* actor, const geometry::Point2D& dst);
+      bool beginMovement(Actor* actor, const geometry::Point2D& src, const geometry::Point2D& dst);
 
       /**
        * Notifies the EntityGrid that the actor failed to complete movement from the source to the given destination and occupies some area between the source and destination.
@@ -304,7 +551,8 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
       void abortMovement(Actor* actor, const geometry::Point2D& src, const geometry::Point2D& dst);
 
       /**
-       * Notifies the EntityGrid that the actor moved successfully from the source to the given destination and no longer occupies the source coordinates.
+       * Notifies the EntityGrid that the actor moved successfully from the source to the given destination and no longer occupies the source coordinates
+       * (or any of the tiles in between).
        *
        * @param actor The actor that was moving.
        * @param src The coordinates of the source (in pixels).
@@ -313,18 +561,24 @@ class EntityGrid final : messaging::Listener<ActorMoveMessage>
       void endMovement(Actor* actor, const geometry::Point2D& src, const geometry::Point2D& dst);
 
       /**
-       * Draw a row of the background layers of the map.
+       * @return The largest height offset (in tiles) of the map's foreground layers.
+       */
+      int getMaxHeightOffset() const;
+
+      /**
+       * Draw the background layers of the map.
        *
-       * @param y The row to draw.
+       * @param area The visible area of the map (in tiles).
        */
-      void drawBackground(int y) const;
+      void drawBackground(const geometry::Rectangle& area) const;
 
       /**
        * Draw a row of the foreground layers of the map.
        *
        * @param y The row to draw.
+       * @param area The visible area of the map (in tiles).
        */
-      void drawForeground(int y) const;
+      void drawForeground(int y, const geometry::Rectangle& area) const;
 
       /**
        * Receive location change messages.
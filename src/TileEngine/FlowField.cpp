@@ -0,0 +1,237 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "FlowField.h"
+#include "TileState.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cstdlib>
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_PATHFINDER
+
+const float FlowField::ROOT_2 = 1.41421356f;
+
+namespace
+{
+   /** The offsets to each of the 8 neighbours of a tile (straight moves first). */
+   const int ADJACENT_OFFSETS[8][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1} };
+
+   /** The distance of tiles from which the goal cannot be reached. */
+   const float UNREACHABLE = std::numeric_limits<float>::infinity();
+};
+
+FlowField::FlowField(const Grid<TileState>& grid, const geometry::Rectangle& gridBounds, int tileSize, const geometry::Point2D& goal, const geometry::Size& entitySize, unsigned long collisionEpoch) :
+   m_tileSize(tileSize),
+   m_bounds(gridBounds),
+   m_entitySize(entitySize),
+   m_collisionEpoch(collisionEpoch),
+   m_goal(goal / tileSize),
+   m_passable(gridBounds.getSize(), 0),
+   m_distances(gridBounds.getSize(), UNREACHABLE)
+{
+   const int width = m_bounds.getWidth();
+   const int height = m_bounds.getHeight();
+   const int footprintWidth = std::max(1, static_cast<int>((entitySize.width + tileSize - 1) / tileSize));
+   const int footprintHeight = std::max(1, static_cast<int>((entitySize.height + tileSize - 1) / tileSize));
+
+   for(int y = 0; y + footprintHeight <= height; ++y)
+   {
+      for(int x = 0; x + footprintWidth <= width; ++x)
+      {
+         bool passable = true;
+         for(int footprintY = y; footprintY < y + footprintHeight && passable; ++footprintY)
+         {
+            for(int footprintX = x; footprintX < x + footprintWidth; ++footprintX)
+            {
+               if(grid(footprintX, footprintY).entityType == TileState::EntityType::OBSTACLE)
+               {
+                  passable = false;
+                  break;
+               }
+            }
+         }
+
+         m_passable(x, y) = passable ? 1 : 0;
+      }
+   }
+
+   if(isPassable(m_goal))
+   {
+      m_distances(m_goal.x, m_goal.y) = 0;
+      m_wavefront.emplace_back(0.0f, m_goal.y * width + m_goal.x);
+      propagate();
+   }
+
+   DEBUG("Built flow field towards %d,%d", m_goal.x, m_goal.y);
+}
+
+bool FlowField::isPassable(const geometry::Point2D& tile) const
+{
+   return tile.x >= m_bounds.left && tile.x < m_bounds.right &&
+          tile.y >= m_bounds.top && tile.y < m_bounds.bottom &&
+          m_passable(tile.x, tile.y) != 0;
+}
+
+float FlowField::getStepCost(const geometry::Point2D& src, const geometry::Point2D& dst) const
+{
+   if(!isPassable(dst))
+   {
+      return UNREACHABLE;
+   }
+
+   if(src.x != dst.x && src.y != dst.y)
+   {
+      // Diagonal steps may not cut the corners of obstacles.
+      if(!isPassable(geometry::Point2D(dst.x, src.y)) || !isPassable(geometry::Point2D(src.x, dst.y)))
+      {
+         return UNREACHABLE;
+      }
+
+      return ROOT_2;
+   }
+
+   return 1.0f;
+}
+
+void FlowField::propagate()
+{
+   typedef std::pair<float, int> WavefrontEntry;
+   const auto isLowerPriority = std::greater<WavefrontEntry>();
+   const int width = m_bounds.getWidth();
+
+   std::make_heap(m_wavefront.begin(), m_wavefront.end(), isLowerPriority);
+
+   while(!m_wavefront.empty())
+   {
+      const WavefrontEntry entry = m_wavefront.front();
+      std::pop_heap(m_wavefront.begin(), m_wavefront.end(), isLowerPriority);
+      m_wavefront.pop_back();
+
+      const geometry::Point2D tile(entry.second % width, entry.second / width);
+      if(entry.first > m_distances(tile.x, tile.y))
+      {
+         // This entry was superseded by a cheaper one.
+         continue;
+      }
+
+      for(const auto& offset : ADJACENT_OFFSETS)
+      {
+         const geometry::Point2D adjacentTile(tile.x + offset[0], tile.y + offset[1]);
+
+         // Steps are symmetric, so the cost of stepping towards the goal from
+         // the adjacent tile is the same as the cost of stepping away from it.
+         const float distance = entry.first + getStepCost(tile, adjacentTile);
+         if(distance < UNREACHABLE && distance < m_distances(adjacentTile.x, adjacentTile.y))
+         {
+            m_distances(adjacentTile.x, adjacentTile.y) = distance;
+            m_wavefront.emplace_back(distance, adjacentTile.y * width + adjacentTile.x);
+            std::push_heap(m_wavefront.begin(), m_wavefront.end(), isLowerPriority);
+         }
+      }
+   }
+}
+
+geometry::Point2D FlowField::getGoal() const
+{
+   return m_goal * m_tileSize;
+}
+
+const geometry::Size& FlowField::getEntitySize() const
+{
+   return m_entitySize;
+}
+
+unsigned long FlowField::getCollisionEpoch() const
+{
+   return m_collisionEpoch;
+}
+
+bool FlowField::moveGoal(const geometry::Point2D& goal)
+{
+   const geometry::Point2D goalTile = goal / m_tileSize;
+   if(goalTile == m_goal)
+   {
+      return true;
+   }
+
+   if(std::abs(goalTile.x - m_goal.x) > 1 || std::abs(goalTile.y - m_goal.y) > 1)
+   {
+      return false;
+   }
+
+   const float stepCost = getStepCost(goalTile, m_goal);
+   if(stepCost == UNREACHABLE || !isPassable(goalTile))
+   {
+      return false;
+   }
+
+   // Any path to the old goal can be extended to the new goal by one step,
+   // so the old distances (plus the step) are valid upper bounds. Any tile that is
+   // strictly closer to the new goal has a shortest path made up entirely of such
+   // tiles, so a wavefront from the new goal reaches every distance that must drop.
+   for(int y = 0; y < static_cast<int>(m_bounds.getHeight()); ++y)
+   {
+      for(int x = 0; x < static_cast<int>(m_bounds.getWidth()); ++x)
+      {
+         m_distances(x, y) += stepCost;
+      }
+   }
+
+   m_goal = goalTile;
+   m_distances(m_goal.x, m_goal.y) = 0;
+   m_wavefront.clear();
+   m_wavefront.emplace_back(0.0f, m_goal.y * m_bounds.getWidth() + m_goal.x);
+   propagate();
+
+   DEBUG("Moved flow field goal to %d,%d", m_goal.x, m_goal.y);
+   return true;
+}
+
+bool FlowField::isReachable(const geometry::Point2D& location) const
+{
+   const geometry::Point2D tile = location / m_tileSize;
+   return isPassable(tile) && m_distances(tile.x, tile.y) < UNREACHABLE;
+}
+
+float FlowField::getDistance(const geometry::Point2D& location) const
+{
+   const geometry::Point2D tile = location / m_tileSize;
+   return isPassable(tile) ? m_distances(tile.x, tile.y) : UNREACHABLE;
+}
+
+bool FlowField::getNextWaypoint(const geometry::Point2D& location, geometry::Point2D& waypoint) const
+{
+   const geometry::Point2D tile = location / m_tileSize;
+   if(tile == m_goal || !isReachable(location))
+   {
+      return false;
+   }
+
+   float bestDistance = UNREACHABLE;
+   bool found = false;
+
+   for(const auto& offset : ADJACENT_OFFSETS)
+   {
+      const geometry::Point2D adjacentTile(tile.x + offset[0], tile.y + offset[1]);
+      const float stepCost = getStepCost(tile, adjacentTile);
+      if(stepCost == UNREACHABLE)
+      {
+         continue;
+      }
+
+      const float distance = stepCost + m_distances(adjacentTile.x, adjacentTile.y);
+      if(distance < bestDistance)
+      {
+         bestDistance = distance;
+         waypoint = adjacentTile * m_tileSize;
+         found = true;
+      }
+   }
+
+   return found;
+}
@@ -0,0 +1,148 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Grid.h"
+#include "Point2D.h"
+#include "Rectangle.h"
+#include "Size.h"
+
+struct TileState;
+
+/**
+ * A flow field (or Dijkstra map) holds the shortest travel distance from every tile
+ * on a collision grid to a single goal tile, routing around static obstacles.
+ * Any number of entities heading to the same goal can share one field and
+ * find their next step in constant time by moving to the neighbouring tile
+ * that is closest to the goal.
+ *
+ * Like the Roy-Floyd-Warshall matrices, a flow field does not take moving entities
+ * into account, so entities following it must still route around each other.
+ *
+ * @author Noam Chitayat
+ */
+class FlowField final
+{
+   /** The square root of 2. */
+   static const float ROOT_2;
+
+   /** The size (in pixels) of each tile. */
+   const int m_tileSize;
+
+   /** The bounds (in tiles) of the grid. */
+   const geometry::Rectangle m_bounds;
+
+   /** The size (in pixels) of the entities that use this field. */
+   const geometry::Size m_entitySize;
+
+   /** The collision epoch of the grid when this field was built (see EntityGrid::getCollisionEpoch). */
+   const unsigned long m_collisionEpoch;
+
+   /** The tile that all entities using this field are heading to. */
+   geometry::Point2D m_goal;
+
+   /** Whether an entity of the field's size can stand on each tile without overlapping a static obstacle. */
+   Grid<std::uint8_t> m_passable;
+
+   /** The travel distance (in tiles) from each tile to the goal. */
+   Grid<float> m_distances;
+
+   /** Scratch space for the Dijkstra wavefront (distance, tile number), kept to avoid reallocation. */
+   std::vector<std::pair<float, int>> m_wavefront;
+
+   /**
+    * @param tile The tile to check.
+    *
+    * @return true iff the tile is within the grid and an entity of the field's size can stand on it.
+    */
+   bool isPassable(const geometry::Point2D& tile) const;
+
+   /**
+    * @param src The tile being left.
+    * @param dst An adjacent tile.
+    *
+    * @return The cost of stepping from one tile to the other, or infinity if the step is blocked.
+    */
+   float getStepCost(const geometry::Point2D& src, const geometry::Point2D& dst) const;
+
+   /**
+    * Runs Dijkstra's algorithm from the tiles in the wavefront, lowering
+    * the distance of every tile that can be reached more cheaply from them.
+    */
+   void propagate();
+
+   public:
+      /**
+       * Constructor. Builds the field for the given goal.
+       *
+       * @param grid A grid of free spaces and obstacles.
+       * @param gridBounds The rectangle representing the bounds of the grid.
+       * @param tileSize The size (in pixels) of each tile.
+       * @param goal The coordinates of the goal (in pixels).
+       * @param entitySize The size (in pixels) of the entities that will use this field.
+       * @param collisionEpoch The collision epoch of the grid, which tells when the field's obstacles are out of date.
+       */
+      FlowField(const Grid<TileState>& grid, const geometry::Rectangle& gridBounds, int tileSize, const geometry::Point2D& goal, const geometry::Size& entitySize, unsigned long collisionEpoch);
+
+      /**
+       * @return The coordinates of the goal (in pixels).
+       */
+      geometry::Point2D getGoal() const;
+
+      /**
+       * @return The size (in pixels) of the entities that use this field.
+       */
+      const geometry::Size& getEntitySize() const;
+
+      /**
+       * @return The collision epoch of the grid when this field was built.
+       *         Once the grid's epoch moves on, the field may lead through new obstacles.
+       */
+      unsigned long getCollisionEpoch() const;
+
+      /**
+       * Moves the goal of the field to an adjacent tile, updating only the distances that change.
+       * Every distance grows by at most the cost of the step between the old and new goals,
+       * so the field is first raised by that cost and then lowered wherever the new goal is closer.
+       *
+       * @param goal The coordinates of the new goal (in pixels).
+       *
+       * @return true iff the goal was moved. If the new goal cannot be reached in one step from the old one, the field is left unchanged.
+       */
+      bool moveGoal(const geometry::Point2D& goal);
+
+      /**
+       * @param location The coordinates to check (in pixels).
+       *
+       * @return true iff the goal can be reached from the given location.
+       */
+      bool isReachable(const geometry::Point2D& location) const;
+
+      /**
+       * @param location The coordinates to check (in pixels).
+       *
+       * @return The travel distance (in tiles) from the given location to the goal, or infinity if the goal can't be reached.
+       */
+      float getDistance(const geometry::Point2D& location) const;
+
+      /**
+       * Finds the next waypoint on a shortest path to the goal.
+       *
+       * @param location The current coordinates of the entity (in pixels).
+       * @param waypoint Set to the coordinates of the next waypoint (in pixels) if one exists.
+       *
+       * @return true iff there is a next waypoint (the goal is reachable and not yet reached).
+       */
+      bool getNextWaypoint(const geometry::Point2D& location, geometry::Point2D& waypoint) const;
+};
+
+#endif
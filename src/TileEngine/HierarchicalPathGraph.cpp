@@ -0,0 +1,782 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "HierarchicalPathGraph.h"
+#include "Size.h"
+#include "TileState.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_PATHFINDER
+
+const float HierarchicalPathGraph::ROOT_2 = 1.41421356f;
+const int HierarchicalPathGraph::CLUSTER_SIZE = 16;
+const int HierarchicalPathGraph::MAX_SINGLE_ENTRANCE_LENGTH = 5;
+const int HierarchicalPathGraph::MAX_FOOTPRINT = 16;
+
+namespace
+{
+   /** A node waiting to be expanded in a search, along with its expected cost. */
+   typedef std::pair<float, int> SearchEntry;
+
+   /** A min-heap of search entries (lowest cost first). */
+   typedef std::priority_queue<SearchEntry, std::vector<SearchEntry>, std::greater<SearchEntry>> SearchQueue;
+};
+
+/**
+ * Runs Dijkstra's algorithm within the bounds of a single cluster.
+ * The cluster's impassable tiles (for the footprint being searched) are copied into a buffer
+ * surrounded by a ring of blocked tiles, so that the search never needs to check the cluster bounds.
+ *
+ * @author Noam Chitayat
+ */
+class HierarchicalPathGraph::ClusterSearch final
+{
+   /** The bounds (in tiles) of the cluster being searched. */
+   geometry::Rectangle m_clusterBounds;
+
+   /** The row length of the padded search buffers. */
+   int m_stride = 0;
+
+   /** Flags marking the obstacles in the padded cluster. */
+   std::vector<char> m_blocked;
+
+   /** The distance from the search origin to each tile in the padded cluster. */
+   std::vector<float> m_distances;
+
+   /** The predecessor of each tile on its shortest path from the search origin. */
+   std::vector<int> m_predecessors;
+
+   /** Flags marking the tiles whose shortest paths haven't been found yet. */
+   std::vector<char> m_targets;
+
+   /** The heap of tiles waiting to be expanded. */
+   std::vector<SearchEntry> m_openSet;
+
+   /**
+    * @param tile A tile within the cluster.
+    *
+    * @return The index of the tile in the padded search buffers.
+    */
+   int toIndex(const geometry::Point2D& tile) const
+   {
+      return (tile.y - m_clusterBounds.top + 1) * m_stride + (tile.x - m_clusterBounds.left + 1);
+   }
+
+   /**
+    * @param index An index in the padded search buffers.
+    *
+    * @return The tile corresponding to the index.
+    */
+   geometry::Point2D toTile(int index) const
+   {
+      return geometry::Point2D(m_clusterBounds.left + index % m_stride - 1, m_clusterBounds.top + index / m_stride - 1);
+   }
+
+   public:
+      /**
+       * Prepares the search buffers for a new cluster.
+       *
+       * @param graph The graph whose tiles are being searched.
+       * @param clusterBounds The bounds (in tiles) of the cluster to search within.
+       * @param footprint The width and height (in tiles) of the entity to search for.
+       */
+      void setCluster(const HierarchicalPathGraph& graph, const geometry::Rectangle& clusterBounds, int footprint)
+      {
+         m_clusterBounds = clusterBounds;
+         m_stride = clusterBounds.getWidth() + 2;
+         m_blocked.assign(m_stride * (clusterBounds.getHeight() + 2), 1);
+
+         for(int y = clusterBounds.top; y < clusterBounds.bottom; ++y)
+         {
+            for(int x = clusterBounds.left; x < clusterBounds.right; ++x)
+            {
+               m_blocked[toIndex(geometry::Point2D(x, y))] = !graph.isPassable(geometry::Point2D(x, y), footprint);
+            }
+         }
+      }
+
+      /**
+       * Finds the shortest paths from the origin to the given targets in the cluster.
+       * The search stops as soon as the shortest path to every target is known.
+       *
+       * @param origin The tile to start searching from.
+       * @param targets The tiles to find the shortest paths to.
+       */
+      void explore(const geometry::Point2D& origin, const std::vector<geometry::Point2D>& targets)
+      {
+         const int neighbourOffsets[] = { -1, 1, -m_stride, m_stride, -m_stride - 1, -m_stride + 1, m_stride - 1, m_stride + 1 };
+
+         m_distances.assign(m_blocked.size(), std::numeric_limits<float>::infinity());
+         m_predecessors.assign(m_blocked.size(), -1);
+         m_targets.assign(m_blocked.size(), 0);
+         m_openSet.clear();
+
+         int remainingTargets = 0;
+         for(const auto& target : targets)
+         {
+            char& isTarget = m_targets[toIndex(target)];
+            remainingTargets += !isTarget;
+            isTarget = 1;
+         }
+
+         const int originIndex = toIndex(origin);
+         m_distances[originIndex] = 0;
+         m_openSet.emplace_back(0.0f, originIndex);
+
+         while(!m_openSet.empty() && remainingTargets > 0)
+         {
+            std::pop_heap(m_openSet.begin(), m_openSet.end(), std::greater<SearchEntry>());
+            const SearchEntry entry = m_openSet.back();
+            m_openSet.pop_back();
+
+            const int tileIndex = entry.second;
+            if(entry.first > m_distances[tileIndex])
+            {
+               // Stale entry; this tile was already reached with a lower cost.
+               continue;
+            }
+
+            if(m_targets[tileIndex])
+            {
+               m_targets[tileIndex] = 0;
+               --remainingTargets;
+            }
+
+            for(int direction = 0; direction < 8; ++direction)
+            {
+               const int neighbourIndex = tileIndex + neighbourOffsets[direction];
+               if(m_blocked[neighbourIndex])
+               {
+                  continue;
+               }
+
+               const bool diagonalMovement = direction >= 4;
+               if(diagonalMovement)
+               {
+                  // Diagonal steps can't cut the corners of obstacles.
+                  // For larger entities, the two straight steps also cover the whole area swept by the diagonal step.
+                  const int xOffset = (direction % 2 == 0) ? -1 : 1;
+                  const int yOffset = (direction < 6) ? -m_stride : m_stride;
+                  if(m_blocked[tileIndex + xOffset] || m_blocked[tileIndex + yOffset])
+                  {
+                     continue;
+                  }
+               }
+
+               const float distance = entry.first + (diagonalMovement ? ROOT_2 : 1.0f);
+               if(distance < m_distances[neighbourIndex])
+               {
+                  m_distances[neighbourIndex] = distance;
+                  m_predecessors[neighbourIndex] = tileIndex;
+                  m_openSet.emplace_back(distance, neighbourIndex);
+                  std::push_heap(m_openSet.begin(), m_openSet.end(), std::greater<SearchEntry>());
+               }
+            }
+         }
+      }
+
+      /**
+       * @param tile A target tile of the last exploration.
+       *
+       * @return The distance from the last explored origin to the tile.
+       */
+      float getDistance(const geometry::Point2D& tile) const
+      {
+         return m_distances[toIndex(tile)];
+      }
+
+      /**
+       * Appends the shortest path from the last explored origin to a tile.
+       *
+       * @param dst A target tile of the last exploration.
+       * @param path The path to append the tiles to (excluding the origin tile).
+       *
+       * @return true iff the destination is reachable from the origin within the cluster.
+       */
+      bool appendPath(const geometry::Point2D& dst, std::vector<geometry::Point2D>& path) const
+      {
+         int tileIndex = toIndex(dst);
+         if(m_distances[tileIndex] == std::numeric_limits<float>::infinity())
+         {
+            return false;
+         }
+
+         const auto refinedStart = path.size();
+         for(; m_predecessors[tileIndex] != -1; tileIndex = m_predecessors[tileIndex])
+         {
+            path.push_back(toTile(tileIndex));
+         }
+
+         std::reverse(path.begin() + refinedStart, path.end());
+         return true;
+      }
+};
+
+HierarchicalPathGraph::HierarchicalPathGraph(const Grid<TileState>& grid, const geometry::Rectangle& gridBounds) :
+   m_bounds(gridBounds)
+{
+   const int width = m_bounds.getWidth();
+   const int height = m_bounds.getHeight();
+
+   m_clustersWide = (width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+   m_clustersHigh = (height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+   m_clearance.resize(m_bounds.getSize(), 0);
+   updateClearance(grid, geometry::Rectangle(m_bounds.top, m_bounds.left, m_bounds.bottom - 1, m_bounds.right - 1));
+
+   m_layers.resize(MAX_FOOTPRINT);
+   getLayer(1);
+}
+
+int HierarchicalPathGraph::getClusterIndex(const geometry::Point2D& tile) const
+{
+   return ((tile.y - m_bounds.top) / CLUSTER_SIZE) * m_clustersWide + (tile.x - m_bounds.left) / CLUSTER_SIZE;
+}
+
+geometry::Rectangle HierarchicalPathGraph::getClusterBounds(int clusterIndex) const
+{
+   const int left = m_bounds.left + (clusterIndex % m_clustersWide) * CLUSTER_SIZE;
+   const int top = m_bounds.top + (clusterIndex / m_clustersWide) * CLUSTER_SIZE;
+
+   return geometry::Rectangle(
+      top,
+      left,
+      std::min(top + CLUSTER_SIZE, m_bounds.bottom),
+      std::min(left + CLUSTER_SIZE, m_bounds.right));
+}
+
+bool HierarchicalPathGraph::isObstacle(const Grid<TileState>& grid, const geometry::Point2D& tile)
+{
+   return grid(tile.x, tile.y).entityType == TileState::EntityType::OBSTACLE;
+}
+
+bool HierarchicalPathGraph::isPassable(const geometry::Point2D& tile, int footprint) const
+{
+   return m_clearance(tile.x - m_bounds.left, tile.y - m_bounds.top) >= footprint;
+}
+
+float HierarchicalPathGraph::getOctileDistance(const geometry::Point2D& src, const geometry::Point2D& dst)
+{
+   const int xDistance = abs(dst.x - src.x);
+   const int yDistance = abs(dst.y - src.y);
+
+   return std::max(xDistance, yDistance) + (ROOT_2 - 1.0f) * std::min(xDistance, yDistance);
+}
+
+void HierarchicalPathGraph::updateClearance(const Grid<TileState>& grid, const geometry::Rectangle& area)
+{
+   const int width = m_bounds.getWidth();
+   const int height = m_bounds.getHeight();
+
+   // A tile's clearance only depends on the tiles below and to the right of it (up to MAX_FOOTPRINT away),
+   // so the tiles to update are the area and the tiles above and to the left of it, in that order.
+   const int left = std::max(area.left - m_bounds.left - (MAX_FOOTPRINT - 1), 0);
+   const int top = std::max(area.top - m_bounds.top - (MAX_FOOTPRINT - 1), 0);
+   const int right = std::min(area.right - m_bounds.left, width - 1);
+   const int bottom = std::min(area.bottom - m_bounds.top, height - 1);
+
+   for(int y = bottom; y >= top; --y)
+   {
+      for(int x = right; x >= left; --x)
+      {
+         if(isObstacle(grid, geometry::Point2D(m_bounds.left + x, m_bounds.top + y)))
+         {
+            m_clearance(x, y) = 0;
+            continue;
+         }
+
+         // The largest free square at this tile is one larger than the smallest of the squares to the right, below and diagonally below-right.
+         const bool hasRight = x + 1 < width;
+         const bool hasBelow = y + 1 < height;
+         const int rightClearance = hasRight ? m_clearance(x + 1, y) : 0;
+         const int belowClearance = hasBelow ? m_clearance(x, y + 1) : 0;
+         const int diagonalClearance = hasRight && hasBelow ? m_clearance(x + 1, y + 1) : 0;
+
+         m_clearance(x, y) = std::min(MAX_FOOTPRINT, 1 + std::min(rightClearance, std::min(belowClearance, diagonalClearance)));
+      }
+   }
+}
+
+const HierarchicalPathGraph::Layer& HierarchicalPathGraph::getLayer(int footprint) const
+{
+   Layer& layer = m_layers[footprint - 1];
+   if(layer.footprint == 0)
+   {
+      layer.footprint = footprint;
+      buildLayer(layer);
+   }
+
+   return layer;
+}
+
+void HierarchicalPathGraph::buildLayer(Layer& layer) const
+{
+   layer.clusterNodes.resize(m_clustersWide * m_clustersHigh);
+   layer.nodeIndices.resize(m_bounds.getSize(), -1);
+
+   // Find the entrances along the vertical borders between horizontally adjacent clusters
+   for(int clusterY = 0; clusterY < m_clustersHigh; ++clusterY)
+   {
+      for(int clusterX = 0; clusterX < m_clustersWide - 1; ++clusterX)
+      {
+         findVerticalBorderEntrances(layer, clusterX, clusterY);
+      }
+   }
+
+   // Find the entrances along the horizontal borders between vertically adjacent clusters
+   for(int clusterY = 0; clusterY < m_clustersHigh - 1; ++clusterY)
+   {
+      for(int clusterX = 0; clusterX < m_clustersWide; ++clusterX)
+      {
+         findHorizontalBorderEntrances(layer, clusterX, clusterY);
+      }
+   }
+
+   for(int clusterIndex = 0; clusterIndex < static_cast<int>(layer.clusterNodes.size()); ++clusterIndex)
+   {
+      connectClusterNodes(layer, clusterIndex);
+   }
+
+   DEBUG("Built hierarchical path graph for %dx%d entities with %d clusters and %d entrances.", layer.footprint, layer.footprint, static_cast<int>(layer.clusterNodes.size()), static_cast<int>(layer.nodes.size()));
+}
+
+int HierarchicalPathGraph::addNode(Layer& layer, const geometry::Point2D& tile) const
+{
+   int& nodeIndex = layer.nodeIndices(tile.x - m_bounds.left, tile.y - m_bounds.top);
+   if(nodeIndex < 0)
+   {
+      nodeIndex = layer.nodes.size();
+      const int clusterIndex = getClusterIndex(tile);
+      layer.nodes.push_back({ tile, clusterIndex, std::vector<Edge>() });
+      layer.clusterNodes[clusterIndex].push_back(nodeIndex);
+   }
+
+   return nodeIndex;
+}
+
+void HierarchicalPathGraph::addEntrance(Layer& layer, const geometry::Point2D& first, const geometry::Point2D& second) const
+{
+   const int firstNode = addNode(layer, first);
+   const int secondNode = addNode(layer, second);
+
+   layer.nodes[firstNode].edges.push_back({ secondNode, 1.0f });
+   layer.nodes[secondNode].edges.push_back({ firstNode, 1.0f });
+}
+
+void HierarchicalPathGraph::findEntrances(Layer& layer, const geometry::Point2D& start, const geometry::Point2D& step, const geometry::Point2D& across, int length) const
+{
+   const auto borderTile = [&](int offset)
+   {
+      return geometry::Point2D(start.x + step.x * offset, start.y + step.y * offset);
+   };
+
+   const auto acrossTile = [&](int offset)
+   {
+      return geometry::Point2D(start.x + step.x * offset + across.x, start.y + step.y * offset + across.y);
+   };
+
+   int runStart = -1;
+   for(int offset = 0; offset <= length; ++offset)
+   {
+      const bool open = offset < length &&
+         isPassable(borderTile(offset), layer.footprint) &&
+         isPassable(acrossTile(offset), layer.footprint);
+
+      if(open)
+      {
+         if(runStart < 0)
+         {
+            runStart = offset;
+         }
+
+         continue;
+      }
+
+      if(runStart >= 0)
+      {
+         // Short runs get a single entrance in the middle; longer runs
+         // get an entrance at either end to keep the refined paths short.
+         const int runEnd = offset - 1;
+         const int runLength = offset - runStart;
+         if(runLength <= MAX_SINGLE_ENTRANCE_LENGTH)
+         {
+            const int middle = runStart + (runLength - 1) / 2;
+            addEntrance(layer, borderTile(middle), acrossTile(middle));
+         }
+         else
+         {
+            addEntrance(layer, borderTile(runStart), acrossTile(runStart));
+            addEntrance(layer, borderTile(runEnd), acrossTile(runEnd));
+         }
+
+         runStart = -1;
+      }
+   }
+}
+
+void HierarchicalPathGraph::findVerticalBorderEntrances(Layer& layer, int clusterX, int clusterY) const
+{
+   // The border runs down the right edge of the cluster on the left.
+   const geometry::Rectangle clusterBounds = getClusterBounds(clusterY * m_clustersWide + clusterX);
+   const geometry::Point2D start(clusterBounds.right - 1, clusterBounds.top);
+   findEntrances(layer, start, geometry::Point2D(0, 1), geometry::Point2D(1, 0), clusterBounds.getHeight());
+}
+
+void HierarchicalPathGraph::findHorizontalBorderEntrances(Layer& layer, int clusterX, int clusterY) const
+{
+   // The border runs along the bottom edge of the cluster above.
+   const geometry::Rectangle clusterBounds = getClusterBounds(clusterY * m_clustersWide + clusterX);
+   const geometry::Point2D start(clusterBounds.left, clusterBounds.bottom - 1);
+   findEntrances(layer, start, geometry::Point2D(1, 0), geometry::Point2D(0, 1), clusterBounds.getWidth());
+}
+
+void HierarchicalPathGraph::connectClusterNodes(Layer& layer, int clusterIndex) const
+{
+   const std::vector<int>& clusterNodes = layer.clusterNodes[clusterIndex];
+
+   ClusterSearch search;
+   search.setCluster(*this, getClusterBounds(clusterIndex), layer.footprint);
+
+   std::vector<geometry::Point2D> targets;
+   for(unsigned int i = 0; i < clusterNodes.size(); ++i)
+   {
+      // Edges are symmetric, so each entrance only needs to search for the entrances after it.
+      targets.clear();
+      for(unsigned int j = i + 1; j < clusterNodes.size(); ++j)
+      {
+         targets.push_back(layer.nodes[clusterNodes[j]].tile);
+      }
+
+      Node& node = layer.nodes[clusterNodes[i]];
+      search.explore(node.tile, targets);
+
+      for(unsigned int j = i + 1; j < clusterNodes.size(); ++j)
+      {
+         Node& otherNode = layer.nodes[clusterNodes[j]];
+         const float distance = search.getDistance(otherNode.tile);
+         if(distance < std::numeric_limits<float>::infinity())
+         {
+            node.edges.push_back({ clusterNodes[j], distance });
+            otherNode.edges.push_back({ clusterNodes[i], distance });
+         }
+      }
+   }
+}
+
+void HierarchicalPathGraph::update(const Grid<TileState>& grid, const geometry::Rectangle& area)
+{
+   updateClearance(grid, area);
+
+   for(auto& layer : m_layers)
+   {
+      if(layer.footprint == 0)
+      {
+         continue;
+      }
+
+      // Larger entities can no longer stand on the tiles whose squares now overlap the area.
+      const int reach = layer.footprint - 1;
+      updateLayer(layer, geometry::Rectangle(area.top - reach, area.left - reach, area.bottom, area.right));
+   }
+}
+
+void HierarchicalPathGraph::updateLayer(Layer& layer, const geometry::Rectangle& area) const
+{
+   // The clusters overlapping the changed area
+   const int firstX = std::max(area.left - m_bounds.left, 0) / CLUSTER_SIZE;
+   const int firstY = std::max(area.top - m_bounds.top, 0) / CLUSTER_SIZE;
+   const int lastX = std::min((area.right - m_bounds.left) / CLUSTER_SIZE, m_clustersWide - 1);
+   const int lastY = std::min((area.bottom - m_bounds.top) / CLUSTER_SIZE, m_clustersHigh - 1);
+
+   if(firstX > lastX || firstY > lastY)
+   {
+      return;
+   }
+
+   const auto isChanged = [&](int clusterIndex)
+   {
+      const int clusterX = clusterIndex % m_clustersWide;
+      const int clusterY = clusterIndex / m_clustersWide;
+      return clusterX >= firstX && clusterX <= lastX && clusterY >= firstY && clusterY <= lastY;
+   };
+
+   // The changed clusters, along with the clusters sharing a border with them
+   const auto isReconnected = [&](int clusterIndex)
+   {
+      const int clusterX = clusterIndex % m_clustersWide;
+      const int clusterY = clusterIndex / m_clustersWide;
+      const bool inColumns = clusterX >= firstX && clusterX <= lastX;
+      const bool inRows = clusterY >= firstY && clusterY <= lastY;
+      return (inColumns && clusterY >= firstY - 1 && clusterY <= lastY + 1) ||
+         (inRows && clusterX >= firstX - 1 && clusterX <= lastX + 1);
+   };
+
+   // Drop the edges that are about to be found again: the steps across the borders
+   // of the changed clusters, and the edges within the reconnected clusters.
+   for(auto& node : layer.nodes)
+   {
+      if(!isReconnected(node.cluster))
+      {
+         continue;
+      }
+
+      node.edges.erase(std::remove_if(node.edges.begin(), node.edges.end(), [&](const Edge& edge)
+      {
+         const int targetCluster = layer.nodes[edge.target].cluster;
+         return targetCluster == node.cluster || isChanged(node.cluster) || isChanged(targetCluster);
+      }), node.edges.end());
+   }
+
+   // Entrances left without a step across a border no longer exist (or will be added again),
+   // so remove them and compact the remaining node indices.
+   std::vector<int> newIndices(layer.nodes.size(), -1);
+   int numNodes = 0;
+   for(unsigned int i = 0; i < layer.nodes.size(); ++i)
+   {
+      Node& node = layer.nodes[i];
+      if(!node.edges.empty() || !isReconnected(node.cluster))
+      {
+         newIndices[i] = numNodes;
+         if(static_cast<int>(i) != numNodes)
+         {
+            layer.nodes[numNodes] = std::move(node);
+         }
+
+         ++numNodes;
+      }
+      else
+      {
+         layer.nodeIndices(node.tile.x - m_bounds.left, node.tile.y - m_bounds.top) = -1;
+      }
+   }
+
+   layer.nodes.resize(numNodes);
+   for(auto& clusterNodes : layer.clusterNodes)
+   {
+      clusterNodes.clear();
+   }
+
+   for(int i = 0; i < numNodes; ++i)
+   {
+      Node& node = layer.nodes[i];
+      layer.nodeIndices(node.tile.x - m_bounds.left, node.tile.y - m_bounds.top) = i;
+      layer.clusterNodes[node.cluster].push_back(i);
+      for(auto& edge : node.edges)
+      {
+         edge.target = newIndices[edge.target];
+      }
+   }
+
+   // Find the entrances on every border of the changed clusters again
+   for(int clusterY = firstY; clusterY <= lastY; ++clusterY)
+   {
+      for(int clusterX = std::max(firstX - 1, 0); clusterX <= std::min(lastX, m_clustersWide - 2); ++clusterX)
+      {
+         findVerticalBorderEntrances(layer, clusterX, clusterY);
+      }
+   }
+
+   for(int clusterY = std::max(firstY - 1, 0); clusterY <= std::min(lastY, m_clustersHigh - 2); ++clusterY)
+   {
+      for(int clusterX = firstX; clusterX <= lastX; ++clusterX)
+      {
+         findHorizontalBorderEntrances(layer, clusterX, clusterY);
+      }
+   }
+
+   for(int clusterIndex = 0; clusterIndex < static_cast<int>(layer.clusterNodes.size()); ++clusterIndex)
+   {
+      if(isReconnected(clusterIndex))
+      {
+         connectClusterNodes(layer, clusterIndex);
+      }
+   }
+
+   DEBUG("Updated hierarchical path graph for %dx%d entities in clusters %d,%d to %d,%d. It now has %d entrances.", layer.footprint, layer.footprint, firstX, firstY, lastX, lastY, numNodes);
+}
+
+std::vector<geometry::Point2D> HierarchicalPathGraph::findPath(const geometry::Point2D& src, const geometry::Point2D& dst, int footprint) const
+{
+   std::vector<geometry::Point2D> path;
+
+   if(footprint < 1 || footprint > MAX_FOOTPRINT ||
+      !m_bounds.contains(src) || !m_bounds.contains(dst) ||
+      !isPassable(src, footprint) || !isPassable(dst, footprint))
+   {
+      return path;
+   }
+
+   path.push_back(src);
+   if(src == dst)
+   {
+      return path;
+   }
+
+   const int srcCluster = getClusterIndex(src);
+   const int dstCluster = getClusterIndex(dst);
+
+   const Layer& layer = getLayer(footprint);
+   ClusterSearch search;
+
+   // If both ends are in the same cluster, try to get there without leaving it first.
+   if(srcCluster == dstCluster)
+   {
+      search.setCluster(*this, getClusterBounds(srcCluster), footprint);
+      search.explore(src, { dst });
+      if(search.appendPath(dst, path))
+      {
+         return path;
+      }
+   }
+
+   // Temporarily connect the source and destination to the entrances of their clusters.
+   const int numNodes = layer.nodes.size();
+   const int srcNode = numNodes;
+   const int dstNode = numNodes + 1;
+
+   std::vector<geometry::Point2D> targets;
+   std::vector<Edge> srcEdges;
+   std::vector<Edge> dstEdges;
+   const auto connectEndpoint = [&](const geometry::Point2D& endpoint, int clusterIndex, std::vector<Edge>& endpointEdges)
+   {
+      targets.clear();
+      for(const int nodeIndex : layer.clusterNodes[clusterIndex])
+      {
+         targets.push_back(layer.nodes[nodeIndex].tile);
+      }
+
+      search.setCluster(*this, getClusterBounds(clusterIndex), footprint);
+      search.explore(endpoint, targets);
+
+      for(const int nodeIndex : layer.clusterNodes[clusterIndex])
+      {
+         const float distance = search.getDistance(layer.nodes[nodeIndex].tile);
+         if(distance < std::numeric_limits<float>::infinity())
+         {
+            endpointEdges.push_back({ nodeIndex, distance });
+         }
+      }
+   };
+
+   connectEndpoint(src, srcCluster, srcEdges);
+   connectEndpoint(dst, dstCluster, dstEdges);
+
+   const auto getNodeTile = [&](int nodeIndex) -> const geometry::Point2D&
+   {
+      return nodeIndex == srcNode ? src : nodeIndex == dstNode ? dst : layer.nodes[nodeIndex].tile;
+   };
+
+   // A* search over the abstract graph
+   std::vector<float> gCosts(numNodes + 2, std::numeric_limits<float>::infinity());
+   std::vector<int> parents(numNodes + 2, -1);
+   std::vector<char> closed(numNodes + 2, 0);
+
+   SearchQueue openSet;
+   gCosts[srcNode] = 0;
+   openSet.emplace(getOctileDistance(src, dst), srcNode);
+
+   while(!openSet.empty())
+   {
+      const int nodeIndex = openSet.top().second;
+      openSet.pop();
+
+      if(closed[nodeIndex])
+      {
+         continue;
+      }
+
+      closed[nodeIndex] = 1;
+      if(nodeIndex == dstNode)
+      {
+         break;
+      }
+
+      const auto relax = [&](int target, float cost)
+      {
+         const float gCost = gCosts[nodeIndex] + cost;
+         if(!closed[target] && gCost < gCosts[target])
+         {
+            gCosts[target] = gCost;
+            parents[target] = nodeIndex;
+            openSet.emplace(gCost + getOctileDistance(getNodeTile(target), dst), target);
+         }
+      };
+
+      if(nodeIndex == srcNode)
+      {
+         for(const auto& edge : srcEdges)
+         {
+            relax(edge.target, edge.cost);
+         }
+
+         continue;
+      }
+
+      for(const auto& edge : layer.nodes[nodeIndex].edges)
+      {
+         relax(edge.target, edge.cost);
+      }
+
+      if(layer.nodes[nodeIndex].cluster == dstCluster)
+      {
+         for(const auto& edge : dstEdges)
+         {
+            if(edge.target == nodeIndex)
+            {
+               relax(dstNode, edge.cost);
+               break;
+            }
+         }
+      }
+   }
+
+   if(!closed[dstNode])
+   {
+      DEBUG("No hierarchical path from %d,%d to %d,%d", src.x, src.y, dst.x, dst.y);
+      return std::vector<geometry::Point2D>();
+   }
+
+   std::vector<int> abstractPath;
+   for(int nodeIndex = dstNode; nodeIndex != -1; nodeIndex = parents[nodeIndex])
+   {
+      abstractPath.push_back(nodeIndex);
+   }
+
+   std::reverse(abstractPath.begin(), abstractPath.end());
+
+   // Refine each abstract edge into a path of tiles
+   path.resize(1);
+   for(unsigned int i = 1; i < abstractPath.size(); ++i)
+   {
+      const geometry::Point2D& from = getNodeTile(abstractPath[i - 1]);
+      const geometry::Point2D& to = getNodeTile(abstractPath[i]);
+
+      if(from == to)
+      {
+         continue;
+      }
+
+      const int fromCluster = getClusterIndex(from);
+      if(fromCluster == getClusterIndex(to))
+      {
+         search.setCluster(*this, getClusterBounds(fromCluster), footprint);
+         search.explore(from, { to });
+         search.appendPath(to, path);
+      }
+      else
+      {
+         // Entrances in different clusters are always a single step apart.
+         path.push_back(to);
+      }
+   }
+
+   return path;
+}
@@ -0,0 +1,281 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef HIERARCHICAL_PATH_GRAPH_H
+#define HIERARCHICAL_PATH_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Grid.h"
+#include "Point2D.h"
+#include "Rectangle.h"
+
+struct TileState;
+
+/**
+ * An abstraction of a collision grid used for hierarchical pathfinding (HPA*).
+ * The grid is divided into square clusters, and each run of passable tiles along a
+ * border between two clusters gets one or two entrances. Entrances within the same
+ * cluster are joined by edges weighted with their in-cluster travel distance, so that
+ * a path query only needs to search the (small) abstract graph and then refine each
+ * abstract edge with a search bounded to a single cluster.
+ *
+ * Entities larger than a tile are routed on a separate layer of the graph for
+ * their footprint (the width of the square of tiles that they cover). Each tile
+ * is annotated with its clearance: the size of the largest square free of obstacles
+ * whose top-left corner is at the tile. An entity can stand with its top-left corner on
+ * any tile whose clearance is at least its footprint, so each layer is built from
+ * those tiles alone. Only single-tile layers are built up front; the others are
+ * built the first time an entity of that footprint needs a path.
+ *
+ * Tiles are given in grid coordinates (the coordinates used to index the collision grid),
+ * while the graph's own grids are indexed relative to the top-left corner of the grid bounds.
+ *
+ * Unlike the Roy-Floyd-Warshall matrices, the memory used by this graph grows
+ * linearly with the area of the map, which makes it suitable for large maps.
+ *
+ * @author Noam Chitayat
+ */
+class HierarchicalPathGraph final
+{
+   /** The square root of 2. */
+   static const float ROOT_2;
+
+   /** The width and height (in tiles) of each cluster. */
+   static const int CLUSTER_SIZE;
+
+   /** The longest run of border tiles that is represented by a single entrance. */
+   static const int MAX_SINGLE_ENTRANCE_LENGTH;
+
+   /**
+    * A weighted edge between two entrance nodes.
+    */
+   struct Edge
+   {
+      /** The index of the node that this edge leads to. */
+      int target;
+
+      /** The travel distance (in tiles) along this edge. */
+      float cost;
+   };
+
+   /**
+    * An entrance tile on the border of a cluster.
+    */
+   struct Node
+   {
+      /** The location (in tiles) of this entrance. */
+      geometry::Point2D tile;
+
+      /** The index of the cluster containing this entrance. */
+      int cluster;
+
+      /** The edges leaving this entrance. */
+      std::vector<Edge> edges;
+   };
+
+   /**
+    * The abstract graph used by entities of a single footprint.
+    */
+   struct Layer
+   {
+      /** The width and height (in tiles) of the entities using this layer, or 0 if the layer hasn't been built. */
+      int footprint = 0;
+
+      /** The entrance nodes of the abstract graph. */
+      std::vector<Node> nodes;
+
+      /** The indices of the entrance nodes belonging to each cluster. */
+      std::vector<std::vector<int>> clusterNodes;
+
+      /** A mapping from tiles to the entrance node on that tile (or -1 if there is none). */
+      Grid<int> nodeIndices;
+   };
+
+   /**
+    * Scratch space for searches bounded to a single cluster.
+    */
+   class ClusterSearch;
+
+   /** The bounds (in tiles) of the grid. */
+   geometry::Rectangle m_bounds;
+
+   /** The number of clusters along the width of the grid. */
+   int m_clustersWide = 0;
+
+   /** The number of clusters along the height of the grid. */
+   int m_clustersHigh = 0;
+
+   /** The size (in tiles, up to MAX_FOOTPRINT) of the largest square free of obstacles whose top-left corner is at each tile. */
+   Grid<std::uint8_t> m_clearance;
+
+   /**
+    * The layers of the graph, indexed by footprint - 1.
+    * Layers for larger entities are built when they are first needed (see getLayer).
+    */
+   mutable std::vector<Layer> m_layers;
+
+   /**
+    * @param tile A location on the grid (in tiles).
+    *
+    * @return The index of the cluster containing the tile.
+    */
+   int getClusterIndex(const geometry::Point2D& tile) const;
+
+   /**
+    * @param clusterIndex The index of a cluster.
+    *
+    * @return The bounds (in tiles) of the cluster, clipped to the grid bounds.
+    */
+   geometry::Rectangle getClusterBounds(int clusterIndex) const;
+
+   /**
+    * @param tile A location on the grid (in tiles).
+    * @param footprint The width and height (in tiles) of an entity.
+    *
+    * @return true iff the entity can stand with its top-left corner on the tile without overlapping an obstacle.
+    */
+   bool isPassable(const geometry::Point2D& tile, int footprint) const;
+
+   /**
+    * Recalculates the clearance of the tiles that may have been affected by a change to the obstacles in an area.
+    *
+    * @param grid The collision grid.
+    * @param area The area (in tiles, with inclusive edges) whose obstacles changed.
+    */
+   void updateClearance(const Grid<TileState>& grid, const geometry::Rectangle& area);
+
+   /**
+    * @param footprint The width and height (in tiles) of an entity.
+    *
+    * @return The layer of the graph for the footprint, which is built first if it doesn't exist yet.
+    */
+   const Layer& getLayer(int footprint) const;
+
+   /**
+    * Builds the abstract graph of a layer from scratch.
+    *
+    * @param layer The layer to build, with its footprint set.
+    */
+   void buildLayer(Layer& layer) const;
+
+   /**
+    * Rebuilds the part of a layer affected by a change to the passable tiles in an area of the grid.
+    *
+    * @param layer The layer to update.
+    * @param area The area (in tiles, with inclusive edges) whose passable tiles may have changed.
+    */
+   void updateLayer(Layer& layer, const geometry::Rectangle& area) const;
+
+   /**
+    * Gets the entrance node on the given tile, creating one if it doesn't exist yet.
+    *
+    * @param layer The layer to add the node to.
+    * @param tile The location of the entrance (in tiles).
+    *
+    * @return The index of the entrance node.
+    */
+   int addNode(Layer& layer, const geometry::Point2D& tile) const;
+
+   /**
+    * Adds a pair of entrances across a cluster border, joined by a single step.
+    *
+    * @param layer The layer to add the entrances to.
+    * @param first An entrance tile on one side of the border.
+    * @param second The adjacent entrance tile on the other side of the border.
+    */
+   void addEntrance(Layer& layer, const geometry::Point2D& first, const geometry::Point2D& second) const;
+
+   /**
+    * Scans the border between two clusters for runs of tiles that are passable
+    * on both sides of the border and adds entrances for each run.
+    *
+    * @param layer The layer to add the entrances to.
+    * @param start The first tile on the near side of the border.
+    * @param step The step along the border.
+    * @param across The step across the border.
+    * @param length The length (in tiles) of the border.
+    */
+   void findEntrances(Layer& layer, const geometry::Point2D& start, const geometry::Point2D& step, const geometry::Point2D& across, int length) const;
+
+   /**
+    * Adds the entrances along the vertical border between a cluster and the cluster to its right.
+    *
+    * @param layer The layer to add the entrances to.
+    * @param clusterX The column of the cluster to the left of the border.
+    * @param clusterY The row of the clusters on either side of the border.
+    */
+   void findVerticalBorderEntrances(Layer& layer, int clusterX, int clusterY) const;
+
+   /**
+    * Adds the entrances along the horizontal border between a cluster and the cluster below it.
+    *
+    * @param layer The layer to add the entrances to.
+    * @param clusterX The column of the clusters on either side of the border.
+    * @param clusterY The row of the cluster above the border.
+    */
+   void findHorizontalBorderEntrances(Layer& layer, int clusterX, int clusterY) const;
+
+   /**
+    * Connects all of the entrances within a cluster to each other.
+    *
+    * @param layer The layer containing the entrances.
+    * @param clusterIndex The index of the cluster to connect.
+    */
+   void connectClusterNodes(Layer& layer, int clusterIndex) const;
+
+   /**
+    * @param grid The collision grid.
+    * @param tile The tile to check.
+    *
+    * @return true iff the tile is statically blocked.
+    */
+   static bool isObstacle(const Grid<TileState>& grid, const geometry::Point2D& tile);
+
+   /**
+    * @param src The source tile.
+    * @param dst The destination tile.
+    *
+    * @return The octile distance between the two tiles.
+    */
+   static float getOctileDistance(const geometry::Point2D& src, const geometry::Point2D& dst);
+
+   public:
+      /** The largest footprint (in tiles) of the entities that this graph can route. */
+      static const int MAX_FOOTPRINT;
+
+      /**
+       * Constructor. Builds the abstract graph for single-tile entities on the given collision grid.
+       *
+       * @param grid A grid of free spaces and obstacles.
+       * @param gridBounds The rectangle representing the bounds of the grid.
+       */
+      HierarchicalPathGraph(const Grid<TileState>& grid, const geometry::Rectangle& gridBounds);
+
+      /**
+       * Rebuilds the part of the graph affected by a change to the obstacles in an area of the grid.
+       * In each layer, the entrances on the borders of the clusters whose passable tiles changed are found again,
+       * and the entrances within those clusters and their neighbours are reconnected. The rest of the graph is kept.
+       *
+       * @param grid The collision grid that this graph was built for, including the changes.
+       * @param area The area (in tiles, with inclusive edges) whose obstacles changed.
+       */
+      void update(const Grid<TileState>& grid, const geometry::Rectangle& area);
+
+      /**
+       * Finds a path between two tiles for an entity, routing around the static obstacles in the grid.
+       *
+       * @param src The source tile (of the entity's top-left corner).
+       * @param dst The destination tile (of the entity's top-left corner).
+       * @param footprint The width and height (in tiles) of the square covered by the entity, up to MAX_FOOTPRINT.
+       *
+       * @return The tiles to traverse from the source to the destination (inclusive), or an empty list if there is no path.
+       */
+      std::vector<geometry::Point2D> findPath(const geometry::Point2D& src, const geometry::Point2D& dst, int footprint) const;
+};
+
+#endif
@@ -6,9 +6,13 @@
 
 #include "Layer.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "Point2D.h"
 #include "Rectangle.h"
 #include "ResourceLoader.h"
+#include "TileEngine.h"
 #include "Tileset.h"
 #include "tinyxml.h"
 
@@ -73,10 +77,44 @@ Layer::Layer(const TiXmlElement* layerData, const geometry::Rectangle& bounds) :
          m_tileMap(x, y + m_heightOffset) = std::stoi(entry.c_str()) - 1;
       }
    }
+
+   buildTileQuads();
+}
+
+void Layer::buildTileQuads()
+{
+   const unsigned int width = m_bounds.getWidth();
+   const unsigned int height = m_bounds.getHeight();
+
+   std::vector<VertexBuffer::Vertex> vertices;
+   vertices.reserve(width * height * 4);
+
+   m_tileOffsets.clear();
+   m_tileOffsets.reserve(width * height + 1);
+   for(unsigned int row = 0; row < height; ++row)
+   {
+      for(unsigned int column = 0; column < width; ++column)
+      {
+         m_tileOffsets.push_back(vertices.size());
+
+         const int tileNum = m_tileMap(column, row);
+         if(tileNum != -1)
+         {
+            m_tileset->addTileVertices(column, row - m_heightOffset, tileNum, vertices);
+         }
+      }
+   }
+
+   m_tileOffsets.push_back(vertices.size());
+
+   DEBUG("Built %u tile quads for layer.", static_cast<unsigned int>(vertices.size() / 4));
+   m_tileQuads = VertexBuffer(std::move(vertices));
 }
 
 void Layer::forEachCollisionRect(std::function<void(const geometry::Rectangle&)>&& func) const
 {
+   const geometry::Rectangle pixelBounds(geometry::Point2D(m_bounds.left, m_bounds.top) * TileEngine::TILE_SIZE, m_bounds.getSize() * TileEngine::TILE_SIZE);
+
    for(int y = 0; y < m_bounds.getHeight(); ++y)
    {
       for(int x = 0; x < m_bounds.getWidth(); ++x)
@@ -89,8 +127,8 @@ void Layer::forEachCollisionRect(std::function<void(const geometry::Rectangle&)>
 
          const auto rect =
             m_tileset->getCollisionRect(tileNum)
-               .translate(x, y - m_heightOffset)
-               .getIntersection(m_bounds);
+               .translate(x * TileEngine::TILE_SIZE, (y - m_heightOffset) * TileEngine::TILE_SIZE)
+               .getIntersection(pixelBounds);
 
          if(rect.isValid())
          {
@@ -100,15 +138,56 @@ void Layer::forEachCollisionRect(std::function<void(const geometry::Rectangle&)>
    }
 }
 
-void Layer::draw(int row, bool isForeground) const
+int Layer::getHeightOffset() const
 {
-   const unsigned int width = m_bounds.getWidth();
-   for(unsigned int column = 0; column < width; ++column)
+   return m_heightOffset;
+}
+
+void Layer::drawTiles(unsigned int firstTile, unsigned int lastTile, bool isForeground) const
+{
+   const unsigned int firstVertex = m_tileOffsets[firstTile];
+   const unsigned int lastVertex = m_tileOffsets[lastTile];
+   if(firstVertex < lastVertex)
    {
-      const int tileNum = m_tileMap(column, row);
-      if(tileNum != -1)
-      {
-         m_tileset->draw(column, row - m_heightOffset, tileNum, isForeground);
-      }
+      m_tileset->draw(m_tileQuads, firstVertex, lastVertex - firstVertex, isForeground);
+   }
+}
+
+void Layer::draw(const geometry::Rectangle& area, bool isForeground) const
+{
+   const int width = m_bounds.getWidth();
+   const int height = m_bounds.getHeight();
+
+   // Tiles in a layer with a height offset appear higher up on the map than their rows.
+   const int firstRow = std::max(area.top + m_heightOffset, 0);
+   const int lastRow = std::min(area.bottom + m_heightOffset, height);
+   const int firstColumn = std::max(area.left, 0);
+   const int lastColumn = std::min(area.right, width);
+   if(firstRow >= lastRow || firstColumn >= lastColumn)
+   {
+      return;
+   }
+
+   if(firstColumn == 0 && lastColumn == width)
+   {
+      // Whole rows are stored one after the other, so they can all be drawn at once.
+      drawTiles(firstRow * width, lastRow * width, isForeground);
+      return;
+   }
+
+   for(int row = firstRow; row < lastRow; ++row)
+   {
+      drawTiles(row * width + firstColumn, row * width + lastColumn, isForeground);
+   }
+}
+
+void Layer::draw(int row, const geometry::Rectangle& area, bool isForeground) const
+{
+   const int drawnRow = row - m_heightOffset;
+   if(drawnRow < area.top || drawnRow >= area.bottom)
+   {
+      return;
    }
+
+   draw(geometry::Rectangle(drawnRow, area.left, drawnRow + 1, area.right), isForeground);
 }
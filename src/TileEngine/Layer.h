@@ -10,8 +10,10 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "Grid.h"
+#include "VertexBuffer.h"
 
 namespace geometry
 {
@@ -38,6 +40,29 @@ class Layer final
    /** The height offset (in tiles) of this layer. */
    int m_heightOffset = 0;
 
+   /** The quads for every tile in the layer, in row order, built once when the layer is loaded. */
+   VertexBuffer m_tileQuads;
+
+   /**
+    * The index of the first tile quad vertex at or after each tile, in row order (followed by the total vertex count).
+    * The quads for any run of tiles within a row lie between the offsets of its first tile and the tile after its last.
+    */
+   std::vector<unsigned int> m_tileOffsets;
+
+   /**
+    * Builds the tile quads for the layer's tiles.
+    */
+   void buildTileQuads();
+
+   /**
+    * Draws the tile quads between two tiles with a single draw call.
+    *
+    * @param firstTile The index of the first tile to draw (in row order).
+    * @param lastTile The index of the tile after the last tile to draw (in row order).
+    * @param isForeground Set true iff this layer is being drawn in the foreground.
+    */
+   void drawTiles(unsigned int firstTile, unsigned int lastTile, bool isForeground) const;
+
    public:
       /**
        * Constructor.
@@ -50,17 +75,31 @@ class Layer final
       /**
        * Perform the given function for each collision rectangle in this layer.
        *
-       * @param func The iterator function to perform on each collision rectangle.
+       * @param func The iterator function to perform on each collision rectangle (in pixels).
        */
       void forEachCollisionRect(std::function<void(const geometry::Rectangle&)>&& func) const;
 
       /**
-       * Draws a row of the layer to screen.
+       * @return The height offset (in tiles) of this layer.
+       */
+      int getHeightOffset() const;
+
+      /**
+       * Draws the tiles of the layer that appear within an area of the map.
+       *
+       * @param area The area to draw (in tiles, relative to where the tiles appear on the map).
+       * @param isForeground Set true iff this layer is being drawn in the foreground.
+       */
+      void draw(const geometry::Rectangle& area, bool isForeground = false) const;
+
+      /**
+       * Draws the tiles in a row of the layer that appear within an area of the map.
        *
        * @param row The row to draw from the layer.
+       * @param area The area to draw (in tiles, relative to where the tiles appear on the map).
        * @param isForeground Set true iff this layer is being drawn in the foreground.
        */
-      void draw(int row, bool isForeground = false) const;
+      void draw(int row, const geometry::Rectangle& area, bool isForeground = false) const;
 };
 
 #endif
@@ -119,6 +119,85 @@ static int TileEngineL_GetNPC(lua_State* luaVM)
    return 1;
 }
 
+/**
+ * Pushes a Lua array of actors onto the stack.
+ *
+ * @param luaVM The Lua VM to push the array onto.
+ * @param actors The actors to put in the array.
+ */
+static void pushActorList(lua_State* luaVM, const std::vector<Actor*>& actors)
+{
+   lua_createtable(luaVM, actors.size(), 0);
+   for(unsigned int i = 0; i < actors.size(); ++i)
+   {
+      luaW_push<Actor>(luaVM, actors[i]);
+      lua_rawseti(luaVM, -2, i + 1);
+   }
+}
+
+static int TileEngineL_GetActorsInArea(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine == nullptr)
+   {
+      return lua_error(luaVM);
+   }
+
+   geometry::Point2D topLeft;
+   if(!ScriptUtilities::getParameter(luaVM, 2, 1, "x", topLeft.x))
+   {
+      return lua_error(luaVM);
+   }
+
+   if(!ScriptUtilities::getParameter(luaVM, 2, 2, "y", topLeft.y))
+   {
+      return lua_error(luaVM);
+   }
+
+   geometry::Size size;
+   if(!ScriptUtilities::getParameter(luaVM, 2, 3, "width", size.width))
+   {
+      return lua_error(luaVM);
+   }
+
+   if(!ScriptUtilities::getParameter(luaVM, 2, 4, "height", size.height))
+   {
+      return lua_error(luaVM);
+   }
+
+   pushActorList(luaVM, tileEngine->getActorsInArea(geometry::Rectangle(topLeft, size)));
+   return 1;
+}
+
+static int TileEngineL_GetActorsNear(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine == nullptr)
+   {
+      return lua_error(luaVM);
+   }
+
+   geometry::Point2D center;
+   if(!ScriptUtilities::getParameter(luaVM, 2, 1, "x", center.x))
+   {
+      return lua_error(luaVM);
+   }
+
+   if(!ScriptUtilities::getParameter(luaVM, 2, 2, "y", center.y))
+   {
+      return lua_error(luaVM);
+   }
+
+   int radius;
+   if(!ScriptUtilities::getParameter(luaVM, 2, 3, "radius", radius))
+   {
+      return lua_error(luaVM);
+   }
+
+   pushActorList(luaVM, tileEngine->getActorsNear(center, radius));
+   return 1;
+}
+
 static int TileEngineL_FollowWithCamera(lua_State* luaVM)
 {
    TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
@@ -226,6 +305,8 @@ static luaL_Reg tileEngineMetatable[] =
    { "addNPC", TileEngineL_AddNPC },
    { "addTriggerListener", TileEngineL_AddTriggerListener },
    { "getNPC", TileEngineL_GetNPC },
+   { "getActorsInArea", TileEngineL_GetActorsInArea },
+   { "getActorsNear", TileEngineL_GetActorsNear },
    { "lockCameraToTarget", TileEngineL_FollowWithCamera },
    { "unlockCamera", TileEngineL_ReleaseCamera },
    { "slideCamera", TileEngineL_SlideCamera },
@@ -6,6 +6,8 @@
 
 #include "Map.h"
 
+#include <algorithm>
+
 #include "EnumUtils.h"
 #include "Layer.h"
 #include "NPCSpawnMarker.h"
@@ -22,7 +24,8 @@
 #define DRAW_IMPASSIBILITY 0
 
 Map::Map(const std::string& name, const std::string& filePath) :
-   m_name(name)
+   m_name(name),
+   m_movementTileSize(TileEngine::TILE_SIZE)
 {
    DEBUG("Loading map file %s", filePath.c_str());
 
@@ -55,6 +58,8 @@ Map::Map(const std::string& name, const std::string& filePath) :
 
    m_bounds = geometry::Rectangle(geometry::Point2D::ORIGIN, geometry::Size(width, height));
 
+   parseMapProperties(root->FirstChildElement("properties"));
+
    const TiXmlElement* layerElement = root->FirstChildElement("layer");
    while(layerElement != nullptr)
    {
@@ -118,6 +123,8 @@ Map::Map(const std::string& name, const std::string& filePath) :
       objectGroupElement = objectGroupElement->NextSiblingElement("objectgroup");
    }
 
+   initializeZoneIndices();
+
    DEBUG("Map loaded.");
 }
 
@@ -125,7 +132,42 @@ Map::~Map() = default;
 
 void Map::addCollisionRect(const geometry::Rectangle& rect)
 {
-   m_passibilityMap.fillRect(rect, 0);
+   const geometry::Rectangle passibilityBounds(geometry::Point2D::ORIGIN, m_bounds.getSize() * (TileEngine::TILE_SIZE / m_movementTileSize));
+
+   // Round outward, so that any movement tile partially covered by the rectangle is impassible.
+   const geometry::Rectangle tileRect(
+      rect.top / m_movementTileSize,
+      rect.left / m_movementTileSize,
+      (rect.bottom + m_movementTileSize - 1) / m_movementTileSize,
+      (rect.right + m_movementTileSize - 1) / m_movementTileSize);
+
+   m_passibilityMap.fillRect(tileRect.getIntersection(passibilityBounds), 0);
+}
+
+void Map::parseMapProperties(const TiXmlElement* propertiesElement)
+{
+   if(propertiesElement == nullptr)
+   {
+      return;
+   }
+
+   const TiXmlElement* propertyElement = propertiesElement->FirstChildElement("property");
+   while(propertyElement != nullptr)
+   {
+      if(std::string(propertyElement->Attribute("name")) == "movementResolution")
+      {
+         propertyElement->Attribute("value", &m_movementTileSize);
+         if(m_movementTileSize <= 0 || TileEngine::TILE_SIZE % m_movementTileSize != 0)
+         {
+            DEBUG("Movement resolution %d does not evenly divide the tile size %d.", m_movementTileSize, TileEngine::TILE_SIZE);
+            T_T("Failed to parse map data.");
+         }
+
+         DEBUG("Using a movement resolution of %d pixels.", m_movementTileSize);
+      }
+
+      propertyElement = propertyElement->NextSiblingElement("property");
+   }
 }
 
 void Map::parseCollisionGroup(const TiXmlElement* collisionGroupElement)
@@ -145,7 +187,7 @@ void Map::parseCollisionGroup(const TiXmlElement* collisionGroupElement)
          objectElement->Attribute("width", &width);
          objectElement->Attribute("height", &height);
 
-         geometry::Rectangle rect(topLeft / TileEngine::TILE_SIZE, geometry::Size(width, height) / TileEngine::TILE_SIZE);
+         geometry::Rectangle rect(topLeft, geometry::Size(width, height));
          DEBUG("Found collision object at %d,%d with width %d and height %d.", rect.left, rect.top, rect.getWidth(), rect.getHeight());
          addCollisionRect(rect);
 
@@ -359,7 +401,7 @@ bool Map::isPassible(int x, int y) const
 
 void Map::initializePassibilityMatrix()
 {
-   const auto& size = m_bounds.getSize();
+   const auto size = m_bounds.getSize() * (TileEngine::TILE_SIZE / m_movementTileSize);
    
    m_passibilityMap.resize(size, 1);
 
@@ -374,6 +416,23 @@ void Map::initializePassibilityMatrix()
    }
 }
 
+void Map::initializeZoneIndices()
+{
+   const auto size = m_bounds.getSize() * TileEngine::TILE_SIZE;
+
+   m_mapExitIndex.reset(size);
+   for(unsigned int i = 0; i < m_mapExits.size(); ++i)
+   {
+      m_mapExitIndex.addZone(i, m_mapExits[i].getBounds());
+   }
+
+   m_triggerZoneIndex.reset(size);
+   for(unsigned int i = 0; i < m_triggerZones.size(); ++i)
+   {
+      m_triggerZoneIndex.addZone(i, m_triggerZones[i].getBounds());
+   }
+}
+
 const std::string& Map::getName() const
 {
    return m_name;
@@ -384,16 +443,31 @@ const geometry::Rectangle& Map::getBounds() const
    return m_bounds;
 }
 
+int Map::getMovementTileSize() const
+{
+   return m_movementTileSize;
+}
+
 const std::vector<TriggerZone>& Map::getTriggerZones() const
 {
    return m_triggerZones;
 }
 
+const std::vector<unsigned int>& Map::getTriggerZonesNear(const geometry::Point2D& point) const
+{
+   return m_triggerZoneIndex.getZonesNear(point);
+}
+
 const std::vector<MapExit>& Map::getMapExits() const
 {
    return m_mapExits;
 }
 
+const std::vector<unsigned int>& Map::getMapExitsNear(const geometry::Point2D& point) const
+{
+   return m_mapExitIndex.getZonesNear(point);
+}
+
 const std::vector<NPCSpawnMarker>& Map::getNPCSpawnMarkers() const
 {
    return m_npcsToSpawn;
@@ -415,30 +489,56 @@ void Map::step(long timePassed) const
 {
 }
 
-void Map::drawBackground(int row) const
+int Map::getMaxHeightOffset() const
 {
+   int maxHeightOffset = 0;
+   for(const auto& layer : m_foregroundLayers)
+   {
+      maxHeightOffset = std::max(maxHeightOffset, layer->getHeightOffset());
+   }
+
+   return maxHeightOffset;
+}
+
+void Map::drawBackground(const geometry::Rectangle& area) const
+{
+   // Nothing is drawn between the background layers, so each one is drawn whole.
    bool firstLayer = true;
    for(const auto& layer : m_backgroundLayers)
    {
-      layer->draw(row, !firstLayer);
+      layer->draw(area, !firstLayer);
       firstLayer = false;
    }
 }
 
-void Map::drawForeground(int row) const
+void Map::drawForeground(int row, const geometry::Rectangle& area) const
 {
    for(const auto& layer : m_foregroundLayers)
    {
-      layer->draw(row, true);
+      layer->draw(row, area, true);
    }
 
-   if(DRAW_IMPASSIBILITY)
+   if(DRAW_IMPASSIBILITY && row >= area.top && row < area.bottom)
    {
-      const unsigned int width = m_bounds.getWidth();
+      const int firstColumn = std::max(area.left, 0);
+      const int lastColumn = std::min(area.right, static_cast<int>(m_bounds.getWidth()));
+      const int movementTilesPerTile = TileEngine::TILE_SIZE / m_movementTileSize;
       
-      for(unsigned int column = 0; column < width; ++column)
+      for(int column = firstColumn; column < lastColumn; ++column)
       {
-         if(!isPassible(column, row))
+         // Highlight the drawn tiles that have any impassible movement tiles.
+         const int left = column * movementTilesPerTile;
+         const int top = row * movementTilesPerTile;
+         bool passible = true;
+         for(int y = top; y < top + movementTilesPerTile && passible; ++y)
+         {
+            for(int x = left; x < left + movementTilesPerTile && passible; ++x)
+            {
+               passible = isPassible(x, y);
+            }
+         }
+
+         if(!passible)
          {
             Tileset::drawColorToTile(column, row, 1.0f, 0.0f, 0.0f, 0.2f);
          }
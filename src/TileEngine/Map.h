@@ -22,6 +22,7 @@
 #include "Rectangle.h"
 #include "Size.h"
 #include "TriggerZone.h"
+#include "ZoneIndex.h"
 
 class Layer;
 struct NPCSpawnMarker;
@@ -45,31 +46,54 @@ class Map final
    /** Foreground layers, which are drawn in front of the sprite layer (in front of NPCs, player, etc.) */
    std::vector<std::unique_ptr<Layer>> m_foregroundLayers;
 
-   /** The passibility of the map. Typed as int to avoid vector<bool> specialization. */
+   /**
+    * The passibility of each movement tile of the map (see m_movementTileSize).
+    * Typed as int to avoid vector<bool> specialization.
+    */
    Grid<int> m_passibilityMap;
 
    /** The list of the map's trigger zones */
    std::vector<TriggerZone> m_triggerZones;
 
+   /** The trigger zones near each part of the map */
+   ZoneIndex m_triggerZoneIndex;
+
    /** The list of the map's entrances */
    std::map<std::string, geometry::Point2D> m_mapEntrances;
 
    /** The list of the map's exits */
    std::vector<MapExit> m_mapExits;
 
+   /** The exits near each part of the map */
+   ZoneIndex m_mapExitIndex;
+
    /** The list of NPCs to create when the map is loaded */
    std::vector<NPCSpawnMarker> m_npcsToSpawn;
 
    /** The bounds (in tiles) of this map */
    geometry::Rectangle m_bounds;
 
+   /**
+    * The size (in pixels) of the tiles used for collision and movement on this map,
+    * which evenly divides the size of the drawn tiles. Smaller movement tiles allow
+    * finer collision (e.g. for furniture), but give the pathfinder more tiles to search.
+    * Best path queries stay cheap, but the flow fields built for destinations shared by
+    * several movers search every tile of the map.
+    */
+   int m_movementTileSize;
+
    /**
     * Adds an collision rectangle to the passibility map, marking
-    * the area occupied by the rectangle as impassible.
+    * every movement tile touched by the rectangle as impassible.
     *
-    * @param rect The map subregion that should be marked impassible
+    * @param rect The map subregion (in pixels) that should be marked impassible
     */
    void addCollisionRect(const geometry::Rectangle& rect);
+
+   /**
+    * Parse the properties of the map itself.
+    */
+   void parseMapProperties(const TiXmlElement* propertiesElement);
    
    /**
     * Parse the map layer that holds collision data.
@@ -101,6 +125,11 @@ class Map final
     */
    void initializePassibilityMatrix();
 
+   /**
+    * Indexes the map's exits and trigger zones by the parts of the map that they cover.
+    */
+   void initializeZoneIndices();
+
    public:
       /**
        * Constructor. Loads map data from a Region file.
@@ -130,11 +159,23 @@ class Map final
        */
       const geometry::Rectangle& getBounds() const;
 
+      /**
+       * @return The size (in pixels) of the tiles used for collision and movement on this map.
+       */
+      int getMovementTileSize() const;
+
       /**
        * @return The list of trigger zones for this map
        */
       const std::vector<TriggerZone>& getTriggerZones() const;
 
+      /**
+       * @param point A point on the map (in pixels).
+       *
+       * @return The indices (into the list of trigger zones) of the trigger zones that could contain the point.
+       */
+      const std::vector<unsigned int>& getTriggerZonesNear(const geometry::Point2D& point) const;
+
       /**
        * @param previousMap The name of the map that the player is entering this map from.
        *
@@ -147,13 +188,23 @@ class Map final
        */
       const std::vector<MapExit>& getMapExits() const;
 
+      /**
+       * @param point A point on the map (in pixels).
+       *
+       * @return The indices (into the list of exits) of the exits that could contain the point.
+       */
+      const std::vector<unsigned int>& getMapExitsNear(const geometry::Point2D& point) const;
+
       /**
        * @return The list of NPCs to spawn for this map
        */
       const std::vector<NPCSpawnMarker>& getNPCSpawnMarkers() const;
    
       /**
-       * @return true iff the tile at this location of the map is passible
+       * @param x The x-coordinate of the movement tile.
+       * @param y The y-coordinate of the movement tile.
+       *
+       * @return true iff the movement tile at this location of the map is passible
        */
       bool isPassible(int x, int y) const;
 
@@ -164,18 +215,24 @@ class Map final
       void step(long timePassed) const;
 
       /**
-       * Draw a row of the map's background.
+       * @return The largest height offset (in tiles) of the map's foreground layers.
+       */
+      int getMaxHeightOffset() const;
+
+      /**
+       * Draw the map's background.
        *
-       * @param row The row of the background to draw.
+       * @param area The visible area of the map (in tiles). Tiles that appear outside of it are not drawn.
        */
-      void drawBackground(int row) const;
+      void drawBackground(const geometry::Rectangle& area) const;
 
       /**
        * Draw a row of the map's foreground.
        *
        * @param row The row of the foreground to draw.
+       * @param area The visible area of the map (in tiles). Tiles that appear outside of it are not drawn.
        */
-      void drawForeground(int row) const;
+      void drawForeground(int row, const geometry::Rectangle& area) const;
 };
 
 #endif
@@ -0,0 +1,146 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "MapBackgroundCache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "GraphicsUtil.h"
+#include "Map.h"
+#include "Rectangle.h"
+#include "TileEngine.h"
+
+#include "DebugUtils.h"
+
+#define DEBUG_FLAG DEBUG_TILE_ENG
+
+const int MapBackgroundCache::CHUNK_SIZE = 512;
+
+// Each chunk takes up 1MB of texture memory.
+const unsigned int MapBackgroundCache::MAX_CHUNKS = 64;
+
+namespace
+{
+   std::uint64_t getChunkKey(int chunkX, int chunkY)
+   {
+      return (std::uint64_t(std::uint32_t(chunkY)) << 32) | std::uint32_t(chunkX);
+   }
+};
+
+bool MapBackgroundCache::isSupported()
+{
+   return GraphicsUtil::getInstance()->getExtensions().isFrameBuffersEnabled();
+}
+
+void MapBackgroundCache::clear()
+{
+   m_chunks.clear();
+}
+
+ScreenTexture MapBackgroundCache::renderChunk(const Map& map, int chunkX, int chunkY)
+{
+   DEBUG("Rendering background chunk %d,%d", chunkX, chunkY);
+
+   const int chunkLeft = chunkX * CHUNK_SIZE;
+   const int chunkTop = chunkY * CHUNK_SIZE;
+
+   const geometry::Rectangle chunkTiles(
+      chunkTop / TileEngine::TILE_SIZE,
+      chunkLeft / TileEngine::TILE_SIZE,
+      (chunkTop + CHUNK_SIZE + TileEngine::TILE_SIZE - 1) / TileEngine::TILE_SIZE,
+      (chunkLeft + CHUNK_SIZE + TileEngine::TILE_SIZE - 1) / TileEngine::TILE_SIZE);
+
+   return ScreenTexture::create(geometry::Size(CHUNK_SIZE, CHUNK_SIZE), [&map, &chunkTiles, chunkLeft, chunkTop]()
+   {
+      glTranslated(-chunkLeft, -chunkTop, 0.0);
+      map.drawBackground(chunkTiles);
+   });
+}
+
+void MapBackgroundCache::evictChunks()
+{
+   while(m_chunks.size() > MAX_CHUNKS)
+   {
+      const auto leastRecentlyDrawn = std::min_element(m_chunks.begin(), m_chunks.end(),
+         [](const std::pair<const std::uint64_t, Chunk>& lhs, const std::pair<const std::uint64_t, Chunk>& rhs)
+         {
+            return lhs.second.lastDrawnFrame < rhs.second.lastDrawnFrame;
+         });
+
+      // Never throw away a chunk that is on screen
+      if(leastRecentlyDrawn->second.lastDrawnFrame == m_currentFrame)
+      {
+         return;
+      }
+
+      m_chunks.erase(leastRecentlyDrawn);
+   }
+}
+
+void MapBackgroundCache::draw(const Map& map, const geometry::Rectangle& area)
+{
+   ++m_currentFrame;
+
+   const geometry::Rectangle mapPixelBounds(geometry::Point2D::ORIGIN, map.getBounds().getSize() * TileEngine::TILE_SIZE);
+   const geometry::Rectangle pixelArea = geometry::Rectangle(
+      area.top * TileEngine::TILE_SIZE,
+      area.left * TileEngine::TILE_SIZE,
+      area.bottom * TileEngine::TILE_SIZE,
+      area.right * TileEngine::TILE_SIZE).getIntersection(mapPixelBounds);
+
+   if(!pixelArea.isValid())
+   {
+      return;
+   }
+
+   const int firstChunkX = pixelArea.left / CHUNK_SIZE;
+   const int firstChunkY = pixelArea.top / CHUNK_SIZE;
+   const int lastChunkX = (pixelArea.right + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   const int lastChunkY = (pixelArea.bottom + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+   glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+   glEnable(GL_TEXTURE_2D);
+
+   for(int chunkY = firstChunkY; chunkY < lastChunkY; ++chunkY)
+   {
+      for(int chunkX = firstChunkX; chunkX < lastChunkX; ++chunkX)
+      {
+         const std::uint64_t key = getChunkKey(chunkX, chunkY);
+         auto chunkIter = m_chunks.find(key);
+         if(chunkIter == m_chunks.end())
+         {
+            chunkIter = m_chunks.emplace(key, Chunk{renderChunk(map, chunkX, chunkY), m_currentFrame}).first;
+         }
+
+         Chunk& chunk = chunkIter->second;
+         chunk.lastDrawnFrame = m_currentFrame;
+
+         // Chunks along the right and bottom edges of the map hang over them, so only draw the part on the map.
+         const geometry::Rectangle chunkBounds(geometry::Point2D(chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE), geometry::Size(CHUNK_SIZE, CHUNK_SIZE));
+         const geometry::Rectangle drawnBounds = chunkBounds.getIntersection(mapPixelBounds);
+
+         // Captured textures are flipped vertically, so the top of the chunk is at the top of the texture.
+         const float left = float(drawnBounds.left - chunkBounds.left) / CHUNK_SIZE;
+         const float right = float(drawnBounds.right - chunkBounds.left) / CHUNK_SIZE;
+         const float top = 1.0f - float(drawnBounds.top - chunkBounds.top) / CHUNK_SIZE;
+         const float bottom = 1.0f - float(drawnBounds.bottom - chunkBounds.top) / CHUNK_SIZE;
+
+         chunk.texture.bind();
+
+         glBegin(GL_QUADS);
+            glTexCoord2f(left, top); glVertex3f(float(drawnBounds.left), float(drawnBounds.top), 0.0f);
+            glTexCoord2f(right, top); glVertex3f(float(drawnBounds.right), float(drawnBounds.top), 0.0f);
+            glTexCoord2f(right, bottom); glVertex3f(float(drawnBounds.right), float(drawnBounds.bottom), 0.0f);
+            glTexCoord2f(left, bottom); glVertex3f(float(drawnBounds.left), float(drawnBounds.bottom), 0.0f);
+         glEnd();
+      }
+   }
+
+   glPopAttrib();
+
+   evictChunks();
+}
@@ -0,0 +1,97 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef MAP_BACKGROUND_CACHE_H
+#define MAP_BACKGROUND_CACHE_H
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "ScreenTexture.h"
+
+class Map;
+
+namespace geometry
+{
+   struct Rectangle;
+};
+
+/**
+ * Keeps pre-rendered copies of a map's background layers, split into square chunks.
+ * The background layers never change once the map is loaded, so each chunk is
+ * rendered (through an FBO) the first time it comes into view, and is then drawn
+ * as a single textured quad no matter how many layers went into it.
+ *
+ * Only a limited number of chunks are kept; the chunks that went the longest
+ * without being drawn are thrown away first.
+ *
+ * @author Noam Chitayat
+ */
+class MapBackgroundCache final
+{
+   /** The width and height of each chunk (in pixels). */
+   static const int CHUNK_SIZE;
+
+   /** The largest number of chunks to keep at once. */
+   static const unsigned int MAX_CHUNKS;
+
+   /**
+    * A pre-rendered chunk of the background.
+    */
+   struct Chunk
+   {
+      /** The texture holding the rendered background. */
+      ScreenTexture texture;
+
+      /** The frame in which the chunk was last drawn. */
+      unsigned long lastDrawnFrame;
+   };
+
+   /** The rendered chunks, keyed by their packed chunk coordinates. */
+   std::unordered_map<std::uint64_t, Chunk> m_chunks;
+
+   /** The number of frames drawn so far. */
+   unsigned long m_currentFrame = 0;
+
+   /**
+    * Renders a chunk of the map's background.
+    *
+    * @param map The map to render.
+    * @param chunkX The x-coordinate of the chunk (in chunks).
+    * @param chunkY The y-coordinate of the chunk (in chunks).
+    *
+    * @return The texture holding the rendered chunk.
+    */
+   static ScreenTexture renderChunk(const Map& map, int chunkX, int chunkY);
+
+   /**
+    * Throws away the chunks that went the longest without being drawn,
+    * until no more than MAX_CHUNKS remain.
+    */
+   void evictChunks();
+
+   public:
+      /**
+       * @return true iff the background can be cached on this device.
+       */
+      static bool isSupported();
+
+      /**
+       * Throws away all the rendered chunks (e.g. when a different map is loaded).
+       */
+      void clear();
+
+      /**
+       * Draws the part of the map's background that appears within an area of the map,
+       * rendering any chunks that aren't cached yet.
+       *
+       * @param map The map to draw.
+       * @param area The area to draw (in tiles).
+       */
+      void draw(const Map& map, const geometry::Rectangle& area);
+};
+
+#endif
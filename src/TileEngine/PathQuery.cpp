@@ -0,0 +1,34 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "PathQuery.h"
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_PATHFINDER
+
+Pathfinder::PathQuery::PathQuery(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm) :
+   m_src(src),
+   m_dst(dst),
+   m_size(size),
+   m_algorithm(algorithm),
+   m_ready(false)
+{
+}
+
+bool Pathfinder::PathQuery::isReady() const
+{
+   return m_ready;
+}
+
+const Pathfinder::Path& Pathfinder::PathQuery::getPath() const
+{
+   if(!m_ready)
+   {
+      T_T("Requested a path before the path query was solved.");
+   }
+
+   return m_path;
+}
@@ -0,0 +1,68 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATH_QUERY_H
+#define PATH_QUERY_H
+
+#include <atomic>
+
+#include "Pathfinder.h"
+#include "Point2D.h"
+#include "Size.h"
+
+/**
+ * A handle to a path request that is solved asynchronously by the Pathfinder's workers.
+ * The requester polls the handle once per frame until the path is ready.
+ * Releasing every reference to the handle abandons the request.
+ *
+ * @author Noam Chitayat
+ */
+class Pathfinder::PathQuery final
+{
+   friend class Pathfinder;
+
+   /** The coordinates of the source (in pixels). */
+   const geometry::Point2D m_src;
+
+   /** The coordinates of the destination (in pixels). */
+   const geometry::Point2D m_dst;
+
+   /** The size of the moving entity. */
+   const geometry::Size m_size;
+
+   /** The search algorithm to solve the request with. */
+   const SearchAlgorithm m_algorithm;
+
+   /** The path found for the request. Only written by the worker that solves the request, before it is marked ready. */
+   Path m_path;
+
+   /** Set once the path has been written. */
+   std::atomic<bool> m_ready;
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       * @param algorithm The search algorithm to solve the request with.
+       */
+      PathQuery(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm);
+
+      /**
+       * @return true iff the request has been solved and the path can be retrieved.
+       */
+      bool isReady() const;
+
+      /**
+       * @return The path found for the request (empty if there is no path).
+       * Must only be called once the request is ready.
+       */
+      const Path& getPath() const;
+};
+
+#endif
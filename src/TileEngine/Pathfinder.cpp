@@ -5,333 +5,1603 @@
  */
 
 #include "Pathfinder.h"
-#include "EntityGrid.h"
+#include "BitGrid.h"
+#include "PathQuery.h"
 #include "Point2D.h"
+#include "ReservationTable.h"
 #include "TileState.h"
+#include "WorkerPool.h"
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <chrono>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <queue>
 #include <tuple>
+#include <unordered_map>
 
 #include "DebugUtils.h"
 #define DEBUG_FLAG DEBUG_PATHFINDER
 
 const float Pathfinder::ROOT_2 = 1.41421356f;
+const unsigned int Pathfinder::MAX_RFW_TILES = 40 * 40;
+const unsigned int Pathfinder::MAX_PATH_QUERIES_PER_FRAME = 8;
+const unsigned int Pathfinder::MAX_PATH_WORKERS = 4;
+const unsigned int Pathfinder::MAX_CACHED_PATHS = 64;
+const unsigned int Pathfinder::MAX_SEGMENT_LENGTH = 128;
+const unsigned int Pathfinder::MAX_GRID_SNAPSHOTS = 2;
+const unsigned int Pathfinder::MAX_SNAPSHOT_CHANGES = 512;
+
+struct Pathfinder::GridSnapshot
+{
+   /** The tiles of the grid. */
+   Grid<TileState> tiles;
+
+   /** One bit per tile, set for every tile that isn't free. */
+   BitGrid occupancy;
+
+   /** The size (in tiles) of the largest free square at each tile. */
+   Grid<std::uint8_t> clearance;
+
+   /** The areas (in tiles, with inclusive edges) of the grid that changed since the snapshot was taken. */
+   std::vector<geometry::Rectangle> changedAreas;
+
+   /** Whether more areas changed than are tracked, so the whole grid has to be copied again. */
+   bool stale = false;
+};
 
 Pathfinder::Pathfinder() = default;
 
-void Pathfinder::initialize(const Grid<TileState>& grid, int tileSize, const geometry::Rectangle& gridBounds)
+Pathfinder::~Pathfinder()
+{
+   // Let any running searches finish before the state they use is destroyed.
+   *m_pathJobsAbandoned = true;
+   m_pathJobs.wait();
+}
+
+void Pathfinder::abandonPathJobs()
+{
+   *m_pathJobsAbandoned = true;
+   m_pathJobsAbandoned = std::make_shared<std::atomic<bool>>(false);
+   m_pathJobs.waitForRunningJobs();
+}
+
+void Pathfinder::initialize(const Grid<TileState>& grid, const BitGrid& occupancyGrid, const Grid<std::uint8_t>& clearanceGrid, const Grid<unsigned int>& componentGrid, const unsigned long& collisionEpoch, int tileSize, const geometry::Rectangle& gridBounds)
 {
    DEBUG("Resetting pathfinder...");
+   if(!isRoyFloydWarshallCalculationReady())
+   {
+      // An unfinished calculation for the old grid would keep a worker busy, and no search
+      // can be using its matrices yet, so abandon it right away (canceling doesn't block).
+      m_royFloydWarshallCalculation.cancel();
+   }
+
+   // Running searches may still be using the RFW matrices, which are about to be replaced.
+   abandonPathJobs();
+
+   // Requests made on the old grid no longer make sense, so complete them without a path.
+   for(const auto& query : m_pendingQueries)
+   {
+      query->m_ready = true;
+   }
+
+   m_pendingQueries.clear();
+
    m_movementTileSize = tileSize;
    m_collisionGrid = &grid;
+   m_occupancyGrid = &occupancyGrid;
+   m_clearanceGrid = &clearanceGrid;
+   m_componentGrid = &componentGrid;
+   m_collisionEpoch = &collisionEpoch;
    m_collisionGridBounds = &gridBounds;
+   m_pathCache.reset();
+
+   // The snapshots are copies of the old grid, which may not even be the same size.
+   m_gridSnapshots.clear();
    
-   m_royFloydWarshallCalculation.runTask(
-                                      &RoyFloydWarshallMatrices::calculateRoyFloydWarshallMatrices,
-                                      m_collisionGrid,
-                                      m_collisionGridBounds);
+   // The graph is cheap to build compared to the RFW matrices, and it routes the entities that cover more than one tile.
+   m_hierarchicalGraph.reset(new HierarchicalPathGraph(grid, gridBounds));
+
+   if(gridBounds.getArea() <= MAX_RFW_TILES)
+   {
+      m_royFloydWarshallCalculation.runTask(
+                                         &RoyFloydWarshallMatrices::calculateRoyFloydWarshallMatrices,
+                                         std::make_shared<const Grid<TileState>>(*m_collisionGrid),
+                                         *m_collisionGridBounds,
+                                         m_movementTileSize);
+   }
+   else
+   {
+      m_royFloydWarshallCalculation.cancel();
+   }
+
    DEBUG("Pathfinder reinitialized.");
 }
 
-bool Pathfinder::isRoyFloydWarshallCalculationReady() const
+void Pathfinder::addObstacles(const geometry::Rectangle& area)
+{
+   if(!m_collisionGrid)
+   {
+      return;
+   }
+
+   m_hierarchicalGraph->update(*m_collisionGrid, area);
+
+   if(!m_royFloydWarshallCalculation.valid())
+   {
+      return;
+   }
+
+   if(!isRoyFloydWarshallCalculationReady())
+   {
+      // The calculation may have already read the old obstacles, so start it over.
+      m_royFloydWarshallCalculation.runTask(
+                                         &RoyFloydWarshallMatrices::calculateRoyFloydWarshallMatrices,
+                                         std::make_shared<const Grid<TileState>>(*m_collisionGrid),
+                                         *m_collisionGridBounds,
+                                         m_movementTileSize);
+      return;
+   }
+
+   // Running searches use the RFW matrices as their heuristic, so they must finish before the repair.
+   abandonPathJobs();
+
+   m_royFloydWarshallCalculation.get().addObstacles(*m_collisionGrid, area);
+}
+
+void Pathfinder::markChanged(const geometry::Rectangle& area)
+{
+   for(const auto& snapshot : m_gridSnapshots)
+   {
+      if(snapshot->stale)
+      {
+         continue;
+      }
+
+      if(snapshot->changedAreas.size() < MAX_SNAPSHOT_CHANGES)
+      {
+         snapshot->changedAreas.push_back(area);
+      }
+      else
+      {
+         snapshot->stale = true;
+         snapshot->changedAreas.clear();
+      }
+   }
+}
+
+bool Pathfinder::isRoyFloydWarshallCalculationReady() const
+{
+   if(!m_royFloydWarshallCalculation.valid())
+   {
+      return false;
+   }
+
+   const auto futureStatus = m_royFloydWarshallCalculation.waitFor(std::chrono::seconds(0));
+
+   return futureStatus == std::future_status::ready;
+}
+
+const RoyFloydWarshallMatrices* Pathfinder::getRoyFloydWarshallMatrices() const
+{
+   return isRoyFloydWarshallCalculationReady() ? &m_royFloydWarshallCalculation.get() : nullptr;
+}
+
+bool Pathfinder::areConnected(const geometry::Point2D& src, const geometry::Point2D& dst) const
+{
+   if(!m_componentGrid || !m_collisionGridBounds || m_componentGrid->empty()) return false;
+
+   const geometry::Point2D sourceTile = src / m_movementTileSize;
+   const geometry::Point2D destinationTile = dst / m_movementTileSize;
+   if(!m_collisionGridBounds->contains(sourceTile) || !m_collisionGridBounds->contains(destinationTile))
+   {
+      return false;
+   }
+
+   const unsigned int component = (*m_componentGrid)(sourceTile.x, sourceTile.y);
+   return component != 0 && component == (*m_componentGrid)(destinationTile.x, destinationTile.y);
+}
+
+/**
+ * A least-recently-used cache of the static paths found on a grid, keyed on the source tile,
+ * the destination tile and the size of the moving entity. Each entry is only valid for the
+ * collision epoch it was found in; once the epoch changes, the whole cache is dropped.
+ *
+ * @author Noam Chitayat
+ */
+class Pathfinder::PathCache final
+{
+   /**
+    * The request that a path was found for.
+    */
+   struct Key
+   {
+      /** The source tile. */
+      geometry::Point2D srcTile;
+
+      /** The destination tile. */
+      geometry::Point2D dstTile;
+
+      /** The size of the moving entity. */
+      geometry::Size size;
+
+      bool operator==(const Key& rhs) const
+      {
+         return srcTile == rhs.srcTile && dstTile == rhs.dstTile && size == rhs.size;
+      }
+   };
+
+   /**
+    * Combines the coordinates of a key into a hash.
+    */
+   struct KeyHash
+   {
+      std::size_t operator()(const Key& key) const
+      {
+         std::size_t hash = std::hash<int>()(key.srcTile.x);
+         hash = hash * 31 + std::hash<int>()(key.srcTile.y);
+         hash = hash * 31 + std::hash<int>()(key.dstTile.x);
+         hash = hash * 31 + std::hash<int>()(key.dstTile.y);
+         hash = hash * 31 + std::hash<unsigned int>()(key.size.width);
+         hash = hash * 31 + std::hash<unsigned int>()(key.size.height);
+         return hash;
+      }
+   };
+
+   typedef std::list<std::pair<Key, Path>> EntryList;
+
+   /** The cached paths, ordered from most to least recently used. */
+   EntryList m_entries;
+
+   /** The position of each cached path in the entry list. */
+   std::unordered_map<Key, EntryList::iterator, KeyHash> m_index;
+
+   /** The collision epoch that the cached paths were found in. */
+   unsigned long m_epoch = 0;
+
+   /**
+    * Drops every cached path if the obstacles have changed since they were found.
+    *
+    * @param epoch The current collision epoch.
+    */
+   void validate(unsigned long epoch)
+   {
+      if(epoch != m_epoch)
+      {
+         m_entries.clear();
+         m_index.clear();
+         m_epoch = epoch;
+      }
+   }
+
+   public:
+      /**
+       * @param srcTile The source tile.
+       * @param dstTile The destination tile.
+       * @param size The size of the moving entity.
+       * @param epoch The current collision epoch.
+       *
+       * @return The cached path for the request, or nullptr if there is none.
+       */
+      const Path* find(const geometry::Point2D& srcTile, const geometry::Point2D& dstTile, const geometry::Size& size, unsigned long epoch)
+      {
+         validate(epoch);
+
+         const auto indexIter = m_index.find(Key{srcTile, dstTile, size});
+         if(indexIter == m_index.end()) return nullptr;
+
+         m_entries.splice(m_entries.begin(), m_entries, indexIter->second);
+         return &m_entries.front().second;
+      }
+
+      /**
+       * Caches a path, evicting the least recently used path if the cache is full.
+       *
+       * @param srcTile The source tile.
+       * @param dstTile The destination tile.
+       * @param size The size of the moving entity.
+       * @param path The path that was found.
+       * @param epoch The collision epoch that the path was found in.
+       */
+      void insert(const geometry::Point2D& srcTile, const geometry::Point2D& dstTile, const geometry::Size& size, const Path& path, unsigned long epoch)
+      {
+         validate(epoch);
+
+         const Key key{srcTile, dstTile, size};
+         if(m_index.count(key) > 0) return;
+
+         m_entries.emplace_front(key, path);
+         m_index[key] = m_entries.begin();
+
+         if(m_entries.size() > MAX_CACHED_PATHS)
+         {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+         }
+      }
+};
+
+bool Pathfinder::hasPathData(const geometry::Size& size) const
+{
+   // The RFW matrices only route single tiles, so larger entities use the graph's layer for their footprint.
+   const int footprint = getFootprint(size);
+   return (footprint == 1 && getRoyFloydWarshallMatrices()) ||
+      (m_hierarchicalGraph && footprint <= HierarchicalPathGraph::MAX_FOOTPRINT);
+}
+
+Pathfinder::Path Pathfinder::findBestPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const
+{
+   if(!areConnected(src, dst))
+   {
+      DEBUG("No path from %d,%d to %d,%d: they are in different regions.", src.x, src.y, dst.x, dst.y);
+      return Path();
+   }
+
+   if(!hasPathData(size))
+   {
+      // Searching around the moving entities instead would stall the frame, so
+      // the caller should request a rerouted path from the workers instead.
+      DEBUG("No path data to find a path from %d,%d to %d,%d with.", src.x, src.y, dst.x, dst.y);
+      return Path();
+   }
+
+   const int footprint = getFootprint(size);
+   const RoyFloydWarshallMatrices* rfwMatrices = footprint == 1 ? getRoyFloydWarshallMatrices() : nullptr;
+
+   const geometry::Point2D sourceTile = src / m_movementTileSize;
+   const geometry::Point2D destinationTile = dst / m_movementTileSize;
+   const unsigned long epoch = *m_collisionEpoch;
+
+   if(!m_pathCache)
+   {
+      m_pathCache.reset(new PathCache());
+   }
+
+   const Path* cachedPath = m_pathCache->find(sourceTile, destinationTile, size, epoch);
+   if(cachedPath)
+   {
+      DEBUG("Found cached path from %d,%d to %d,%d", src.x, src.y, dst.x, dst.y);
+      return *cachedPath;
+   }
+
+   const Path path = rfwMatrices ? findRFWPath(src, dst, *rfwMatrices) : findHierarchicalPath(src, dst, footprint);
+   m_pathCache->insert(sourceTile, destinationTile, size, path, epoch);
+   return path;
+}
+
+/**
+ * Represents a node in an A* search. Tracks the predecessor node and expected cost
+ * of the node to enable the A* algorithm to track the lowest cost node.
+ * Nodes are pooled by tile number and reused across searches.
+ *
+ * @author Noam Chitayat
+ */
+class Pathfinder::AStarNode final
+{
+public:
+   /** The actual distance cost from the origin node to this node. */
+   float gCost;
+
+   /** The heuristic distance cost from this node to the destination node. */
+   float hCost;
+
+   /** The total expected cost of traveling through this node from the origin to the destination. */
+   float fCost;
+
+   /** The tile number of the predecessor of this node (the previous node on the shortest discovered path to this node), or -1 for the origin. */
+   int parent;
+
+   /** The position of this node in the open set heap, or -1 if the node is not in the open set. */
+   int heapIndex;
+
+   /** The search in which this node was last discovered. */
+   unsigned int generation;
+
+   /** The search in which the occupancy of this node's tile was last checked. */
+   unsigned int occupancyGeneration;
+
+   /** Whether the moving entity can occupy this node's tile (valid only if checked in the current search). */
+   bool occupiable;
+
+   /**
+    * Comparison operation between two A* nodes. The lowest cost node is the one
+    * with the lowest total estimated cost (F cost). In the case of a tie, the
+    * highest G cost wins since it is not as deep in the search tree.
+    *
+    * @param lhs An A* node to compare.
+    * @param rhs Another A* node to compare.
+    *
+    * @return true iff lhs has a lower expected cost than rhs.
+    */
+   static bool isLowerPriority(const AStarNode& lhs, const AStarNode& rhs)
+   {
+      // We consider lhs to have a lower priority if it has a higher total f() cost.
+      // In case of a tie, this point will have lower priority if it has a lower g() cost,
+      // indicating that it is not as deep in the search tree.
+      return lhs.fCost > rhs.fCost || (lhs.fCost == rhs.fCost && lhs.gCost < rhs.gCost);
+   }
+};
+
+/**
+ * The reusable state of an A* search: a pool of nodes indexed by tile number, and
+ * an open set kept as a binary heap of tile numbers. Each node records its position
+ * in the heap, so that a node's cost can be lowered in logarithmic time.
+ *
+ * Rather than clearing the pool between searches, each search gets a new generation
+ * number, and nodes from older generations are treated as undiscovered.
+ *
+ * @author Noam Chitayat
+ */
+class Pathfinder::AStarSearchSpace final
+{
+   /** The nodes of the search, indexed by tile number. */
+   std::vector<AStarNode> m_nodes;
+
+   /** The tile numbers of the nodes in the open set, ordered as a binary heap. */
+   std::vector<int> m_openSet;
+
+   /** The generation of the current search. */
+   unsigned int m_generation = 0;
+
+   /**
+    * Places a node at a position in the heap and records the position in the node.
+    *
+    * @param heapIndex The position in the heap.
+    * @param tileNum The tile number of the node.
+    */
+   void placeNode(unsigned int heapIndex, int tileNum)
+   {
+      m_openSet[heapIndex] = tileNum;
+      m_nodes[tileNum].heapIndex = heapIndex;
+   }
+
+   /**
+    * Moves a node up the heap until its parent has a higher priority.
+    *
+    * @param heapIndex The current position of the node in the heap.
+    */
+   void siftUp(unsigned int heapIndex)
+   {
+      const int tileNum = m_openSet[heapIndex];
+      while(heapIndex > 0)
+      {
+         const unsigned int parentIndex = (heapIndex - 1) / 2;
+         if(!AStarNode::isLowerPriority(m_nodes[m_openSet[parentIndex]], m_nodes[tileNum]))
+         {
+            break;
+         }
+
+         placeNode(heapIndex, m_openSet[parentIndex]);
+         heapIndex = parentIndex;
+      }
+
+      placeNode(heapIndex, tileNum);
+   }
+
+   /**
+    * Moves a node down the heap until neither of its children has a higher priority.
+    *
+    * @param heapIndex The current position of the node in the heap.
+    */
+   void siftDown(unsigned int heapIndex)
+   {
+      const int tileNum = m_openSet[heapIndex];
+      const unsigned int heapSize = m_openSet.size();
+      for(;;)
+      {
+         unsigned int childIndex = 2 * heapIndex + 1;
+         if(childIndex >= heapSize)
+         {
+            break;
+         }
+
+         if(childIndex + 1 < heapSize && AStarNode::isLowerPriority(m_nodes[m_openSet[childIndex]], m_nodes[m_openSet[childIndex + 1]]))
+         {
+            ++childIndex;
+         }
+
+         if(!AStarNode::isLowerPriority(m_nodes[tileNum], m_nodes[m_openSet[childIndex]]))
+         {
+            break;
+         }
+
+         placeNode(heapIndex, m_openSet[childIndex]);
+         heapIndex = childIndex;
+      }
+
+      placeNode(heapIndex, tileNum);
+   }
+
+public:
+   /**
+    * Prepares the search space for a new search.
+    *
+    * @param numTiles The number of tiles in the grid being searched.
+    */
+   void reset(unsigned int numTiles)
+   {
+      m_openSet.clear();
+
+      if(m_nodes.size() != numTiles || ++m_generation == 0)
+      {
+         // Either the grid changed size or the generation counter wrapped around,
+         // so stale generation numbers could be mistaken for the current search.
+         m_nodes.assign(numTiles, AStarNode());
+         m_generation = 1;
+      }
+   }
+
+   /**
+    * @param tileNum The tile number of a node.
+    *
+    * @return The node for the given tile.
+    */
+   const AStarNode& getNode(int tileNum) const
+   {
+      return m_nodes[tileNum];
+   }
+
+   /**
+    * @param tileNum The tile number of a node.
+    *
+    * @return true iff the tile has been discovered in the current search.
+    */
+   bool isDiscovered(int tileNum) const
+   {
+      return m_nodes[tileNum].generation == m_generation;
+   }
+
+   /**
+    * @param tileNum The tile number of a node.
+    *
+    * @return true iff the occupancy of the tile has already been checked in the current search.
+    */
+   bool isOccupancyKnown(int tileNum) const
+   {
+      return m_nodes[tileNum].occupancyGeneration == m_generation;
+   }
+
+   /**
+    * Records whether the moving entity can occupy a tile in the current search.
+    *
+    * @param tileNum The tile number of the node.
+    * @param occupiable Whether the tile can be occupied.
+    */
+   void setOccupiable(int tileNum, bool occupiable)
+   {
+      AStarNode& node = m_nodes[tileNum];
+      node.occupancyGeneration = m_generation;
+      node.occupiable = occupiable;
+   }
+
+   /**
+    * Marks a tile as discovered without adding it to the open set.
+    *
+    * @param tileNum The tile number of the node.
+    */
+   void discover(int tileNum)
+   {
+      AStarNode& node = m_nodes[tileNum];
+      node.generation = m_generation;
+      node.heapIndex = -1;
+   }
+
+   /**
+    * Adds a discovered tile to the open set.
+    *
+    * @param tileNum The tile number of the node.
+    * @param gCost The actual distance cost required to travel from the origin to this node.
+    * @param hCost The estimated distance cost required to travel from this node to the destination.
+    * @param parent The tile number of the predecessor of this node, or -1 for the origin.
+    */
+   void push(int tileNum, float gCost, float hCost, int parent)
+   {
+      AStarNode& node = m_nodes[tileNum];
+      node.gCost = gCost;
+      node.hCost = hCost;
+      node.fCost = gCost + hCost;
+      node.parent = parent;
+
+      m_openSet.push_back(tileNum);
+      siftUp(m_openSet.size() - 1);
+   }
+
+   /**
+    * Removes the lowest-cost node from the open set.
+    *
+    * @return The tile number of the removed node.
+    */
+   int pop()
+   {
+      const int cheapestTileNum = m_openSet.front();
+      m_nodes[cheapestTileNum].heapIndex = -1;
+
+      const int lastTileNum = m_openSet.back();
+      m_openSet.pop_back();
+      if(!m_openSet.empty())
+      {
+         placeNode(0, lastTileNum);
+         siftDown(0);
+      }
+
+      return cheapestTileNum;
+   }
+
+   /**
+    * Lowers the travel cost of a node if it is in the open set and the new cost is cheaper.
+    *
+    * @param tileNum The tile number of the node.
+    * @param gCost The new travel cost from the origin to this node.
+    * @param parent The tile number of the new predecessor of this node.
+    *
+    * @return true iff the node's cost was lowered.
+    */
+   bool decreaseCost(int tileNum, float gCost, int parent)
+   {
+      AStarNode& node = m_nodes[tileNum];
+      if(node.heapIndex < 0 || node.gCost <= gCost)
+      {
+         return false;
+      }
+
+      node.gCost = gCost;
+      node.fCost = gCost + node.hCost;
+      node.parent = parent;
+      siftUp(node.heapIndex);
+      return true;
+   }
+
+   /**
+    * @return true iff there are no nodes left in the open set.
+    */
+   bool empty() const
+   {
+      return m_openSet.empty();
+   }
+};
+
+Pathfinder::Path Pathfinder::findReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm) const
+{
+   if(!m_collisionGrid || !m_collisionGridBounds || m_collisionGrid->empty()) return Path();
+
+   if(!areConnected(src, dst))
+   {
+      DEBUG("No path from %d,%d to %d,%d: they are in different regions.", src.x, src.y, dst.x, dst.y);
+      return Path();
+   }
+
+   if(!m_searchSpace)
+   {
+      m_searchSpace.reset(new AStarSearchSpace());
+   }
+
+   const SearchGrid searchGrid = { *m_collisionGrid, *m_occupancyGrid, *m_clearanceGrid, *m_collisionGridBounds, getRoyFloydWarshallMatrices() };
+   return findReroutedPath(searchGrid, src, dst, size, algorithm, *m_searchSpace);
+}
+
+std::shared_ptr<const Pathfinder::PathQuery> Pathfinder::requestReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm)
+{
+   auto query = std::make_shared<PathQuery>(src, dst, size, algorithm);
+   if(!areConnected(src, dst))
+   {
+      // There can't be a path, so there is nothing for the workers to do.
+      query->m_ready = true;
+      return query;
+   }
+
+   m_pendingQueries.push_back(query);
+   return query;
+}
+
+void Pathfinder::dispatchPathQueries()
+{
+   if(m_pendingQueries.empty()) return;
+
+   if(!m_collisionGrid || !m_collisionGridBounds || m_collisionGrid->empty())
+   {
+      // There is no grid to search, so there are no paths to find.
+      for(const auto& query : m_pendingQueries)
+      {
+         query->m_ready = true;
+      }
+
+      m_pendingQueries.clear();
+      return;
+   }
+
+   typedef std::vector<std::shared_ptr<PathQuery>> PathQueryBatch;
+   auto batch = std::make_shared<PathQueryBatch>();
+   while(!m_pendingQueries.empty() && batch->size() < MAX_PATH_QUERIES_PER_FRAME)
+   {
+      // Skip requests that were abandoned by their requesters.
+      if(m_pendingQueries.front().use_count() > 1)
+      {
+         batch->push_back(std::move(m_pendingQueries.front()));
+      }
+
+      m_pendingQueries.pop_front();
+   }
+
+   if(batch->empty()) return;
+
+   WorkerPool& workerPool = WorkerPool::getSharedPool();
+   if(m_workerSearchSpaces.empty())
+   {
+      for(unsigned int i = 0; i < workerPool.getNumWorkers(); ++i)
+      {
+         m_workerSearchSpaces.emplace_back(new AStarSearchSpace());
+      }
+   }
+
+   // The whole batch is solved against one copy of the grid,
+   // so the entities on the live grid can keep moving while the workers search.
+   const auto snapshot = takeGridSnapshot();
+   const geometry::Rectangle bounds = *m_collisionGridBounds;
+   const RoyFloydWarshallMatrices* rfwMatrices = getRoyFloydWarshallMatrices();
+   const auto nextQuery = std::make_shared<std::atomic<unsigned int>>(0);
+   const auto abandoned = m_pathJobsAbandoned;
+
+   const unsigned int numJobs = std::min<unsigned int>(batch->size(), std::min(workerPool.getNumWorkers(), MAX_PATH_WORKERS));
+   for(unsigned int i = 0; i < numJobs; ++i)
+   {
+      workerPool.submit([this, batch, snapshot, bounds, rfwMatrices, nextQuery, abandoned](unsigned int workerIndex)
+      {
+         const SearchGrid searchGrid = { snapshot->tiles, snapshot->occupancy, snapshot->clearance, bounds, rfwMatrices };
+         for(unsigned int queryIndex = (*nextQuery)++; queryIndex < batch->size(); queryIndex = (*nextQuery)++)
+         {
+            PathQuery& query = *(*batch)[queryIndex];
+
+            // Abandoned requests are completed without a path, without touching the pathfinder's state.
+            if(!*abandoned)
+            {
+               query.m_path = findReroutedPath(searchGrid, query.m_src, query.m_dst, query.m_size, query.m_algorithm, *m_workerSearchSpaces[workerIndex]);
+            }
+
+            query.m_ready = true;
+         }
+      }, m_pathJobs, WorkerPool::Priority::HIGH);
+   }
+
+   DEBUG("Dispatched %d path queries (%d still queued)", static_cast<int>(batch->size()), static_cast<int>(m_pendingQueries.size()));
+}
+
+std::shared_ptr<const Pathfinder::GridSnapshot> Pathfinder::takeGridSnapshot()
+{
+   for(const auto& snapshot : m_gridSnapshots)
+   {
+      if(snapshot.use_count() > 1)
+      {
+         // A running search is still reading this snapshot.
+         continue;
+      }
+
+      if(snapshot->stale)
+      {
+         snapshot->tiles = *m_collisionGrid;
+         snapshot->occupancy = *m_occupancyGrid;
+         snapshot->clearance = *m_clearanceGrid;
+         snapshot->stale = false;
+      }
+      else
+      {
+         for(const auto& area : snapshot->changedAreas)
+         {
+            snapshot->tiles.copyRect(*m_collisionGrid, geometry::Rectangle(area.top, area.left, area.bottom + 1, area.right + 1));
+            snapshot->clearance.copyRect(*m_clearanceGrid, geometry::Rectangle(area.top, area.left, area.bottom + 1, area.right + 1));
+            for(int y = area.top; y <= area.bottom; ++y)
+            {
+               snapshot->occupancy.copySpan(*m_occupancyGrid, y, area.left, area.right);
+            }
+         }
+      }
+
+      snapshot->changedAreas.clear();
+      return snapshot;
+   }
+
+   // Every kept snapshot is in use, so copy the whole grid.
+   const auto snapshot = std::make_shared<GridSnapshot>();
+   snapshot->tiles = *m_collisionGrid;
+   snapshot->occupancy = *m_occupancyGrid;
+   snapshot->clearance = *m_clearanceGrid;
+
+   if(m_gridSnapshots.size() < MAX_GRID_SNAPSHOTS)
+   {
+      m_gridSnapshots.push_back(snapshot);
+   }
+
+   return snapshot;
+}
+
+Pathfinder::Path Pathfinder::findReroutedPath(const SearchGrid& searchGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm, AStarSearchSpace& searchSpace) const
+{
+   Path path;
+   switch(algorithm)
+   {
+      case SearchAlgorithm::JUMP_POINT_SEARCH:
+         path = findJumpPointPath(searchGrid, src, dst, size, searchSpace);
+         break;
+      case SearchAlgorithm::A_STAR:
+      default:
+         path = findAStarPath(searchGrid, src, dst, size, searchSpace);
+         break;
+   }
+
+   if(path.empty()) return path;
+
+   const TileState& entityState = searchGrid.tiles(src.x / m_movementTileSize, src.y / m_movementTileSize);
+   return smoothPath(searchGrid, path, size, entityState);
+}
+
+geometry::Point2D Pathfinder::getSegmentStep(const geometry::Point2D& location, const geometry::Point2D& dst, int stepSize)
+{
+   const int xStep = std::max(-stepSize, std::min(stepSize, dst.x - location.x));
+   const int yStep = std::max(-stepSize, std::min(stepSize, dst.y - location.y));
+
+   return geometry::Point2D(location.x + xStep, location.y + yStep);
+}
+
+bool Pathfinder::isSegmentClear(const SearchGrid& searchGrid, const geometry::Point2D& srcTile, const geometry::Point2D& dstTile, const geometry::Size& size, const TileState& entityState) const
+{
+   geometry::Point2D tile = srcTile;
+   while(tile != dstTile)
+   {
+      const geometry::Point2D nextTile = getSegmentStep(tile, dstTile, 1);
+      if(!canOccupyArea(searchGrid, geometry::Rectangle(nextTile * m_movementTileSize, size), entityState))
+      {
+         return false;
+      }
+
+      if(nextTile.x != tile.x && nextTile.y != tile.y)
+      {
+         // Diagonal steps can't cut corners.
+         const geometry::Point2D horizontalTile(tile.x, nextTile.y);
+         const geometry::Point2D verticalTile(nextTile.x, tile.y);
+         if(!canOccupyArea(searchGrid, geometry::Rectangle(horizontalTile * m_movementTileSize, size), entityState) ||
+            !canOccupyArea(searchGrid, geometry::Rectangle(verticalTile * m_movementTileSize, size), entityState))
+         {
+            return false;
+         }
+      }
+
+      tile = nextTile;
+   }
+
+   return true;
+}
+
+Pathfinder::Path Pathfinder::smoothPath(const SearchGrid& searchGrid, const Path& path, const geometry::Size& size, const TileState& entityState) const
+{
+   if(path.size() < 3) return path;
+
+   Path smoothedPath;
+
+   auto anchor = path.begin();
+   auto lastVisible = std::next(anchor);
+   smoothedPath.push_back(*anchor);
+
+   for(auto waypoint = std::next(lastVisible); waypoint != path.end(); ++waypoint)
+   {
+      const geometry::Point2D anchorTile = *anchor / m_movementTileSize;
+      const geometry::Point2D waypointTile = *waypoint / m_movementTileSize;
+      const unsigned int segmentTiles = std::max(abs(waypointTile.x - anchorTile.x), abs(waypointTile.y - anchorTile.y));
+
+      if(segmentTiles * m_movementTileSize <= MAX_SEGMENT_LENGTH && isSegmentClear(searchGrid, anchorTile, waypointTile, size, entityState))
+      {
+         lastVisible = waypoint;
+         continue;
+      }
+
+      // The waypoint can't be reached directly, so the path has to turn at the last waypoint that could.
+      smoothedPath.push_back(*lastVisible);
+      anchor = lastVisible;
+      lastVisible = waypoint;
+   }
+
+   smoothedPath.push_back(*lastVisible);
+
+   DEBUG("Smoothed path from %d to %d waypoints.", static_cast<int>(path.size()), static_cast<int>(smoothedPath.size()));
+   return smoothedPath;
+}
+
+Pathfinder::Path Pathfinder::findAStarPath(const SearchGrid& searchGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, AStarSearchSpace& searchSpace) const
 {
-   if(!m_royFloydWarshallCalculation.valid())
+   if(searchGrid.tiles.empty()) return Path();
+
+   const TileState& entityState = searchGrid.tiles(src.x / m_movementTileSize, src.y / m_movementTileSize);
+
+   if(!canOccupyArea(searchGrid, geometry::Rectangle(dst, size), entityState)) return Path();
+
+   const geometry::Point2D sourceTile = src / m_movementTileSize;
+   const geometry::Point2D destinationTile = dst / m_movementTileSize;
+
+   const int gridWidth = searchGrid.bounds.getWidth();
+   const int sourceTileNum = sourceTile.y * gridWidth + sourceTile.x;
+   const int destinationTileNum = destinationTile.y * gridWidth + destinationTile.x;
+
+   searchSpace.reset(searchGrid.bounds.getArea());
+
+   searchSpace.discover(sourceTileNum);
+   searchSpace.push(sourceTileNum, 0, 0, -1);
+
+   Path path;
+
+   while(!searchSpace.empty())
    {
-      return false;
-   }
+      // Get the lowest-cost point in the open set, and remove it from the open set
+      const int cheapestTileNum = searchSpace.pop();
+      const geometry::Point2D cheapestPoint(cheapestTileNum % gridWidth, cheapestTileNum / gridWidth);
 
-   const auto futureStatus = m_royFloydWarshallCalculation.waitFor(std::chrono::seconds(0));
+      if(cheapestTileNum == destinationTileNum)
+      {
+         DEBUG("Found goal point %d,%d", cheapestPoint.x, cheapestPoint.y);
+         for(int curr = cheapestTileNum; curr >= 0; curr = searchSpace.getNode(curr).parent)
+         {
+            path.push_front(geometry::Point2D(curr % gridWidth, curr / gridWidth) * m_movementTileSize);
+         }
+         break;
+      }
 
-   return futureStatus == std::future_status::ready;
+      DEBUG("Evaluating point %d,%d", cheapestPoint.x, cheapestPoint.y);
+
+      evaluateAdjacentNodes(searchGrid, entityState, size, cheapestPoint, destinationTile, searchSpace);
+   }
+
+   return path;
 }
 
-Pathfinder::Path Pathfinder::findBestPath(const EntityGrid& entityGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const
+int Pathfinder::getFootprint(const geometry::Size& size) const
 {
-   return isRoyFloydWarshallCalculationReady() ?
-      findRFWPath(src, dst, m_royFloydWarshallCalculation.get()) :
-      findAStarPath(entityGrid, src, dst, size);
+   const int tilesWide = (size.width + m_movementTileSize - 1) / m_movementTileSize;
+   const int tilesHigh = (size.height + m_movementTileSize - 1) / m_movementTileSize;
+   return std::max(1, std::max(tilesWide, tilesHigh));
 }
 
-Pathfinder::Path Pathfinder::findReroutedPath(const EntityGrid& entityGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const
+unsigned int Pathfinder::getManhattanDistance(const geometry::Point2D& src, const geometry::Point2D& dst)
 {
-   return findAStarPath(entityGrid, src, dst, size);
+   unsigned int xDistance = abs(dst.x - src.x);
+   unsigned int yDistance = abs(dst.y - src.y);
+
+   return xDistance + yDistance;
 }
 
-std::vector<geometry::Point2D> Pathfinder::getAdjacentPoints(const geometry::Point2D& point, const geometry::Rectangle& bounds)
+bool Pathfinder::canOccupyArea(const SearchGrid& searchGrid, const geometry::Rectangle& area, const TileState& entityState) const
 {
-   std::vector<geometry::Point2D> points;
-
-   if(point.x > bounds.left)
+   if(entityState.entityType == TileState::EntityType::FREE)
    {
-      // Left point
-      points.emplace_back(point.x - 1, point.y);
+      return false;
    }
 
-   if(point.x < bounds.right - 1)
-   {
-      // Right point
-      points.emplace_back(point.x + 1, point.y);
-   }
+   const int left = area.left / m_movementTileSize;
+   const int top = area.top / m_movementTileSize;
+   const int right = (area.right - 1) / m_movementTileSize;
+   const int bottom = (area.bottom - 1) / m_movementTileSize;
 
-   if(point.y > bounds.top)
+   const geometry::Rectangle& bounds = searchGrid.bounds;
+   if(left < bounds.left || top < bounds.top || right >= bounds.right || bottom >= bounds.bottom)
    {
-      // Upper point
-      points.emplace_back(point.x, point.y - 1);
+      return false;
    }
 
-   if(point.y < bounds.bottom - 1)
+   // Most areas are entirely free, which the clearance grid can confirm with a single lookup.
+   const int areaSize = std::max(right - left, bottom - top) + 1;
+   if(searchGrid.clearance(left, top) >= areaSize)
    {
-      // Lower point
-      points.emplace_back(point.x, point.y + 1);
+      return true;
    }
 
-   if(point.x > bounds.left && point.y > bounds.top)
+   for(int y = top; y <= bottom; ++y)
    {
-      // Upper-left point
-      points.emplace_back(point.x - 1, point.y - 1);
+      // Only the tiles that aren't free need their states checked, and the occupancy bits find them a word at a time.
+      for(int x = searchGrid.occupancy.findFirstSet(y, left, right); x >= 0; x = searchGrid.occupancy.findFirstSet(y, x + 1, right))
+      {
+         // The area can't be occupied if any tile is taken by an entity other than the one trying to occupy it.
+         const TileState& tileState = searchGrid.tiles(x, y);
+         if(tileState.entityType != entityState.entityType || tileState.entity != entityState.entity)
+         {
+            return false;
+         }
+      }
    }
 
-   if(point.x > bounds.left && point.y < bounds.bottom - 1)
+   return true;
+}
+
+bool Pathfinder::canOccupyTile(const SearchGrid& searchGrid, const TileState& entityState, const geometry::Size& entitySize, const geometry::Point2D& tile, AStarSearchSpace& searchSpace) const
+{
+   const geometry::Rectangle& bounds = searchGrid.bounds;
+   if(tile.x < bounds.left || tile.x >= bounds.right || tile.y < bounds.top || tile.y >= bounds.bottom)
    {
-      // Lower-left point
-      points.emplace_back(point.x - 1, point.y + 1);
+      return false;
    }
 
-   if(point.x < bounds.right - 1 && point.y > bounds.top)
+   // Occupancy checks span the whole entity, so remember the result for the rest of the search.
+   const int tileNum = tile.y * bounds.getWidth() + tile.x;
+   if(!searchSpace.isOccupancyKnown(tileNum))
    {
-      // Upper-right point
-      points.emplace_back(point.x + 1, point.y - 1);
+      searchSpace.setOccupiable(tileNum, canOccupyArea(searchGrid, geometry::Rectangle(tile * m_movementTileSize, entitySize), entityState));
    }
 
-   if(point.x < bounds.right - 1 && point.y < bounds.bottom - 1)
+   return searchSpace.getNode(tileNum).occupiable;
+}
+
+float Pathfinder::getOctileDistance(const geometry::Point2D& src, const geometry::Point2D& dst)
+{
+   const int xDistance = abs(dst.x - src.x);
+   const int yDistance = abs(dst.y - src.y);
+
+   return std::max(xDistance, yDistance) + (ROOT_2 - 1.0f) * std::min(xDistance, yDistance);
+}
+
+void Pathfinder::evaluateAdjacentNodes(const SearchGrid& searchGrid, const TileState& entityState, const geometry::Size& entitySize, const geometry::Point2D& evaluatedPoint, const geometry::Point2D& destinationTile, AStarSearchSpace& searchSpace) const
+{
+   // Left, right, up, down, upper-left, lower-left, upper-right, lower-right
+   static const int ADJACENT_OFFSETS[8][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1} };
+
+   const geometry::Rectangle& bounds = searchGrid.bounds;
+   const RoyFloydWarshallMatrices* rfwMatrices = searchGrid.rfwMatrices;
+   const int gridWidth = bounds.getWidth();
+   const int evaluatedTileNum = evaluatedPoint.y * gridWidth + evaluatedPoint.x;
+   const float evaluatedGCost = searchSpace.getNode(evaluatedTileNum).gCost;
+
+   for(const auto& offset : ADJACENT_OFFSETS)
    {
-      // Lower-right point
-      points.emplace_back(point.x + 1, point.y + 1);
-   }
+      const geometry::Point2D adjacentPoint(evaluatedPoint.x + offset[0], evaluatedPoint.y + offset[1]);
+      if(adjacentPoint.x < bounds.left || adjacentPoint.x >= bounds.right ||
+         adjacentPoint.y < bounds.top || adjacentPoint.y >= bounds.bottom)
+      {
+         continue;
+      }
+
+      const int adjacentTileNum = adjacentPoint.y * gridWidth + adjacentPoint.x;
+      bool diagonalMovement = offset[0] != 0 && offset[1] != 0;
+
+      bool freeTile = canOccupyTile(searchGrid, entityState, entitySize, adjacentPoint, searchSpace);
+
+      if(diagonalMovement)
+      {
+         const geometry::Point2D horizontalDestinationPoint(evaluatedPoint.x, adjacentPoint.y);
+         const geometry::Point2D verticalDestinationPoint(adjacentPoint.x, evaluatedPoint.y);
+
+         freeTile = freeTile &&
+            canOccupyTile(searchGrid, entityState, entitySize, horizontalDestinationPoint, searchSpace) &&
+            canOccupyTile(searchGrid, entityState, entitySize, verticalDestinationPoint, searchSpace);
+      }
+
+      if(!freeTile)
+      {
+         continue;
+      }
+
+      float tileGCost = evaluatedGCost + (diagonalMovement ? ROOT_2 : 1.0f);
+      if(!searchSpace.isDiscovered(adjacentTileNum))
+      {
+         searchSpace.discover(adjacentTileNum);
 
-   return points;
+         float tileHCost = rfwMatrices ? rfwMatrices->getDistance(adjacentPoint, destinationTile) : Pathfinder::getManhattanDistance(adjacentPoint, destinationTile);
+         DEBUG("Pushing point %d,%d onto open set with parent point %d,%d and g()=%f and f()=%f.", adjacentPoint.x, adjacentPoint.y, evaluatedPoint.x, evaluatedPoint.y, tileGCost, tileGCost + tileHCost);
+         searchSpace.push(adjacentTileNum, tileGCost, tileHCost, evaluatedTileNum);
+      }
+      else if(searchSpace.decreaseCost(adjacentTileNum, tileGCost, evaluatedTileNum))
+      {
+         DEBUG("Altering cost of discovered point %d, %d to g()=%f and f()=%f", adjacentPoint.x, adjacentPoint.y, tileGCost, searchSpace.getNode(adjacentTileNum).fCost);
+      }
+   }
 }
 
 /**
- * Represents a node in an A* search. Tracks the predecessor node and expected cost
- * of the node to enable the A* algorithm to track the lowest cost node.
+ * Applies the Jump Point Search rules for an 8-connected grid in which diagonal
+ * moves are only allowed if both orthogonal tiles along the move can be occupied
+ * (the same rule that A* uses when evaluating adjacent nodes).
+ *
+ * Under this rule, a straight move can only be forced to turn when the tile beside
+ * it opens up after being blocked, and a diagonal move has to stop wherever one of
+ * its straight components reaches a jump point.
  *
  * @author Noam Chitayat
  */
-class Pathfinder::AStarNode final
+class Pathfinder::JumpPointSearch final
 {
-private:
+   /** The pathfinder running the search. */
+   const Pathfinder& m_pathfinder;
 
-   /** The actual distance cost from the origin node to this node. */
-   float gCost;
+   /** The grid being searched. */
+   const SearchGrid& m_searchGrid;
 
-   /** The heuristic distance cost from this node to the destination node. */
-   float hCost;
+   /** The state of the entity trying to move. */
+   const TileState& m_entityState;
 
-   /** The total expected cost of traveling through this node from the origin to the destination. */
-   float fCost;
+   /** The size of the moving entity. */
+   const geometry::Size& m_entitySize;
 
-public:
-   /** The point that this node represents. */
-   geometry::Point2D point;
+   /** The goal tile. */
+   const geometry::Point2D m_destinationTile;
 
-   /** The predecessor of this node (the previous node on the shortest discovered path to this node). */
-   std::shared_ptr<AStarNode const> parent;
+   /** The search space used to cache tile occupancy. */
+   AStarSearchSpace& m_searchSpace;
 
+public:
    /**
     * Constructor.
     *
-    * @param point The tile coordinates of this node.
-    * @param gCost The actual distance cost required to travel from the origin to this node.
-    * @param hCost The estimated distance cost required to travel from this node to the destination.
-    * @param parent The predecessor of this node on a path from the origin.
-    */
-   AStarNode(geometry::Point2D point, float gCost, float hCost, const std::shared_ptr<AStarNode> parent = std::shared_ptr<AStarNode>()) : gCost(gCost), hCost(hCost), fCost(gCost + hCost), point(point), parent(parent) {}
-
-   /**
-    * Sets a new actual travel cost from the origin to this node.
-    *
-    * @param newCost The new travel cost from the origin to this node.
+    * @param pathfinder The pathfinder running the search.
+    * @param searchGrid The grid being searched.
+    * @param entityState The state of the entity trying to move.
+    * @param entitySize The size of the moving entity.
+    * @param destinationTile The goal tile.
+    * @param searchSpace The search space used to cache tile occupancy.
     */
-   void setGCost(float newCost)
+   JumpPointSearch(const Pathfinder& pathfinder, const SearchGrid& searchGrid, const TileState& entityState, const geometry::Size& entitySize, const geometry::Point2D& destinationTile, AStarSearchSpace& searchSpace) :
+      m_pathfinder(pathfinder),
+      m_searchGrid(searchGrid),
+      m_entityState(entityState),
+      m_entitySize(entitySize),
+      m_destinationTile(destinationTile),
+      m_searchSpace(searchSpace)
    {
-      gCost = newCost;
-      fCost = gCost + hCost;
    }
 
    /**
-    * Sets a new actual heuristic cost from this node to the destination.
+    * @param x The x-coordinate of the tile.
+    * @param y The y-coordinate of the tile.
     *
-    * @param newCost The new heuristic cost from this node to the destination.
+    * @return true iff the moving entity can occupy the tile.
     */
-   void setHCost(float newCost)
+   bool canOccupy(int x, int y) const
    {
-      hCost = newCost;
-      fCost = gCost + hCost;
+      return m_pathfinder.canOccupyTile(m_searchGrid, m_entityState, m_entitySize, geometry::Point2D(x, y), m_searchSpace);
    }
 
    /**
-    * @return The actual distance cost required to travel from the origin to this node.
+    * @param x The x-coordinate of the tile being left.
+    * @param y The y-coordinate of the tile being left.
+    * @param dx The horizontal direction of the move.
+    * @param dy The vertical direction of the move.
+    *
+    * @return true iff the entity can move one step in the given direction.
     */
-   float getGCost() const
+   bool canMove(int x, int y, int dx, int dy) const
    {
-      return gCost;
-   }
+      if(dx != 0 && dy != 0 && !(canOccupy(x + dx, y) && canOccupy(x, y + dy)))
+      {
+         return false;
+      }
 
-   /**
-    * @return The estimated distance cost required to travel from this node to the destination.
-    */
-   float getHCost() const
-   {
-      return hCost;
+      return canOccupy(x + dx, y + dy);
    }
 
    /**
-    * @return The total expected distance cost required to use this node to travel between the origin and destination.
+    * Moves from a tile in a straight line or diagonal until a jump point is found.
+    *
+    * @param tile The first tile of the jump. If a jump point is found, this is set to the jump point.
+    * @param dx The horizontal direction of the jump.
+    * @param dy The vertical direction of the jump.
+    *
+    * @return true iff a jump point was found.
     */
-   float getFCost() const
+   bool jump(geometry::Point2D& tile, int dx, int dy) const
    {
-      return fCost;
+      int x = tile.x;
+      int y = tile.y;
+
+      for(;;)
+      {
+         if(!canOccupy(x, y))
+         {
+            return false;
+         }
+
+         if(x == m_destinationTile.x && y == m_destinationTile.y)
+         {
+            break;
+         }
+
+         if(dx != 0 && dy != 0)
+         {
+            geometry::Point2D horizontalTile(x + dx, y);
+            geometry::Point2D verticalTile(x, y + dy);
+            if(jump(horizontalTile, dx, 0) || jump(verticalTile, 0, dy))
+            {
+               break;
+            }
+         }
+         else if(dx != 0)
+         {
+            if((canOccupy(x, y - 1) && !canOccupy(x - dx, y - 1)) ||
+               (canOccupy(x, y + 1) && !canOccupy(x - dx, y + 1)))
+            {
+               break;
+            }
+         }
+         else
+         {
+            if((canOccupy(x - 1, y) && !canOccupy(x - 1, y - dy)) ||
+               (canOccupy(x + 1, y) && !canOccupy(x + 1, y - dy)))
+            {
+               break;
+            }
+         }
+
+         if(dx != 0 && dy != 0 && !(canOccupy(x + dx, y) && canOccupy(x, y + dy)))
+         {
+            return false;
+         }
+
+         x += dx;
+         y += dy;
+      }
+
+      tile = geometry::Point2D(x, y);
+      return true;
    }
 
    /**
-    * Comparison operation between two A* nodes. The lowest cost node is the one
-    * with the lowest total estimated cost (F cost). In the case of a tie, the
-    * highest G cost wins since it is not as deep in the search tree.
+    * Finds the directions worth searching from a jump point, given the direction it was reached from.
     *
-    * @param lhs An A* node to compare.
-    * @param rhs Another A* node to compare.
+    * @param tile The jump point being expanded.
+    * @param parent The jump point that the tile was reached from, or the tile itself if it is the origin.
+    * @param directions The array to fill with the directions to search.
     *
-    * @return true iff lhs has a lower expected cost than rhs.
+    * @return The number of directions to search.
     */
-   static bool isLowerPriority(const std::shared_ptr<AStarNode>& lhs, const std::shared_ptr<AStarNode>& rhs)
+   int getSearchDirections(const geometry::Point2D& tile, const geometry::Point2D& parent, int directions[8][2]) const
    {
-      // We consider lhs to have a lower priority if it has a higher total f() cost.
-      // In case of a tie, this point will have lower priority if it has a lower g() cost,
-      // indicating that it is not as deep in the search tree.
-      return lhs->fCost > rhs->fCost || (lhs->fCost == rhs->fCost && lhs->gCost < rhs->gCost);
+      // Left, right, up, down, upper-left, lower-left, upper-right, lower-right
+      static const int ALL_DIRECTIONS[8][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1} };
+
+      int numDirections = 0;
+      const auto addDirection = [&](int dx, int dy)
+      {
+         if(canMove(tile.x, tile.y, dx, dy))
+         {
+            directions[numDirections][0] = dx;
+            directions[numDirections][1] = dy;
+            ++numDirections;
+         }
+      };
+
+      const int dx = (tile.x > parent.x) - (tile.x < parent.x);
+      const int dy = (tile.y > parent.y) - (tile.y < parent.y);
+
+      if(dx == 0 && dy == 0)
+      {
+         for(const auto& direction : ALL_DIRECTIONS)
+         {
+            addDirection(direction[0], direction[1]);
+         }
+      }
+      else if(dx != 0 && dy != 0)
+      {
+         addDirection(dx, 0);
+         addDirection(0, dy);
+         addDirection(dx, dy);
+      }
+      else if(dx != 0)
+      {
+         addDirection(dx, 0);
+         addDirection(0, -1);
+         addDirection(0, 1);
+         addDirection(dx, -1);
+         addDirection(dx, 1);
+      }
+      else
+      {
+         addDirection(0, dy);
+         addDirection(-1, 0);
+         addDirection(1, 0);
+         addDirection(-1, dy);
+         addDirection(1, dy);
+      }
+
+      return numDirections;
    }
 };
 
-Pathfinder::Path Pathfinder::findAStarPath(const EntityGrid& entityGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const
+Pathfinder::Path Pathfinder::findJumpPointPath(const SearchGrid& searchGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, AStarSearchSpace& searchSpace) const
 {
-   if(!m_collisionGrid || !m_collisionGridBounds || m_collisionGrid->empty()) return Path();
+   if(searchGrid.tiles.empty()) return Path();
 
-   const TileState& entityState = (*m_collisionGrid)(src.x / m_movementTileSize, src.y / m_movementTileSize);
+   const TileState& entityState = searchGrid.tiles(src.x / m_movementTileSize, src.y / m_movementTileSize);
 
-   if(!entityGrid.canOccupyArea(geometry::Rectangle(dst, size), entityState)) return Path();
+   if(!canOccupyArea(searchGrid, geometry::Rectangle(dst, size), entityState)) return Path();
 
    const geometry::Point2D sourceTile = src / m_movementTileSize;
    const geometry::Point2D destinationTile = dst / m_movementTileSize;
 
-   std::vector<std::shared_ptr<AStarNode>> openSet;
+   const int gridWidth = searchGrid.bounds.getWidth();
+   const int sourceTileNum = sourceTile.y * gridWidth + sourceTile.x;
+   const int destinationTileNum = destinationTile.y * gridWidth + destinationTile.x;
 
-   Grid<int> discovered(m_collisionGridBounds->getSize(), 0);
+   searchSpace.reset(searchGrid.bounds.getArea());
 
-   openSet.push_back(std::make_shared<AStarNode>(sourceTile, 0, 0));
-   std::push_heap(openSet.begin(), openSet.end(), AStarNode::isLowerPriority);
+   // Both heuristics are admissible, so the first path found to the goal is as cheap as any that A* finds.
+   const RoyFloydWarshallMatrices* rfwMatrices = searchGrid.rfwMatrices;
 
-   auto rfwMatrices =
-      isRoyFloydWarshallCalculationReady() ?
-      &m_royFloydWarshallCalculation.get() : nullptr;
+   const JumpPointSearch jumpPointSearch(*this, searchGrid, entityState, size, destinationTile, searchSpace);
 
-   discovered(sourceTile.x, sourceTile.y) = 1;
+   searchSpace.discover(sourceTileNum);
+   searchSpace.push(sourceTileNum, 0, 0, -1);
 
    Path path;
 
-   while(!openSet.empty())
+   int directions[8][2];
+   while(!searchSpace.empty())
    {
-      // Get the lowest-cost point in the open set, and remove it from the open set
-      std::shared_ptr<AStarNode> cheapestNode = openSet.front();
-      std::pop_heap(openSet.begin(), openSet.end(), AStarNode::isLowerPriority);
-      openSet.pop_back();
+      const int cheapestTileNum = searchSpace.pop();
+      const geometry::Point2D cheapestPoint(cheapestTileNum % gridWidth, cheapestTileNum / gridWidth);
 
-      if(cheapestNode->point == destinationTile)
+      if(cheapestTileNum == destinationTileNum)
       {
-         DEBUG("Found goal point %d,%d", cheapestNode->point.x, cheapestNode->point.y);
-         std::shared_ptr<AStarNode const> curr = cheapestNode;
-         while(curr)
+         DEBUG("Found goal point %d,%d", cheapestPoint.x, cheapestPoint.y);
+
+         // Fill in the tiles between consecutive jump points, which always lie on a straight line or diagonal.
+         geometry::Point2D curr = cheapestPoint;
+         for(int parentTileNum = searchSpace.getNode(cheapestTileNum).parent; parentTileNum >= 0; parentTileNum = searchSpace.getNode(parentTileNum).parent)
          {
-            path.push_front(curr->point * m_movementTileSize);
-            curr = curr->parent;
+            const geometry::Point2D parentPoint(parentTileNum % gridWidth, parentTileNum / gridWidth);
+            const int dx = (parentPoint.x > curr.x) - (parentPoint.x < curr.x);
+            const int dy = (parentPoint.y > curr.y) - (parentPoint.y < curr.y);
+            while(curr != parentPoint)
+            {
+               path.push_front(curr * m_movementTileSize);
+               curr = geometry::Point2D(curr.x + dx, curr.y + dy);
+            }
          }
+
+         path.push_front(sourceTile * m_movementTileSize);
          break;
       }
 
-      DEBUG("Evaluating point %d,%d", cheapestNode->point.x, cheapestNode->point.y);
+      DEBUG("Evaluating jump point %d,%d", cheapestPoint.x, cheapestPoint.y);
+
+      const int parentTileNum = searchSpace.getNode(cheapestTileNum).parent;
+      const geometry::Point2D parentPoint = parentTileNum >= 0 ?
+         geometry::Point2D(parentTileNum % gridWidth, parentTileNum / gridWidth) :
+         cheapestPoint;
 
-      evaluateAdjacentNodes(entityState, size, cheapestNode, destinationTile, entityGrid, rfwMatrices, openSet, discovered);
+      const float cheapestGCost = searchSpace.getNode(cheapestTileNum).gCost;
+      const int numDirections = jumpPointSearch.getSearchDirections(cheapestPoint, parentPoint, directions);
+      for(int i = 0; i < numDirections; ++i)
+      {
+         geometry::Point2D jumpPoint(cheapestPoint.x + directions[i][0], cheapestPoint.y + directions[i][1]);
+         if(!jumpPointSearch.jump(jumpPoint, directions[i][0], directions[i][1]))
+         {
+            continue;
+         }
+
+         const int jumpTileNum = jumpPoint.y * gridWidth + jumpPoint.x;
+         const float jumpGCost = cheapestGCost + Pathfinder::getOctileDistance(cheapestPoint, jumpPoint);
+
+         if(!searchSpace.isDiscovered(jumpTileNum))
+         {
+            const float jumpHCost = rfwMatrices ? rfwMatrices->getDistance(jumpPoint, destinationTile) : Pathfinder::getOctileDistance(jumpPoint, destinationTile);
+            DEBUG("Pushing jump point %d,%d onto open set with parent point %d,%d and g()=%f and f()=%f.", jumpPoint.x, jumpPoint.y, cheapestPoint.x, cheapestPoint.y, jumpGCost, jumpGCost + jumpHCost);
+            searchSpace.discover(jumpTileNum);
+            searchSpace.push(jumpTileNum, jumpGCost, jumpHCost, cheapestTileNum);
+         }
+         else if(searchSpace.decreaseCost(jumpTileNum, jumpGCost, cheapestTileNum))
+         {
+            DEBUG("Altering cost of jump point %d, %d to g()=%f", jumpPoint.x, jumpPoint.y, jumpGCost);
+         }
+      }
    }
 
    return path;
 }
 
-unsigned int Pathfinder::getManhattanDistance(const geometry::Point2D& src, const geometry::Point2D& dst)
+Pathfinder::Path Pathfinder::findCooperativePath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, const ReservationTable& reservations, long startTime, long stepDuration, unsigned int window) const
 {
-   unsigned int xDistance = abs(dst.x - src.x);
-   unsigned int yDistance = abs(dst.y - src.y);
+   /**
+    * A tile at a point in time (measured in steps) within the search window.
+    */
+   struct SpaceTimeNode
+   {
+      geometry::Point2D tile;
+      unsigned int step;
+      float gCost;
+      int parent;
+   };
 
-   return xDistance + yDistance;
-}
+   // Waiting in place, followed by left, right, up, down, upper-left, lower-left, upper-right, lower-right
+   static const int STEP_OFFSETS[9][2] = { {0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1} };
 
-void Pathfinder::evaluateAdjacentNodes(const TileState& entityState, const geometry::Size& entitySize, const std::shared_ptr<AStarNode>& evaluatedNode, const geometry::Point2D& destinationTile, const EntityGrid& entityGrid, const RoyFloydWarshallMatrices *const rfwMatrices, std::vector<std::shared_ptr<AStarNode>>& openSet, Grid<int>& discovered) const
-{
-   const std::vector<geometry::Point2D> adjacentPoints = Pathfinder::getAdjacentPoints(evaluatedNode->point, *m_collisionGridBounds);
-   for(auto& adjacentPoint : adjacentPoints)
+   Path path;
+   if(!m_collisionGrid || m_collisionGrid->empty() || window == 0) return path;
+
+   const SearchGrid searchGrid = { *m_collisionGrid, *m_occupancyGrid, *m_clearanceGrid, *m_collisionGridBounds, getRoyFloydWarshallMatrices() };
+   const geometry::Point2D sourceTile = src / m_movementTileSize;
+   const geometry::Point2D goalTile = dst / m_movementTileSize;
+   const TileState& entityState = searchGrid.tiles(sourceTile.x, sourceTile.y);
+   const geometry::Rectangle& bounds = searchGrid.bounds;
+   const int gridWidth = bounds.getWidth();
+
+   const auto getTileArea = [&](const geometry::Point2D& tile)
    {
-      bool diagonalMovement =
-         adjacentPoint.x != evaluatedNode->point.x &&
-         adjacentPoint.y != evaluatedNode->point.y;
+      const geometry::Point2D location = tile * m_movementTileSize;
+      return geometry::Rectangle(
+         tile.y,
+         tile.x,
+         (location.y + static_cast<int>(size.height) - 1) / m_movementTileSize,
+         (location.x + static_cast<int>(size.width) - 1) / m_movementTileSize);
+   };
 
-      float tileGCost = evaluatedNode->getGCost() + (diagonalMovement ? ROOT_2 : 1.0f);
-      float tileHCost = rfwMatrices ? rfwMatrices->getDistance(adjacentPoint, destinationTile) : Pathfinder::getManhattanDistance(adjacentPoint, destinationTile);
-      if(discovered(adjacentPoint.x, adjacentPoint.y) == 0)
+   // Static obstacles and the edges of the grid block a tile for the whole search.
+   const auto isOpen = [&](const geometry::Point2D& tile)
+   {
+      const geometry::Rectangle area = getTileArea(tile);
+      if(area.left < bounds.left || area.top < bounds.top || area.right >= bounds.right || area.bottom >= bounds.bottom)
       {
-         discovered(adjacentPoint.x, adjacentPoint.y) = 1;
+         return false;
+      }
 
-         bool freeTile = entityGrid.canOccupyArea(geometry::Rectangle(adjacentPoint * m_movementTileSize, entitySize), entityState);
+      // Most areas are entirely free, which the clearance grid can confirm with a single lookup.
+      const int areaSize = std::max(area.getWidth(), area.getHeight()) + 1;
+      if(searchGrid.clearance(area.left, area.top) >= areaSize)
+      {
+         return true;
+      }
 
-         if(diagonalMovement)
+      for(int y = area.top; y <= area.bottom; ++y)
+      {
+         for(int x = searchGrid.occupancy.findFirstSet(y, area.left, area.right); x >= 0; x = searchGrid.occupancy.findFirstSet(y, x + 1, area.right))
          {
-            const geometry::Point2D horizontalDestinationPoint(evaluatedNode->point.x, adjacentPoint.y);
-            const geometry::Point2D verticalDestinationPoint(adjacentPoint.x, evaluatedNode->point.y);
-
-            freeTile = freeTile &&
-               entityGrid.canOccupyArea(geometry::Rectangle(horizontalDestinationPoint * m_movementTileSize, entitySize), entityState) &&
-               entityGrid.canOccupyArea(geometry::Rectangle(verticalDestinationPoint * m_movementTileSize, entitySize), entityState);
+            if(searchGrid.tiles(x, y).entityType == TileState::EntityType::OBSTACLE)
+            {
+               return false;
+            }
          }
+      }
 
-         if(freeTile)
+      return true;
+   };
+
+   // The distance through the static obstacles is exact (ignoring entities), while the octile distance
+   // only stands in until the RFW matrices are ready. The matrices route single tiles, so they
+   // underestimate the distance for larger entities, which keeps the heuristic admissible.
+   const auto getDistanceToGoal = [&](const geometry::Point2D& tile)
+   {
+      return searchGrid.rfwMatrices ? searchGrid.rfwMatrices->getDistance(tile, goalTile) : getOctileDistance(tile, goalTile);
+   };
+
+   // Entities without reservations are not going anywhere, so they block their tiles for the whole window.
+   const auto isBlockedByIdleEntity = [&](const geometry::Rectangle& area)
+   {
+      for(int y = area.top; y <= area.bottom; ++y)
+      {
+         for(int x = area.left; x <= area.right; ++x)
          {
-            DEBUG("Pushing point %d,%d onto open set with parent point %d,%d and g()=%f and f()=%f.", adjacentPoint.x, adjacentPoint.y, evaluatedNode->point.x, evaluatedNode->point.y, tileGCost, tileGCost + tileHCost);
-            openSet.push_back(std::make_shared<AStarNode>(adjacentPoint, tileGCost, tileHCost, evaluatedNode));
-            std::push_heap(openSet.begin(), openSet.end(), AStarNode::isLowerPriority);
+            const TileState& tileState = searchGrid.tiles(x, y);
+            if(tileState.entityType == TileState::EntityType::ACTOR &&
+               tileState.entity != entityState.entity &&
+               !reservations.hasReservations(tileState.entity))
+            {
+               return true;
+            }
          }
       }
-      else
+
+      return false;
+   };
+
+   if(goalTile != sourceTile && (!isOpen(goalTile) || isBlockedByIdleEntity(getTileArea(goalTile))))
+   {
+      // Waiting for the goal to be vacated won't help, so leave it to the caller to route around it.
+      return path;
+   }
+
+   std::vector<SpaceTimeNode> nodes;
+   std::unordered_map<std::uint64_t, int> discoveredNodes;
+   std::vector<char> closedNodes;
+
+   typedef std::pair<float, int> OpenEntry;
+   std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> openSet;
+
+   const auto getKey = [gridWidth](const geometry::Point2D& tile, unsigned int step)
+   {
+      return (static_cast<std::uint64_t>(step) << 32) | static_cast<std::uint32_t>(tile.y * gridWidth + tile.x);
+   };
+
+   nodes.push_back({ sourceTile, 0, 0.0f, -1 });
+   closedNodes.push_back(0);
+   discoveredNodes[getKey(sourceTile, 0)] = 0;
+   openSet.emplace(getDistanceToGoal(sourceTile), 0);
+
+   int lastNode = -1;
+   while(!openSet.empty())
+   {
+      const int nodeIndex = openSet.top().second;
+      openSet.pop();
+
+      if(closedNodes[nodeIndex])
+      {
+         continue;
+      }
+
+      closedNodes[nodeIndex] = 1;
+      const SpaceTimeNode node = nodes[nodeIndex];
+      if(node.step == window || node.tile == goalTile)
+      {
+         lastNode = nodeIndex;
+         break;
+      }
+
+      const long stepStart = startTime + node.step * stepDuration;
+      const long stepEnd = stepStart + stepDuration;
+      const geometry::Rectangle tileArea = getTileArea(node.tile);
+      if(!reservations.isAvailable(tileArea, stepStart, stepEnd, entityState.entity))
+      {
+         // Someone else will be here, so the entity can't stay or leave from this tile in time.
+         continue;
+      }
+
+      for(const auto& offset : STEP_OFFSETS)
       {
-         const auto& openSetIter = std::find_if(
-                                      openSet.begin(),
-                                      openSet.end(),
-                                      [&](const std::shared_ptr<AStarNode>& node)
-                                      {
-                                         return node->point == adjacentPoint;
-                                      });
+         const geometry::Point2D nextTile(node.tile.x + offset[0], node.tile.y + offset[1]);
+         const bool waiting = offset[0] == 0 && offset[1] == 0;
+         const bool diagonalMovement = offset[0] != 0 && offset[1] != 0;
 
-         if(openSetIter != openSet.end())
+         if(!waiting && !isOpen(nextTile))
          {
-            const auto& tileInOpenSet = *openSetIter;
-            if(tileInOpenSet->getGCost() > tileGCost)
+            continue;
+         }
+
+         if(diagonalMovement &&
+            (!isOpen(geometry::Point2D(node.tile.x, nextTile.y)) || !isOpen(geometry::Point2D(nextTile.x, node.tile.y))))
+         {
+            // Diagonal steps can't cut the corners of obstacles.
+            continue;
+         }
+
+         const float distanceToGoal = getDistanceToGoal(nextTile);
+         if(distanceToGoal == std::numeric_limits<float>::infinity())
+         {
+            // The goal can't be reached from this tile at all.
+            continue;
+         }
+
+         if(!waiting)
+         {
+            const geometry::Rectangle nextTileArea = getTileArea(nextTile);
+            const bool nextTileFree = node.step == 0 ?
+               canOccupyArea(searchGrid, geometry::Rectangle(nextTile * m_movementTileSize, size), entityState) :
+               !isBlockedByIdleEntity(nextTileArea);
+
+            if(!nextTileFree || !reservations.isAvailable(nextTileArea, stepStart, stepEnd, entityState.entity))
             {
-               DEBUG("Altering cost of discovered point %d, %d to g()=%f and f()=%f", adjacentPoint.x, adjacentPoint.y, tileGCost, tileGCost + tileHCost);
-               tileInOpenSet->setGCost(tileGCost);
-               tileInOpenSet->parent = evaluatedNode;
-               std::make_heap(openSet.begin(), openSet.end(), AStarNode::isLowerPriority);
+               continue;
             }
          }
+
+         const std::uint64_t key = getKey(nextTile, node.step + 1);
+         const float gCost = node.gCost + (diagonalMovement ? ROOT_2 : 1.0f);
+         const auto discoveredNode = discoveredNodes.find(key);
+         if(discoveredNode == discoveredNodes.end())
+         {
+            const int nextNodeIndex = nodes.size();
+            discoveredNodes[key] = nextNodeIndex;
+            nodes.push_back({ nextTile, node.step + 1, gCost, nodeIndex });
+            closedNodes.push_back(0);
+            openSet.emplace(gCost + distanceToGoal, nextNodeIndex);
+         }
+         else if(!closedNodes[discoveredNode->second] && gCost < nodes[discoveredNode->second].gCost)
+         {
+            SpaceTimeNode& nextNode = nodes[discoveredNode->second];
+            nextNode.gCost = gCost;
+            nextNode.parent = nodeIndex;
+            openSet.emplace(gCost + distanceToGoal, discoveredNode->second);
+         }
       }
    }
+
+   for(int curr = lastNode; curr > 0; curr = nodes[curr].parent)
+   {
+      path.push_front(nodes[curr].tile * m_movementTileSize);
+   }
+
+   DEBUG("Planned %d cooperative steps from %d,%d after searching %d space-time nodes.", static_cast<int>(path.size()), src.x, src.y, static_cast<int>(nodes.size()));
+   return path;
 }
 
 Pathfinder::Path Pathfinder::findRFWPath(const geometry::Point2D& src, const geometry::Point2D& dst, const RoyFloydWarshallMatrices& rfwMatrices) const
@@ -354,5 +1624,25 @@ Pathfinder::Path Pathfinder::findRFWPath(const geometry::Point2D& src, const geo
       sourceTile = std::get<1>(nextTile);
    }
 
+   if(!path.empty())
+   {
+      // The destination has no successor, so it ends the path (as it does in hierarchical paths).
+      path.push_back(destinationTile * m_movementTileSize);
+   }
+
+   return path;
+}
+
+Pathfinder::Path Pathfinder::findHierarchicalPath(const geometry::Point2D& src, const geometry::Point2D& dst, int footprint) const
+{
+   Path path;
+   if(!m_collisionGrid || m_collisionGrid->empty()) return path;
+
+   const auto tiles = m_hierarchicalGraph->findPath(src / m_movementTileSize, dst / m_movementTileSize, footprint);
+   for(const auto& tile : tiles)
+   {
+      path.push_back(tile * m_movementTileSize);
+   }
+
    return path;
 }
@@ -7,17 +7,24 @@
 #ifndef PATHFINDER_H
 #define PATHFINDER_H
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <future>
 #include <list>
+#include <memory>
 #include <vector>
 
 #include "Grid.h"
+#include "HierarchicalPathGraph.h"
 #include "Rectangle.h"
 #include "RoyFloydWarshallMatrices.h"
+#include "WorkerPool.h"
 
 class Actor;
-class EntityGrid;
+class BitGrid;
 class Map;
+class ReservationTable;
 
 namespace geometry
 {
@@ -39,18 +46,74 @@ class Pathfinder final
    /** The square root of 2. */
    static const float ROOT_2;
 
+   /**
+    * The largest grid (in tiles) for which the RFW matrices are calculated.
+    * The matrices grow quadratically (and their calculation cubically) with the number of tiles,
+    * so larger grids are served by a hierarchical path graph instead.
+    */
+   static const unsigned int MAX_RFW_TILES;
+
+   /** The largest number of queued path requests handed to the workers in a single frame. */
+   static const unsigned int MAX_PATH_QUERIES_PER_FRAME;
+
+   /** The largest number of worker threads used to solve path requests. */
+   static const unsigned int MAX_PATH_WORKERS;
+
+   /** The largest number of path results kept in the path cache. */
+   static const unsigned int MAX_CACHED_PATHS;
+
+   /** The largest number of grid snapshots kept to be reused by later batches of path requests. */
+   static const unsigned int MAX_GRID_SNAPSHOTS;
+
+   /** The largest number of changed areas tracked for a grid snapshot before it must be copied in full again. */
+   static const unsigned int MAX_SNAPSHOT_CHANGES;
+
    /** The task tracking the asynchronous calculation of the grid's RFW matrices. */
    CancelableTask<RoyFloydWarshallMatrices> m_royFloydWarshallCalculation;
 
+   /**
+    * The abstract graph used to find paths on grids too large for the RFW matrices.
+    * The matrices only route single tiles, so the graph also routes larger entities on smaller grids.
+    */
+   std::unique_ptr<HierarchicalPathGraph> m_hierarchicalGraph;
+
    /** The size (in pixels) of each tile. */
    int m_movementTileSize;
 
    /** The grid to compute paths on. */
    const Grid<TileState>* m_collisionGrid = nullptr;
 
+   /** One bit per tile of the grid, set for every tile that isn't free. */
+   const BitGrid* m_occupancyGrid = nullptr;
+
+   /** The size of the largest free square at each tile of the grid. */
+   const Grid<std::uint8_t>* m_clearanceGrid = nullptr;
+
+   /** The connected region of each tile of the grid (0 for tiles blocked by obstacles). */
+   const Grid<unsigned int>* m_componentGrid = nullptr;
+
+   /** Incremented by the owner of the grid whenever static obstacles change, which makes cached paths stale. */
+   const unsigned long* m_collisionEpoch = nullptr;
+
    /** The bounds (in tiles) of the grid. */
    const geometry::Rectangle* m_collisionGridBounds = nullptr;
 
+   /**
+    * A copy of the grid that a batch of path requests is solved against on the worker threads.
+    */
+   struct GridSnapshot;
+
+   /**
+    * Snapshots kept for later batches of path requests. Once no running search uses a snapshot,
+    * it is brought up to date by copying only the areas of the grid that changed since it was taken.
+    */
+   std::vector<std::shared_ptr<GridSnapshot>> m_gridSnapshots;
+
+   /**
+    * @return A snapshot of the grid as it is now, which is either a reused snapshot that was brought up to date or a new copy.
+    */
+   std::shared_ptr<const GridSnapshot> takeGridSnapshot();
+
    /**
     * Runs the Roy-Floyd-Warshall algorithm on the initialized entity grid
     * to initialize the distance matrix and the successor matrix.
@@ -62,48 +125,207 @@ class Pathfinder final
     */
    bool isRoyFloydWarshallCalculationReady() const;
 
+   /**
+    * @return The RFW matrices for the grid, or nullptr if they are not (yet) available.
+    */
+   const RoyFloydWarshallMatrices* getRoyFloydWarshallMatrices() const;
+
+   /**
+    * @param src The coordinates of the source (in pixels).
+    * @param dst The coordinates of the destination (in pixels).
+    *
+    * @return true iff the source and destination are in the same connected region of the grid,
+    * which is required for any path between them to exist.
+    */
+   bool areConnected(const geometry::Point2D& src, const geometry::Point2D& dst) const;
+
    public:
       /** A set of waypoints to move through in order to go from one point to another. */
       typedef std::list<geometry::Point2D> Path;
 
+      /**
+       * The largest distance (in pixels) covered by a single segment of a smoothed path.
+       * An entity holds every tile along a segment until it reaches the end of the segment,
+       * so longer segments would keep other entities out of a corridor for too long.
+       */
+      static const unsigned int MAX_SEGMENT_LENGTH;
+
+      /**
+       * The search algorithms that can be used to route around moving entities.
+       */
+      enum class SearchAlgorithm
+      {
+         /** A* search, expanding every adjacent tile */
+         A_STAR,
+         /**
+          * Jump Point Search, which puts far fewer tiles on the open set but checks the occupancy of
+          * every tile along each jump. With the precomputed distances as a heuristic, A* already goes
+          * almost straight to the destination, so JPS is usually slower and the engine never asks for it.
+          */
+         JUMP_POINT_SEARCH,
+      };
+
+      /**
+       * A handle to a path request that is solved on a worker thread.
+       */
+      class PathQuery;
+
       /**
        * Constructor.
        */
       Pathfinder();
 
+      /**
+       * Destructor.
+       */
+      ~Pathfinder();
+
       /**
        * Initializes the pathfinder for the given entity grid.
        *
        * @param grid The entity grid to perform pathfinding computations on.
+       * @param occupancyGrid One bit per tile of the grid, set for every tile that isn't free.
+       * @param clearanceGrid The size (in tiles) of the largest free square at each tile of the grid.
+       * @param componentGrid The connected region of each tile of the grid, ignoring moving entities.
+       *                      Tiles with different labels can't reach each other, and tiles labelled 0 are blocked.
+       * @param collisionEpoch A counter that is incremented whenever static obstacles are added to or removed from the grid.
        * @param tileSize The size (in pixels) of each tile.
        * @param gridBounds The bounds of the grid.
        */
-      void initialize(const Grid<TileState>& grid, int tileSize, const geometry::Rectangle& gridBounds);
+      void initialize(const Grid<TileState>& grid, const BitGrid& occupancyGrid, const Grid<std::uint8_t>& clearanceGrid, const Grid<unsigned int>& componentGrid, const unsigned long& collisionEpoch, int tileSize, const geometry::Rectangle& gridBounds);
+
+      /**
+       * Updates the precomputed path data after static obstacles are added to the grid.
+       * The RFW matrices and the hierarchical path graph are repaired around the area,
+       * instead of being rebuilt for the whole grid.
+       *
+       * @param area The area (in tiles, with inclusive edges) where obstacles were added.
+       */
+      void addObstacles(const geometry::Rectangle& area);
+
+      /**
+       * Records a change to the tiles of the grid, so that the grid snapshots
+       * used by path requests can be brought up to date without copying the whole grid.
+       *
+       * @param area The area (in tiles, with inclusive edges) whose tiles, occupancy or clearance changed.
+       */
+      void markChanged(const geometry::Rectangle& area);
+
+      /**
+       * @param size The size of a moving entity.
+       *
+       * @return true iff there is precomputed path data to find best paths for the entity with.
+       */
+      bool hasPathData(const geometry::Size& size) const;
 
       /**
        * Finds an ideal path from the source coordinates to the destination.
        *
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
        *
-       * @return The ideal best path from the source point to the destination point.
+       * @return The ideal best path from the source point to the destination point,
+       * or an empty path if there is none or there is no precomputed path data for the entity (see hasPathData).
+       * Paths found with the precomputed path data only depend on static obstacles, so they are cached
+       * (by source tile, destination tile and size) until the obstacles change.
        */
-      Path findBestPath(const EntityGrid& entityGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const;
+      Path findBestPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const;
 
       /**
        * Finds the shortest path from the source coordinates to the destination
        * around all obstacles and entities.
        *
-       * @param entityGrid The entity grid container.
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        * @param size The size of the moving entity.
+       * @param algorithm The search algorithm to use.
        *
-       * @return The shortest unobstructed path from the source point to the destination point.
+       * @return The shortest unobstructed path from the source point to the destination point,
+       *         smoothed so that consecutive waypoints may be several tiles apart (see getSegmentStep).
+       */
+      Path findReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm = SearchAlgorithm::A_STAR) const;
+
+      /**
+       * Requests the shortest path from the source coordinates to the destination around
+       * all obstacles and entities, without blocking. Requests are queued until the next call
+       * to dispatchPathQueries, which hands them to the worker threads in batches.
+       * Each batch is solved against a snapshot of the grid taken when it was dispatched,
+       * so the path reflects the locations of entities at that time.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       * @param algorithm The search algorithm to use.
+       *
+       * @return A handle to poll for the (smoothed) path. Releasing the handle abandons the request.
+       */
+      std::shared_ptr<const PathQuery> requestReroutedPath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm = SearchAlgorithm::A_STAR);
+
+      /**
+       * Hands the oldest queued path requests to the worker threads, along with a snapshot
+       * of the grid to solve them against. At most MAX_PATH_QUERIES_PER_FRAME requests are
+       * dispatched per call, so this should be called once per frame.
        */
-      Path findReroutedPath(const EntityGrid& entityGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const;
+      void dispatchPathQueries();
+
+      /**
+       * Plans the next few steps toward a destination with windowed cooperative A* (WHCA*).
+       * The search runs through space and time: each step either moves to an adjacent tile or waits,
+       * and may not use any tile reserved by another entity at that time. Beyond the window,
+       * the distance through the static obstacles (from the RFW matrices) is used as the heuristic,
+       * or the octile distance while the matrices aren't available.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       * @param reservations The tiles reserved by moving entities.
+       * @param startTime The time at which the first step begins (in milliseconds).
+       * @param stepDuration The time that the entity takes to move a single tile (in milliseconds).
+       * @param window The number of steps to plan.
+       *
+       * @return The waypoint reached by each planned step, where a waypoint equal to the previous one is a wait.
+       * The path is cut short if the destination is reached, and is empty if no step can be taken at all
+       * or if the destination is taken by an entity without reservations (which won't make way).
+       */
+      Path findCooperativePath(const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, const ReservationTable& reservations, long startTime, long stepDuration, unsigned int window) const;
+
+      /**
+       * Entities move toward a waypoint along both axes at the same rate, so they move
+       * diagonally until they are lined up with the waypoint, and then move straight to it.
+       * This gives the tile-aligned points that an entity passes through along the way.
+       *
+       * @param location The current location of the entity.
+       * @param dst The waypoint the entity is moving toward.
+       * @param stepSize The size of a tile (1 when the locations are given in tiles).
+       *
+       * @return The location of the entity after moving one tile toward the waypoint.
+       */
+      static geometry::Point2D getSegmentStep(const geometry::Point2D& location, const geometry::Point2D& dst, int stepSize);
 
    private:
+      /**
+       * The grid that a search runs against (either the live grid or a snapshot of it),
+       * along with the precomputed data used for its heuristic.
+       */
+      struct SearchGrid
+      {
+         /** The tiles of the grid. */
+         const Grid<TileState>& tiles;
+
+         /** One bit per tile, set for every tile that isn't free. */
+         const BitGrid& occupancy;
+
+         /** The size (in tiles) of the largest free square at each tile. */
+         const Grid<std::uint8_t>& clearance;
+
+         /** The bounds (in tiles) of the grid. */
+         const geometry::Rectangle bounds;
+
+         /** The RFW matrices for the grid, or nullptr if they are not available. */
+         const RoyFloydWarshallMatrices* rfwMatrices;
+      };
+
       /**
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
@@ -123,6 +345,25 @@ class Pathfinder final
        */
       Path findRFWPath(const geometry::Point2D& src, const geometry::Point2D& dst, const RoyFloydWarshallMatrices& rfwMatrices) const;
 
+      /**
+       * Uses the hierarchical path graph computed on Pathfinder initialization to determine the best path.
+       * This path does not take into account moving entities like Actors or the player.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param footprint The width and height (in tiles) of the square covered by the entity that will travel the path.
+       *
+       * @return The best path computed through the hierarchical path graph.
+       */
+      Path findHierarchicalPath(const geometry::Point2D& src, const geometry::Point2D& dst, int footprint) const;
+
+      /**
+       * @param size The size of an entity (in pixels).
+       *
+       * @return The width and height (in tiles) of the smallest square of tiles that covers the entity.
+       */
+      int getFootprint(const geometry::Size& size) const;
+
       /**
        * Manhattan distance heuristic for A* search.
        *
@@ -134,46 +375,175 @@ class Pathfinder final
       static unsigned int getManhattanDistance(const geometry::Point2D& src, const geometry::Point2D& dst);
 
       /**
-       * @param point The point to evaluate for neighbours.
-       * @param bounds The rectangular area containing the point.
+       * Octile distance heuristic for Jump Point Search.
+       *
+       * @param src The coordinates of the source.
+       * @param dst The coordinates of the destination.
+       *
+       * @return the length of the shortest path between src and dst on an empty 8-connected grid.
+       */
+      static float getOctileDistance(const geometry::Point2D& src, const geometry::Point2D& dst);
+
+      /**
+       * The occupancy checks and jumping rules used in Jump Point Search.
+       */
+      class JumpPointSearch;
+
+      /**
+       * A node used in A* search.
+       */
+      class AStarNode;
+
+      /**
+       * The pooled nodes and open set reused by each A* search.
+       */
+      class AStarSearchSpace;
+
+      /**
+       * A bounded cache of the most recently found static paths.
+       */
+      class PathCache;
+
+      /** The static paths found on the grid, allocated on the first request and cleared when the grid is replaced. */
+      mutable std::unique_ptr<PathCache> m_pathCache;
+
+      /**
+       * Finds the shortest path around all obstacles and entities on the given grid.
+       *
+       * @param searchGrid The grid to search.
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       * @param algorithm The search algorithm to use.
+       * @param searchSpace The scratch space to run the search in.
        *
-       * @return A set of points adjacent to the point within the given bounds.
+       * @return The shortest unobstructed path from the source point to the destination point.
        */
-      static std::vector<geometry::Point2D> getAdjacentPoints(const geometry::Point2D& point, const geometry::Rectangle& bounds);
+      Path findReroutedPath(const SearchGrid& searchGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, SearchAlgorithm algorithm, AStarSearchSpace& searchSpace) const;
 
       /**
        * Uses the A* algorithm to dynamically find the best possible path. Uses the Roy-Floyd-Warshall distance matrix as a heuristic when determining the best path.
-       * This path will route around any dynamically added obstacles or moving entities based on their locations when this function is called.
+       * This path will route around any dynamically added obstacles or moving entities based on their locations in the searched grid.
        *
-       * @param entityGrid The entity grid container.
+       * @param searchGrid The grid to search.
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        * @param size The size of the moving entity.
+       * @param searchSpace The scratch space to run the search in.
        *
        * @return The best path computed by the A* algorithm.
        */
-      Path findAStarPath(const EntityGrid& entityGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size) const;
+      Path findAStarPath(const SearchGrid& searchGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, AStarSearchSpace& searchSpace) const;
 
       /**
-       * A node used in A* search.
+       * Uses Jump Point Search to find the best possible path. Produces paths of the same cost as A*,
+       * but only adds the tiles where a path may need to turn (jump points) to the open set.
+       * Like A*, this path will route around any dynamically added obstacles or moving entities.
+       *
+       * @param searchGrid The grid to search.
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param size The size of the moving entity.
+       * @param searchSpace The scratch space to run the search in.
+       *
+       * @return The best path computed by Jump Point Search, with a waypoint for every tile along the way.
        */
-      class AStarNode;
+      Path findJumpPointPath(const SearchGrid& searchGrid, const geometry::Point2D& src, const geometry::Point2D& dst, const geometry::Size& size, AStarSearchSpace& searchSpace) const;
+
+      /**
+       * Checks whether an entity can move straight from one tile to another, passing through the tiles
+       * given by getSegmentStep. Each diagonal step must obey the same corner rule as A* search.
+       *
+       * @param searchGrid The grid to check.
+       * @param srcTile The tile that the segment starts at.
+       * @param dstTile The tile that the segment ends at.
+       * @param size The size of the moving entity.
+       * @param entityState The state of the moving entity.
+       *
+       * @return true iff the entity can occupy every tile along the segment.
+       */
+      bool isSegmentClear(const SearchGrid& searchGrid, const geometry::Point2D& srcTile, const geometry::Point2D& dstTile, const geometry::Size& size, const TileState& entityState) const;
+
+      /**
+       * Removes the waypoints of a path that can be skipped by moving straight from an earlier waypoint
+       * (string pulling). Segments are only joined if they are clear, so the smoothed path is never
+       * longer than the original, and no segment is longer than MAX_SEGMENT_LENGTH.
+       *
+       * @param searchGrid The grid that the path was found on.
+       * @param path The path to smooth, with a waypoint for every tile along the way.
+       * @param size The size of the moving entity.
+       * @param entityState The state of the moving entity.
+       *
+       * @return The path with only the waypoints where the entity needs to turn (or stop to free the tiles behind it).
+       */
+      Path smoothPath(const SearchGrid& searchGrid, const Path& path, const geometry::Size& size, const TileState& entityState) const;
+
+      /** The scratch space for searches on the calling thread, allocated on the first search and reused afterwards. */
+      mutable std::unique_ptr<AStarSearchSpace> m_searchSpace;
+
+      /** The path requests waiting to be dispatched to the workers, oldest first. */
+      std::deque<std::shared_ptr<PathQuery>> m_pendingQueries;
+
+      /** The scratch space for the searches run by each worker, indexed by worker. */
+      std::vector<std::unique_ptr<AStarSearchSpace>> m_workerSearchSpaces;
+
+      /**
+       * Set once the path request jobs dispatched so far are no longer wanted. Jobs that start
+       * after it is set complete their requests without searching, so they never touch state
+       * that may have been replaced since they were dispatched.
+       */
+      std::shared_ptr<std::atomic<bool>> m_pathJobsAbandoned = std::make_shared<std::atomic<bool>>(false);
+
+      /**
+       * The path request jobs running on the shared worker pool.
+       * Declared last so that it is destroyed (finishing any running searches) before the state the searches use.
+       */
+      WorkerPool::JobGroup m_pathJobs;
+
+      /**
+       * Abandons the path request jobs that haven't started yet (they complete their requests without a path)
+       * and waits for the searches that are already running. Queued jobs may be stuck behind other work on the
+       * shared pool, so waiting for them could block for as long as that work takes.
+       */
+      void abandonPathJobs();
+
+      /**
+       * Checks if an area of the grid can be occupied by the given entity.
+       *
+       * @param searchGrid The grid to check.
+       * @param area The rectangular region to occupy (in pixels).
+       * @param entityState The state of the entity trying to occupy the area.
+       *
+       * @return true iff the area is within the grid and is free or already occupied by the entity.
+       */
+      bool canOccupyArea(const SearchGrid& searchGrid, const geometry::Rectangle& area, const TileState& entityState) const;
+
+      /**
+       * Checks whether the moving entity can occupy a tile, caching the result for the rest of the search.
+       *
+       * @param searchGrid The grid being searched.
+       * @param entityState The state of the entity trying to move.
+       * @param entitySize The entity size.
+       * @param tile The tile to check.
+       * @param searchSpace The nodes and open set of the current search.
+       *
+       * @return true iff the tile is within the grid and the entity can occupy it.
+       */
+      bool canOccupyTile(const SearchGrid& searchGrid, const TileState& entityState, const geometry::Size& entitySize, const geometry::Point2D& tile, AStarSearchSpace& searchSpace) const;
 
       /**
        * Evaluate the neighbours of the evaluated node for A* search expansion.
        * Alters costs in the open set if cheaper paths are found,
        * and adds undiscovered tiles to the open set.
        *
+       * @param searchGrid The grid being searched.
        * @param entityState The state of the entity trying to move to the nodes.
        * @param entitySize The entity size.
-       * @param evaluatedNode The node that is currently being evaluated.
+       * @param evaluatedPoint The tile of the node that is currently being evaluated.
        * @param destinationTile The goal point.
-       * @param entityGrid The entity grid container.
-       * @param rfwMatrices The Roy-Floyd-Warshall matrices for the map.
-       * @param openSet The open set used to accumulate undiscovered points.
-       * @param discovered A mapping from tile numbers to whether or not they have been discovered.
+       * @param searchSpace The nodes and open set of the current search.
        */
-      void evaluateAdjacentNodes(const TileState& entityState, const geometry::Size& entitySize, const std::shared_ptr<AStarNode>& evaluatedNode, const geometry::Point2D& destinationTile, const EntityGrid& entityGrid, const RoyFloydWarshallMatrices *const rfwMatrices, std::vector<std::shared_ptr<AStarNode>>& openSet, Grid<int>& discovered) const;
+      void evaluateAdjacentNodes(const SearchGrid& searchGrid, const TileState& entityState, const geometry::Size& entitySize, const geometry::Point2D& evaluatedPoint, const geometry::Point2D& destinationTile, AStarSearchSpace& searchSpace) const;
 };
 
 #endif
@@ -175,11 +175,11 @@ void PlayerCharacter::step(long timePassed)
    Actor::step(timePassed);
 }
 
-void PlayerCharacter::draw() const
+void PlayerCharacter::draw(SpriteBatch& batch) const
 {
    if(m_active)
    {
-      Actor::draw();
+      Actor::draw(batch);
    }
 }
 
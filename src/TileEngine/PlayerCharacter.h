@@ -87,8 +87,10 @@ class PlayerCharacter final : public Actor, public messaging::Listener<RosterUpd
 
       /**
        * Draws the player character at the playerLocation coordinates.
+       *
+       * @param batch The sprite batch to draw the player character's sprite with.
        */
-      void draw() const override;
+      void draw(SpriteBatch& batch) const override;
 
       /**
        * Handle an update to the character roster by keeping the
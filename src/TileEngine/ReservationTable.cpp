@@ -0,0 +1,91 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "ReservationTable.h"
+#include "Rectangle.h"
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_ENTITY_GRID
+
+const long ReservationTable::SLOT_DURATION = 50;
+
+std::uint64_t ReservationTable::getKey(int x, int y, long slot)
+{
+   return (static_cast<std::uint64_t>(slot) << 32) |
+      (static_cast<std::uint64_t>(y & 0xFFFF) << 16) |
+      static_cast<std::uint64_t>(x & 0xFFFF);
+}
+
+bool ReservationTable::isAvailable(const geometry::Rectangle& area, long startTime, long endTime, const void* entity) const
+{
+   if(m_reservations.empty())
+   {
+      return true;
+   }
+
+   for(long slot = startTime / SLOT_DURATION; slot <= (endTime - 1) / SLOT_DURATION; ++slot)
+   {
+      for(int y = area.top; y <= area.bottom; ++y)
+      {
+         for(int x = area.left; x <= area.right; ++x)
+         {
+            const auto reservation = m_reservations.find(getKey(x, y, slot));
+            if(reservation != m_reservations.end() && reservation->second != entity)
+            {
+               return false;
+            }
+         }
+      }
+   }
+
+   return true;
+}
+
+void ReservationTable::reserve(const geometry::Rectangle& area, long startTime, long endTime, const void* entity)
+{
+   std::vector<std::uint64_t>& entityReservations = m_entityReservations[entity];
+   for(long slot = startTime / SLOT_DURATION; slot <= (endTime - 1) / SLOT_DURATION; ++slot)
+   {
+      for(int y = area.top; y <= area.bottom; ++y)
+      {
+         for(int x = area.left; x <= area.right; ++x)
+         {
+            const std::uint64_t key = getKey(x, y, slot);
+            if(m_reservations.emplace(key, entity).second)
+            {
+               entityReservations.push_back(key);
+            }
+         }
+      }
+   }
+}
+
+bool ReservationTable::hasReservations(const void* entity) const
+{
+   return m_entityReservations.find(entity) != m_entityReservations.end();
+}
+
+void ReservationTable::release(const void* entity)
+{
+   const auto entityReservations = m_entityReservations.find(entity);
+   if(entityReservations == m_entityReservations.end())
+   {
+      return;
+   }
+
+   for(const std::uint64_t key : entityReservations->second)
+   {
+      m_reservations.erase(key);
+   }
+
+   m_entityReservations.erase(entityReservations);
+}
+
+void ReservationTable::clear()
+{
+   m_reservations.clear();
+   m_entityReservations.clear();
+}
@@ -0,0 +1,90 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef RESERVATION_TABLE_H
+#define RESERVATION_TABLE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace geometry
+{
+   struct Rectangle;
+};
+
+/**
+ * A space-time reservation table for cooperative pathfinding (WHCA*).
+ * Entities that plan their movement reserve the tiles they will occupy over their next few steps,
+ * so that other entities can plan around them (or wait for them to pass) instead of
+ * colliding with them and rerouting.
+ *
+ * Time is divided into slots of a fixed duration, and each tile can be reserved by a single entity in each slot.
+ *
+ * @author Noam Chitayat
+ */
+class ReservationTable final
+{
+   /** The duration (in milliseconds) of each time slot. */
+   static const long SLOT_DURATION;
+
+   /** The entity holding each reservation, keyed by tile and time slot. */
+   std::unordered_map<std::uint64_t, const void*> m_reservations;
+
+   /** The keys of the reservations held by each entity, so that they can be released together. */
+   std::unordered_map<const void*, std::vector<std::uint64_t>> m_entityReservations;
+
+   /**
+    * @param x The x-coordinate of the tile.
+    * @param y The y-coordinate of the tile.
+    * @param slot The time slot.
+    *
+    * @return The key of the reservation of the tile in the time slot.
+    */
+   static std::uint64_t getKey(int x, int y, long slot);
+
+   public:
+      /**
+       * @param area The area to check (with edge coordinates in tiles).
+       * @param startTime The start of the period to check (in milliseconds).
+       * @param endTime The end of the period to check (in milliseconds, exclusive).
+       * @param entity The entity that wants to occupy the area.
+       *
+       * @return true iff no other entity has reserved any tile in the area during the period.
+       */
+      bool isAvailable(const geometry::Rectangle& area, long startTime, long endTime, const void* entity) const;
+
+      /**
+       * Reserves the tiles in an area for an entity. Tiles already reserved by another entity are left to that entity.
+       *
+       * @param area The area to reserve (with edge coordinates in tiles).
+       * @param startTime The start of the reservation (in milliseconds).
+       * @param endTime The end of the reservation (in milliseconds, exclusive).
+       * @param entity The entity that will occupy the area.
+       */
+      void reserve(const geometry::Rectangle& area, long startTime, long endTime, const void* entity);
+
+      /**
+       * @param entity An entity.
+       *
+       * @return true iff the entity holds any reservations, which means that its future location is planned.
+       */
+      bool hasReservations(const void* entity) const;
+
+      /**
+       * Releases every reservation held by an entity.
+       *
+       * @param entity The entity whose reservations should be released.
+       */
+      void release(const void* entity);
+
+      /**
+       * Releases every reservation in the table.
+       */
+      void clear();
+};
+
+#endif
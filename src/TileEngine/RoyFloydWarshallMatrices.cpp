@@ -5,15 +5,148 @@
  */
 
 #include "RoyFloydWarshallMatrices.h"
+#include "MappedFile.h"
 #include "Point2D.h"
 #include "TileState.h"
-#include <limits>
+#include "WorkerPool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RFW_USE_SSE2 1
+#else
+#define RFW_USE_SSE2 0
+#endif
 
 #include "DebugUtils.h"
 #define DEBUG_FLAG DEBUG_PATHFINDER
 
-const float RoyFloydWarshallMatrices::ROOT_2 = 1.41421356f;
+const std::uint16_t RoyFloydWarshallMatrices::STRAIGHT_DISTANCE = 29;
+const std::uint16_t RoyFloydWarshallMatrices::DIAGONAL_DISTANCE = 41;
+const std::uint16_t RoyFloydWarshallMatrices::UNREACHABLE = std::numeric_limits<std::uint16_t>::max();
+const std::uint8_t RoyFloydWarshallMatrices::NO_SUCCESSOR = std::numeric_limits<std::uint8_t>::max();
+const unsigned int RoyFloydWarshallMatrices::BLOCK_SIZE = 64;
+const std::string RoyFloydWarshallMatrices::CACHE_PATH = "data/cache/";
+const std::string RoyFloydWarshallMatrices::CACHE_EXTENSION = ".rfw";
+const char RoyFloydWarshallMatrices::CACHE_MAGIC[4] = {'E', 'R', 'F', 'W'};
+const std::uint32_t RoyFloydWarshallMatrices::CACHE_VERSION = 1;
+const std::uint64_t RoyFloydWarshallMatrices::MAX_CACHE_SIZE = 64 * 1024 * 1024;
+
+namespace
+{
+   /**
+    * The header at the start of every cache file.
+    * The distance matrix immediately follows the header,
+    * and the successor matrix follows the distance matrix.
+    */
+   struct CacheHeader
+   {
+      char magic[4];
+      std::uint32_t version;
+      std::uint64_t collisionHash;
+      std::uint32_t width;
+      std::uint32_t numTiles;
+   };
+
+   /** The FNV-1a 64-bit offset basis. */
+   const std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+   /** The FNV-1a 64-bit prime. */
+   const std::uint64_t FNV_PRIME = 1099511628211ULL;
+
+   /**
+    * Mixes a value into an FNV-1a hash, one byte at a time.
+    *
+    * @param hash The hash to update.
+    * @param value The value to mix into the hash.
+    */
+   void hashValue(std::uint64_t& hash, std::uint32_t value)
+   {
+      for(int i = 0; i < 4; ++i)
+      {
+         hash ^= (value >> (i * 8)) & 0xFF;
+         hash *= FNV_PRIME;
+      }
+   }
+
+   /**
+    * Runs a set of independent tasks on the calling thread and the shared worker pool,
+    * and blocks until they have all completed or the calculation was canceled.
+    *
+    * @param numTasks The number of tasks to run.
+    * @param cancelCalculation An atomic flag used to determine if the calculation was canceled in flight.
+    * @param task The function to run for each task index.
+    */
+   template<typename Task> void runInParallel(unsigned int numTasks, std::atomic<bool>& cancelCalculation, const Task& task)
+   {
+      std::atomic<unsigned int> nextTask(0);
+      const auto work = [&]()
+      {
+         for(unsigned int taskIndex = nextTask++; taskIndex < numTasks && !cancelCalculation; taskIndex = nextTask++)
+         {
+            task(taskIndex);
+         }
+      };
+
+      // The helpers are queued behind other jobs in the pool (possibly behind this one), so this
+      // thread can't wait for them all to start. Instead, once it runs out of tasks, it closes the
+      // helpers off and only waits for the ones already running. Helpers that start later do nothing.
+      struct Helpers
+      {
+         std::mutex mutex;
+         std::condition_variable finished;
+         unsigned int running = 0;
+         bool closed = false;
+      };
+
+      const auto helpers = std::make_shared<Helpers>();
+
+      WorkerPool& workerPool = WorkerPool::getSharedPool();
+      const unsigned int numHelpers = std::min(workerPool.getNumWorkers(), numTasks) - (numTasks > 0 ? 1 : 0);
+      for(unsigned int i = 0; i < numHelpers; ++i)
+      {
+         workerPool.submit([helpers, &work](unsigned int)
+         {
+            {
+               std::lock_guard<std::mutex> lock(helpers->mutex);
+               if(helpers->closed) return;
+               ++helpers->running;
+            }
+
+            work();
+
+            std::lock_guard<std::mutex> lock(helpers->mutex);
+            if(--helpers->running == 0)
+            {
+               helpers->finished.notify_all();
+            }
+         });
+      }
+
+      work();
+
+      std::unique_lock<std::mutex> lock(helpers->mutex);
+      helpers->closed = true;
+      helpers->finished.wait(lock, [&helpers]() { return helpers->running == 0; });
+   }
+};
 
 geometry::Point2D RoyFloydWarshallMatrices::tileNumToCoords(int tileNum, int width)
 {
@@ -26,6 +159,12 @@ int RoyFloydWarshallMatrices::coordsToTileNum(const geometry::Point2D& tileLocat
    return (tileLocation.y * width + tileLocation.x);
 }
 
+std::uint8_t RoyFloydWarshallMatrices::getDirectionCode(const geometry::Point2D& offset)
+{
+   // Directions are numbered in row-major order over the 3x3 neighbourhood of a tile.
+   return static_cast<std::uint8_t>((offset.y + 1) * 3 + (offset.x + 1));
+}
+
 RoyFloydWarshallMatrices::RoyFloydWarshallMatrices() = default;
 
 std::tuple<bool, geometry::Point2D> RoyFloydWarshallMatrices::getSuccessor(geometry::Point2D src, geometry::Point2D dst) const
@@ -33,11 +172,11 @@ std::tuple<bool, geometry::Point2D> RoyFloydWarshallMatrices::getSuccessor(geome
    int srcTileNum = RoyFloydWarshallMatrices::coordsToTileNum(src, m_width);
    int dstTileNum = RoyFloydWarshallMatrices::coordsToTileNum(dst, m_width);
 
-   int successorTileNum = m_successorMatrix(srcTileNum, dstTileNum);
+   std::uint8_t successorCode = getSuccessorEntry(srcTileNum, dstTileNum);
 
-   if(successorTileNum >= 0)
+   if(successorCode != NO_SUCCESSOR)
    {
-      return std::make_tuple(true, tileNumToCoords(successorTileNum, m_width));
+      return std::make_tuple(true, geometry::Point2D(src.x + successorCode % 3 - 1, src.y + successorCode / 3 - 1));
    }
 
    return std::make_tuple(false, geometry::Point2D::ORIGIN);
@@ -47,100 +186,639 @@ float RoyFloydWarshallMatrices::getDistance(geometry::Point2D src, geometry::Poi
 {
    int srcTileNum = RoyFloydWarshallMatrices::coordsToTileNum(src, m_width);
    int dstTileNum = RoyFloydWarshallMatrices::coordsToTileNum(dst, m_width);
-   return m_distanceMatrix(srcTileNum, dstTileNum);
+
+   std::uint16_t distance = getDistanceEntry(srcTileNum, dstTileNum);
+   if(distance == UNREACHABLE)
+   {
+      return std::numeric_limits<float>::infinity();
+   }
+
+   return static_cast<float>(distance) / STRAIGHT_DISTANCE;
 }
 
-RoyFloydWarshallMatrices RoyFloydWarshallMatrices::calculateRoyFloydWarshallMatrices(const Grid<TileState>* grid, const geometry::Rectangle* gridBounds, std::atomic<bool>& cancelCalculation)
+std::uint16_t RoyFloydWarshallMatrices::getDistanceEntry(int srcTileNum, int dstTileNum) const
 {
-   RoyFloydWarshallMatrices matrices;
+   return m_cachedDistances ?
+      m_cachedDistances[srcTileNum * m_numTiles + dstTileNum] :
+      m_distanceMatrix(dstTileNum, srcTileNum);
+}
+
+std::uint8_t RoyFloydWarshallMatrices::getSuccessorEntry(int srcTileNum, int dstTileNum) const
+{
+   return m_cachedSuccessors ?
+      m_cachedSuccessors[srcTileNum * m_numTiles + dstTileNum] :
+      m_successorMatrix(dstTileNum, srcTileNum);
+}
+
+std::uint64_t RoyFloydWarshallMatrices::hashCollisionGrid(const Grid<TileState>& grid, const geometry::Rectangle& gridBounds, int movementTileSize)
+{
+   std::uint64_t hash = FNV_OFFSET_BASIS;
+   hashValue(hash, CACHE_VERSION);
+   hashValue(hash, gridBounds.getWidth());
+   hashValue(hash, gridBounds.getHeight());
+   hashValue(hash, movementTileSize);
+
+   // Only static obstacles affect the matrices, so pack them into 32-bit words before hashing.
+   std::uint32_t obstacleBits = 0;
+   unsigned int numBits = 0;
+   for(int y = 0; y < static_cast<int>(gridBounds.getHeight()); ++y)
+   {
+      for(int x = 0; x < static_cast<int>(gridBounds.getWidth()); ++x)
+      {
+         if(grid(x, y).entityType == TileState::EntityType::OBSTACLE)
+         {
+            obstacleBits |= 1u << numBits;
+         }
+
+         if(++numBits == 32)
+         {
+            hashValue(hash, obstacleBits);
+            obstacleBits = 0;
+            numBits = 0;
+         }
+      }
+   }
+
+   hashValue(hash, obstacleBits);
+   return hash;
+}
 
-   if(!grid || !gridBounds)
+std::string RoyFloydWarshallMatrices::getCachePath(std::uint64_t collisionHash)
+{
+   std::ostringstream path;
+   path << CACHE_PATH << std::hex << std::setw(16) << std::setfill('0') << collisionHash << CACHE_EXTENSION;
+   return path.str();
+}
+
+bool RoyFloydWarshallMatrices::loadFromCache(const std::string& path, std::uint64_t collisionHash)
+{
+   auto cacheFile = std::make_shared<const MappedFile>(path);
+   if(!cacheFile->isValid())
    {
-      T_T("Call made to calculateRoyFloydWarshallMatrices with null grid or null bounds.");
+      return false;
    }
 
-   auto& distanceMatrix = matrices.m_distanceMatrix;
-   auto& successorMatrix = matrices.m_successorMatrix;
+   const std::size_t matrixEntries = static_cast<std::size_t>(m_numTiles) * m_numTiles;
+   const std::size_t expectedSize = sizeof(CacheHeader) + matrixEntries * (sizeof(std::uint16_t) + sizeof(std::uint8_t));
 
-   matrices.m_width = gridBounds->getWidth();
-   const unsigned int NUM_TILES = gridBounds->getArea();
-   const auto matrixSize = geometry::Size(NUM_TILES, NUM_TILES);
+   CacheHeader header;
+   if(cacheFile->getSize() != expectedSize)
+   {
+      DEBUG("RFW cache file %s has an unexpected size. Ignoring it.", path.c_str());
+      return false;
+   }
+
+   std::memcpy(&header, cacheFile->getData(), sizeof(CacheHeader));
+   if(std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header.version != CACHE_VERSION ||
+      header.collisionHash != collisionHash ||
+      header.width != static_cast<std::uint32_t>(m_width) ||
+      header.numTiles != m_numTiles)
+   {
+      DEBUG("RFW cache file %s does not match the collision map. Ignoring it.", path.c_str());
+      return false;
+   }
+
+   const char* matrixData = cacheFile->getData() + sizeof(CacheHeader);
+   m_cachedDistances = reinterpret_cast<const std::uint16_t*>(matrixData);
+   m_cachedSuccessors = reinterpret_cast<const std::uint8_t*>(matrixData + matrixEntries * sizeof(std::uint16_t));
+   m_cacheFile = cacheFile;
+
+   // Mark the file as recently used, so that it outlives the files of maps that are no longer visited.
+   utime(path.c_str(), nullptr);
+   return true;
+}
+
+void RoyFloydWarshallMatrices::saveToCache(const std::string& path, std::uint64_t collisionHash) const
+{
+   CacheHeader header;
+   std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+   header.version = CACHE_VERSION;
+   header.collisionHash = collisionHash;
+   header.width = m_width;
+   header.numTiles = m_numTiles;
+
+   const std::size_t matrixEntries = static_cast<std::size_t>(m_numTiles) * m_numTiles;
+
+   // Write to a temporary file first, so that a partially written
+   // cache file is never mapped by another calculation.
+   const std::string temporaryPath = path + ".tmp";
+
+   {
+      std::ofstream output(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+      output.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+      output.write(reinterpret_cast<const char*>(&m_distanceMatrix(0, 0)), matrixEntries * sizeof(std::uint16_t));
+      output.write(reinterpret_cast<const char*>(&m_successorMatrix(0, 0)), matrixEntries * sizeof(std::uint8_t));
+
+      if(!output)
+      {
+         DEBUG("Failed to write RFW cache file %s.", temporaryPath.c_str());
+         output.close();
+         std::remove(temporaryPath.c_str());
+         return;
+      }
+   }
+
+   if(std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+   {
+      std::remove(temporaryPath.c_str());
+      return;
+   }
+
+   evictFromCache(path);
+}
+
+void RoyFloydWarshallMatrices::evictFromCache(const std::string& keptPath)
+{
+   /**
+    * A cache file, along with when it was last used.
+    */
+   struct CacheFile
+   {
+      std::string path;
+      std::uint64_t size;
+      time_t lastUsed;
+   };
+
+   DIR* cacheDirectory = opendir(CACHE_PATH.c_str());
+   if(cacheDirectory == nullptr)
+   {
+      return;
+   }
+
+   std::vector<CacheFile> cacheFiles;
+   std::uint64_t cacheSize = 0;
+   while(const struct dirent* entry = readdir(cacheDirectory))
+   {
+      const std::string filename(entry->d_name);
+      if(filename.length() <= CACHE_EXTENSION.length() ||
+         filename.compare(filename.length() - CACHE_EXTENSION.length(), CACHE_EXTENSION.length(), CACHE_EXTENSION) != 0)
+      {
+         continue;
+      }
+
+      const std::string path = CACHE_PATH + filename;
+      struct stat fileStatus;
+      if(stat(path.c_str(), &fileStatus) != 0)
+      {
+         continue;
+      }
+
+      cacheFiles.push_back({ path, static_cast<std::uint64_t>(fileStatus.st_size), fileStatus.st_mtime });
+      cacheSize += fileStatus.st_size;
+   }
+
+   closedir(cacheDirectory);
+
+   if(cacheSize <= MAX_CACHE_SIZE)
+   {
+      return;
+   }
+
+   std::sort(cacheFiles.begin(), cacheFiles.end(), [](const CacheFile& lhs, const CacheFile& rhs)
+   {
+      return lhs.lastUsed < rhs.lastUsed;
+   });
+
+   for(const auto& cacheFile : cacheFiles)
+   {
+      if(cacheSize <= MAX_CACHE_SIZE)
+      {
+         break;
+      }
+
+      if(cacheFile.path != keptPath && std::remove(cacheFile.path.c_str()) == 0)
+      {
+         DEBUG("Evicted RFW cache file %s.", cacheFile.path.c_str());
+         cacheSize -= cacheFile.size;
+      }
+   }
+}
+
+void RoyFloydWarshallMatrices::initializeAdjacencies(const Grid<TileState>& grid)
+{
+   const int height = m_numTiles / m_width;
+
+   for(unsigned int a = 0; a < m_numTiles; ++a)
+   {
+      std::uint16_t* distanceRow = &m_distanceMatrix(0, a);
+      std::uint8_t* successorRow = &m_successorMatrix(0, a);
+
+      std::fill(distanceRow, distanceRow + m_numTiles, UNREACHABLE);
+      std::fill(successorRow, successorRow + m_numTiles, NO_SUCCESSOR);
+      distanceRow[a] = 0;
+
+      const geometry::Point2D aTile = tileNumToCoords(a, m_width);
+      if(grid(aTile.x, aTile.y).entityType == TileState::EntityType::OBSTACLE)
+      {
+         continue;
+      }
+
+      for(int y = std::max(aTile.y - 1, 0); y <= std::min(aTile.y + 1, height - 1); ++y)
+      {
+         for(int x = std::max(aTile.x - 1, 0); x <= std::min(aTile.x + 1, m_width - 1); ++x)
+         {
+            const geometry::Point2D bTile(x, y);
+            if(bTile == aTile || grid(x, y).entityType == TileState::EntityType::OBSTACLE)
+            {
+               continue;
+            }
+
+            const bool diagonallyAdjacent = aTile.x != bTile.x && aTile.y != bTile.y;
+            if(diagonallyAdjacent)
+            {
+               bool diagonalTraversalBlocked =
+                  grid(aTile.x, bTile.y).entityType == TileState::EntityType::OBSTACLE ||
+                  grid(bTile.x, aTile.y).entityType == TileState::EntityType::OBSTACLE;
+
+               if(diagonalTraversalBlocked)
+               {
+                  continue;
+               }
+            }
+
+            const int b = coordsToTileNum(bTile, m_width);
+            successorRow[b] = getDirectionCode(geometry::Point2D(bTile.x - aTile.x, bTile.y - aTile.y));
+            distanceRow[b] = diagonallyAdjacent ? DIAGONAL_DISTANCE : STRAIGHT_DISTANCE;
+         }
+      }
+   }
+}
+
+void RoyFloydWarshallMatrices::relaxRow(std::uint16_t* distanceRow, std::uint8_t* successorRow, const std::uint16_t* pivotRow, std::uint16_t pivotDistance, std::uint8_t pivotSuccessor, unsigned int begin, unsigned int end)
+{
+   unsigned int b = begin;
+
+#if RFW_USE_SSE2
+   // SSE2 only has signed 16-bit comparisons, so distances are biased into
+   // the signed range before comparing them.
+   const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+   const __m128i pivotDistances = _mm_set1_epi16(static_cast<short>(pivotDistance));
+   const __m128i pivotSuccessors = _mm_set1_epi8(static_cast<char>(pivotSuccessor));
 
-   distanceMatrix.resize(matrixSize);
-   successorMatrix.resize(matrixSize);
+   for(; b + 8 <= end; b += 8)
+   {
+      __m128i* distances = reinterpret_cast<__m128i*>(distanceRow + b);
+      __m128i* successors = reinterpret_cast<__m128i*>(successorRow + b);
+
+      const __m128i currentDistances = _mm_loadu_si128(distances);
+      // Saturation ensures that paths through unreachable tiles remain unreachable.
+      const __m128i throughDistances = _mm_adds_epu16(pivotDistances, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pivotRow + b)));
+      const __m128i improved = _mm_cmplt_epi16(_mm_xor_si128(throughDistances, bias), _mm_xor_si128(currentDistances, bias));
+      const __m128i improvedSuccessors = _mm_packs_epi16(improved, improved);
+      const __m128i currentSuccessors = _mm_loadl_epi64(successors);
 
-   geometry::Point2D aTile;
-   geometry::Point2D bTile;
+      _mm_storeu_si128(distances, _mm_or_si128(_mm_and_si128(improved, throughDistances), _mm_andnot_si128(improved, currentDistances)));
+      _mm_storel_epi64(successors, _mm_or_si128(_mm_and_si128(improvedSuccessors, pivotSuccessors), _mm_andnot_si128(improvedSuccessors, currentSuccessors)));
+   }
+#endif
+
+   for(; b < end; ++b)
+   {
+      const std::uint32_t distance = static_cast<std::uint32_t>(pivotDistance) + pivotRow[b];
+      const bool improved = distance < distanceRow[b];
+      distanceRow[b] = improved ? static_cast<std::uint16_t>(distance) : distanceRow[b];
+      successorRow[b] = improved ? pivotSuccessor : successorRow[b];
+   }
+}
+
+void RoyFloydWarshallMatrices::relaxBlock(unsigned int rowBlock, unsigned int columnBlock, unsigned int pivotBlock)
+{
+   const unsigned int rowBegin = rowBlock * BLOCK_SIZE;
+   const unsigned int rowEnd = std::min(rowBegin + BLOCK_SIZE, m_numTiles);
+   const unsigned int columnBegin = columnBlock * BLOCK_SIZE;
+   const unsigned int columnEnd = std::min(columnBegin + BLOCK_SIZE, m_numTiles);
+   const unsigned int pivotBegin = pivotBlock * BLOCK_SIZE;
+   const unsigned int pivotEnd = std::min(pivotBegin + BLOCK_SIZE, m_numTiles);
 
-   for(unsigned int a = 0; a < NUM_TILES; ++a)
+   for(unsigned int i = pivotBegin; i < pivotEnd; ++i)
    {
-      aTile = tileNumToCoords(a, matrices.m_width);
-      for(unsigned int b = 0; b < NUM_TILES && !cancelCalculation; ++b)
+      const std::uint16_t* pivotRow = &m_distanceMatrix(0, i);
+      for(unsigned int a = rowBegin; a < rowEnd; ++a)
       {
-         if(a == b)
+         const std::uint16_t pivotDistance = m_distanceMatrix(i, a);
+         if(pivotDistance == UNREACHABLE)
          {
-            distanceMatrix(a, b) = 0;
-            successorMatrix(a, b) = -1;
+            // The pivot can't be reached from this source, so no path can improve through it.
+            continue;
+         }
+
+         relaxRow(&m_distanceMatrix(0, a), &m_successorMatrix(0, a), pivotRow, pivotDistance, m_successorMatrix(i, a), columnBegin, columnEnd);
+      }
+   }
+}
+
+void RoyFloydWarshallMatrices::detachFromCache()
+{
+   if(!m_cachedDistances)
+   {
+      return;
+   }
+
+   const auto matrixSize = geometry::Size(m_numTiles, m_numTiles);
+   const std::size_t matrixEntries = static_cast<std::size_t>(m_numTiles) * m_numTiles;
+
+   // The cache files use the same layout as the in-memory matrices.
+   m_distanceMatrix.resize(matrixSize);
+   m_successorMatrix.resize(matrixSize);
+   std::memcpy(&m_distanceMatrix(0, 0), m_cachedDistances, matrixEntries * sizeof(std::uint16_t));
+   std::memcpy(&m_successorMatrix(0, 0), m_cachedSuccessors, matrixEntries * sizeof(std::uint8_t));
+
+   m_cachedDistances = nullptr;
+   m_cachedSuccessors = nullptr;
+   m_cacheFile.reset();
+}
+
+bool RoyFloydWarshallMatrices::isStepOpen(const Grid<TileState>& grid, const geometry::Point2D& tile, std::uint8_t successorCode) const
+{
+   const geometry::Point2D nextTile(tile.x + successorCode % 3 - 1, tile.y + successorCode / 3 - 1);
+   if(grid(nextTile.x, nextTile.y).entityType == TileState::EntityType::OBSTACLE)
+   {
+      return false;
+   }
+
+   const bool diagonalStep = tile.x != nextTile.x && tile.y != nextTile.y;
+   return !diagonalStep ||
+      (grid(tile.x, nextTile.y).entityType != TileState::EntityType::OBSTACLE &&
+       grid(nextTile.x, tile.y).entityType != TileState::EntityType::OBSTACLE);
+}
+
+void RoyFloydWarshallMatrices::repairDestination(const Grid<TileState>& grid, unsigned int dstTileNum)
+{
+   const int height = m_numTiles / m_width;
+
+   enum class PathState : std::uint8_t { UNKNOWN, INTACT, BROKEN };
+
+   // Follow each source's successors toward the destination to find out if its path
+   // takes a removed step. Every tile visited along the way shares the same outcome.
+   std::vector<PathState> pathStates(m_numTiles, PathState::UNKNOWN);
+   std::vector<unsigned int> chain;
+   std::vector<unsigned int> brokenTiles;
+   for(unsigned int a = 0; a < m_numTiles; ++a)
+   {
+      unsigned int b = a;
+      PathState state = pathStates[b];
+      while(state == PathState::UNKNOWN)
+      {
+         chain.push_back(b);
+
+         const std::uint8_t successorCode = m_successorMatrix(dstTileNum, b);
+         const geometry::Point2D bTile = tileNumToCoords(b, m_width);
+         if(b == dstTileNum || successorCode == NO_SUCCESSOR)
+         {
+            state = PathState::INTACT;
+         }
+         else if(!isStepOpen(grid, bTile, successorCode))
+         {
+            state = PathState::BROKEN;
          }
          else
          {
-            bTile = tileNumToCoords(b, matrices.m_width);
+            b = coordsToTileNum(geometry::Point2D(bTile.x + successorCode % 3 - 1, bTile.y + successorCode / 3 - 1), m_width);
+            state = pathStates[b];
+         }
+      }
 
-            bool xAdjacent = aTile.x - 1 <= bTile.x && bTile.x <= aTile.x + 1;
-            bool yAdjacent = aTile.y - 1 <= bTile.y && bTile.y <= aTile.y + 1;
+      for(const unsigned int tileNum : chain)
+      {
+         pathStates[tileNum] = state;
+         if(state == PathState::BROKEN)
+         {
+            brokenTiles.push_back(tileNum);
+         }
+      }
 
-            bool adjacent = xAdjacent && yAdjacent;
-            bool diagonallyAdjacent = aTile.x != bTile.x && aTile.y != bTile.y;
-            bool aTileIsObstacle = (*grid)(aTile.x, aTile.y).entityType == TileState::EntityType::OBSTACLE;
-            bool bTileIsObstacle = (*grid)(bTile.x, bTile.y).entityType == TileState::EntityType::OBSTACLE;
+      chain.clear();
+   }
 
-            distanceMatrix(a, b) = std::numeric_limits<float>::infinity();
-            successorMatrix(a, b) = -1;
+   typedef std::pair<std::uint32_t, unsigned int> SearchEntry;
+   std::priority_queue<SearchEntry, std::vector<SearchEntry>, std::greater<SearchEntry>> openSet;
 
-            if(adjacent && !aTileIsObstacle && !bTileIsObstacle)
+   // Calls the given function for each open step from a tile to one of its neighbours.
+   const auto forEachStep = [&](unsigned int a, const std::function<void(unsigned int, std::uint8_t, std::uint16_t)>& visit)
+   {
+      const geometry::Point2D aTile = tileNumToCoords(a, m_width);
+      for(int y = std::max(aTile.y - 1, 0); y <= std::min(aTile.y + 1, height - 1); ++y)
+      {
+         for(int x = std::max(aTile.x - 1, 0); x <= std::min(aTile.x + 1, m_width - 1); ++x)
+         {
+            const geometry::Point2D bTile(x, y);
+            const std::uint8_t successorCode = getDirectionCode(geometry::Point2D(bTile.x - aTile.x, bTile.y - aTile.y));
+            if(bTile == aTile || !isStepOpen(grid, aTile, successorCode))
             {
-               if(diagonallyAdjacent)
-               {
-                  bool diagonalTraversalBlocked =
-                  (*grid)(aTile.x, bTile.y).entityType == TileState::EntityType::OBSTACLE ||
-                  (*grid)(bTile.x, aTile.y).entityType == TileState::EntityType::OBSTACLE;
-
-                  if(!diagonalTraversalBlocked)
-                  {
-                     successorMatrix(a, b) = b;
-                     distanceMatrix(a, b) = ROOT_2;
-                  }
-               }
-               else
-               {
-                  successorMatrix(a, b) = b;
-                  distanceMatrix(a, b) = 1;
-               }
+               continue;
             }
+
+            const bool diagonallyAdjacent = aTile.x != bTile.x && aTile.y != bTile.y;
+            visit(coordsToTileNum(bTile, m_width), successorCode, diagonallyAdjacent ? DIAGONAL_DISTANCE : STRAIGHT_DISTANCE);
          }
       }
+   };
+
+   // Broken paths can now only be as short as the best step onto an intact path.
+   for(const unsigned int a : brokenTiles)
+   {
+      std::uint16_t& distance = m_distanceMatrix(dstTileNum, a);
+      std::uint8_t& successor = m_successorMatrix(dstTileNum, a);
+      distance = UNREACHABLE;
+      successor = NO_SUCCESSOR;
+
+      const geometry::Point2D aTile = tileNumToCoords(a, m_width);
+      if(grid(aTile.x, aTile.y).entityType == TileState::EntityType::OBSTACLE)
+      {
+         continue;
+      }
+
+      forEachStep(a, [&](unsigned int b, std::uint8_t successorCode, std::uint16_t stepDistance)
+      {
+         const std::uint16_t intactDistance = m_distanceMatrix(dstTileNum, b);
+         const std::uint32_t throughDistance = static_cast<std::uint32_t>(intactDistance) + stepDistance;
+         if(pathStates[b] == PathState::INTACT && intactDistance != UNREACHABLE && throughDistance < distance)
+         {
+            distance = static_cast<std::uint16_t>(throughDistance);
+            successor = successorCode;
+         }
+      });
+
+      if(distance != UNREACHABLE)
+      {
+         openSet.emplace(distance, a);
+      }
    }
 
-   for(unsigned int i = 0; i < NUM_TILES; ++i)
+   // Spread the new paths through the rest of the broken tiles. Steps are symmetric,
+   // so the tile that a broken tile is reached from becomes its successor.
+   while(!openSet.empty())
+   {
+      const SearchEntry entry = openSet.top();
+      openSet.pop();
+
+      const unsigned int b = entry.second;
+      if(entry.first > m_distanceMatrix(dstTileNum, b))
+      {
+         // Stale entry; this tile was already reached with a lower cost.
+         continue;
+      }
+
+      forEachStep(b, [&](unsigned int a, std::uint8_t, std::uint16_t stepDistance)
+      {
+         const std::uint32_t distance = entry.first + stepDistance;
+         const geometry::Point2D aTile = tileNumToCoords(a, m_width);
+         const geometry::Point2D bTile = tileNumToCoords(b, m_width);
+         if(pathStates[a] == PathState::BROKEN && distance < m_distanceMatrix(dstTileNum, a))
+         {
+            m_distanceMatrix(dstTileNum, a) = static_cast<std::uint16_t>(distance);
+            m_successorMatrix(dstTileNum, a) = getDirectionCode(geometry::Point2D(bTile.x - aTile.x, bTile.y - aTile.y));
+            openSet.emplace(distance, a);
+         }
+      });
+   }
+}
+
+void RoyFloydWarshallMatrices::addObstacles(const Grid<TileState>& grid, const geometry::Rectangle& area)
+{
+   detachFromCache();
+
+   const int height = m_numTiles / m_width;
+   const int top = std::max(area.top, 0);
+   const int left = std::max(area.left, 0);
+   const int bottom = std::min(area.bottom, height - 1);
+   const int right = std::min(area.right, m_width - 1);
+
+   // Every removed step either starts, ends or cuts a corner on a new obstacle,
+   // so it must start within one tile of the area. Any destination whose
+   // shortest paths take one of those steps needs to be recalculated.
+   std::vector<char> affectedDestinations(m_numTiles, 0);
+   for(int y = std::max(top - 1, 0); y <= std::min(bottom + 1, height - 1); ++y)
    {
-      for(unsigned int a = 0; a < NUM_TILES; ++a)
+      for(int x = std::max(left - 1, 0); x <= std::min(right + 1, m_width - 1); ++x)
       {
-         for(unsigned int b = 0; b < NUM_TILES && !cancelCalculation; ++b)
+         const geometry::Point2D tile(x, y);
+         if(grid(x, y).entityType == TileState::EntityType::OBSTACLE)
+         {
+            // Obstacles have no paths of their own; their rows are cleared below.
+            continue;
+         }
+
+         const int a = coordsToTileNum(tile, m_width);
+         for(unsigned int b = 0; b < m_numTiles; ++b)
          {
-            float distance = distanceMatrix(a, i) + distanceMatrix(i, b);
-            if(distance < distanceMatrix(a, b))
+            const std::uint8_t successorCode = m_successorMatrix(b, a);
+            if(!affectedDestinations[b] && successorCode != NO_SUCCESSOR && !isStepOpen(grid, tile, successorCode))
             {
-               distanceMatrix(a, b) = distance;
-               successorMatrix(a, b) = successorMatrix(a, i);
+               affectedDestinations[b] = 1;
             }
          }
       }
    }
 
+   for(int y = top; y <= bottom; ++y)
+   {
+      for(int x = left; x <= right; ++x)
+      {
+         const int a = coordsToTileNum(geometry::Point2D(x, y), m_width);
+         std::uint16_t* distanceRow = &m_distanceMatrix(0, a);
+         std::uint8_t* successorRow = &m_successorMatrix(0, a);
+
+         std::fill(distanceRow, distanceRow + m_numTiles, UNREACHABLE);
+         std::fill(successorRow, successorRow + m_numTiles, NO_SUCCESSOR);
+         distanceRow[a] = 0;
+      }
+   }
+
+   std::vector<unsigned int> destinations;
+   for(unsigned int b = 0; b < m_numTiles; ++b)
+   {
+      if(affectedDestinations[b])
+      {
+         destinations.push_back(b);
+      }
+   }
+
+   // Each repair only writes the entries for its own destination, so they can run concurrently.
+   std::atomic<bool> cancelRepair(false);
+   runInParallel(destinations.size(), cancelRepair, [this, &grid, &destinations](unsigned int task)
+   {
+      repairDestination(grid, destinations[task]);
+   });
+
+   DEBUG("Repaired RFW matrices: recalculated paths to %d of %d tiles.", static_cast<int>(destinations.size()), m_numTiles);
+}
+
+RoyFloydWarshallMatrices RoyFloydWarshallMatrices::calculateRoyFloydWarshallMatrices(const std::shared_ptr<const Grid<TileState>>& grid, const geometry::Rectangle& gridBounds, int movementTileSize, std::atomic<bool>& cancelCalculation)
+{
+   RoyFloydWarshallMatrices matrices;
+
+   if(!grid)
+   {
+      T_T("Call made to calculateRoyFloydWarshallMatrices with null grid.");
+   }
+
+   matrices.m_width = gridBounds.getWidth();
+   matrices.m_numTiles = gridBounds.getArea();
+
+   const std::uint64_t collisionHash = hashCollisionGrid(*grid, gridBounds, movementTileSize);
+   const std::string cachePath = getCachePath(collisionHash);
+   if(matrices.loadFromCache(cachePath, collisionHash))
+   {
+      DEBUG("Loaded RFW matrices from %s.", cachePath.c_str());
+      return matrices;
+   }
+
+   const unsigned int NUM_TILES = matrices.m_numTiles;
+   const auto matrixSize = geometry::Size(NUM_TILES, NUM_TILES);
+
+   matrices.m_distanceMatrix.resize(matrixSize);
+   matrices.m_successorMatrix.resize(matrixSize);
+
+   matrices.initializeAdjacencies(*grid);
+
+   // Blocked Roy-Floyd-Warshall: for each block of pivot tiles, first relax the block
+   // on the diagonal (which depends only on itself), then the blocks sharing its row
+   // or column (which depend only on the diagonal block), and finally every remaining
+   // block (which depends only on the row and column blocks). Blocks within the last
+   // two phases are independent of each other and are relaxed concurrently.
+   const unsigned int NUM_BLOCKS = (NUM_TILES + BLOCK_SIZE - 1) / BLOCK_SIZE;
+   const unsigned int NUM_OTHER_BLOCKS = NUM_BLOCKS - 1;
+
+   for(unsigned int k = 0; k < NUM_BLOCKS && !cancelCalculation; ++k)
+   {
+      matrices.relaxBlock(k, k, k);
+
+      runInParallel(2 * NUM_OTHER_BLOCKS, cancelCalculation, [&matrices, k, NUM_OTHER_BLOCKS](unsigned int task)
+      {
+         unsigned int otherBlock = task % NUM_OTHER_BLOCKS;
+         otherBlock += otherBlock >= k ? 1 : 0;
+
+         if(task < NUM_OTHER_BLOCKS)
+         {
+            matrices.relaxBlock(k, otherBlock, k);
+         }
+         else
+         {
+            matrices.relaxBlock(otherBlock, k, k);
+         }
+      });
+
+      runInParallel(NUM_OTHER_BLOCKS * NUM_OTHER_BLOCKS, cancelCalculation, [&matrices, k, NUM_OTHER_BLOCKS](unsigned int task)
+      {
+         unsigned int rowBlock = task / NUM_OTHER_BLOCKS;
+         unsigned int columnBlock = task % NUM_OTHER_BLOCKS;
+         rowBlock += rowBlock >= k ? 1 : 0;
+         columnBlock += columnBlock >= k ? 1 : 0;
+
+         matrices.relaxBlock(rowBlock, columnBlock, k);
+      });
+   }
+
    if(cancelCalculation)
    {
       DEBUG("Interrupted calculation of RFW matrices. Aborting...");
    }
+   else
+   {
+      matrices.saveToCache(cachePath, collisionHash);
+   }
 
    return matrices;
 }
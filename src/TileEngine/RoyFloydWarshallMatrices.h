@@ -7,6 +7,10 @@
 #ifndef RFW_MATRICES_H
 #define RFW_MATRICES_H
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
 #include "CancelableTask.h"
 #include "Grid.h"
 #include "Rectangle.h"
@@ -17,6 +21,7 @@ namespace geometry
 };
 
 struct TileState;
+class MappedFile;
 
 /**
  * Holds the results of running the Roy-Floyd-Warshall
@@ -26,17 +31,199 @@ struct TileState;
  */
 class RoyFloydWarshallMatrices final
 {
-   /** The square root of 2. */
-   static const float ROOT_2;
+   /**
+    * The fixed-point distance of a single orthogonal step.
+    * Together with DIAGONAL_DISTANCE, this slightly underestimates the ratio
+    * of a diagonal step to an orthogonal one, so that distances remain
+    * admissible when used as a heuristic.
+    */
+   static const std::uint16_t STRAIGHT_DISTANCE;
+
+   /** The fixed-point distance of a single diagonal step. */
+   static const std::uint16_t DIAGONAL_DISTANCE;
+
+   /** The fixed-point distance between tiles that have no path between them. */
+   static const std::uint16_t UNREACHABLE;
+
+   /** The successor code used when there is no tile to move to. */
+   static const std::uint8_t NO_SUCCESSOR;
+
+   /** The directory holding the precomputed matrices of previously visited maps. */
+   static const std::string CACHE_PATH;
+
+   /** The file extension of cached matrices. */
+   static const std::string CACHE_EXTENSION;
+
+   /** The identifier at the start of every cache file. */
+   static const char CACHE_MAGIC[4];
+
+   /** The version of the cache file format. Bump this whenever the format or the matrix encoding changes. */
+   static const std::uint32_t CACHE_VERSION;
+
+   /**
+    * The most space (in bytes) that cached matrices may take up on disk. Editing a map or changing its
+    * movement tile size leaves behind files that will never be read again, so the least recently used
+    * files are deleted whenever a new file pushes the cache over this limit.
+    */
+   static const std::uint64_t MAX_CACHE_SIZE;
+
+   /**
+    * The width and height (in matrix entries) of the square blocks that the
+    * matrices are divided into during the calculation. A pivot row, the row being
+    * relaxed and their successors all stay in cache while a block is processed.
+    */
+   static const unsigned int BLOCK_SIZE;
 
    /** The width of the grid. */
    int m_width;
 
-   /** The Roy-Floyd-Warshall distance matrix. This 2D array holds best-path distances between all tiles. */
-   Grid<float> m_distanceMatrix;
+   /** The number of tiles in the grid (and the number of rows and columns in each matrix). */
+   unsigned int m_numTiles;
 
-   /** The Roy-Floyd-Warshall successor matrix. This 2D array holds the best tile to move to, given a source and a destination. */
-   Grid<int> m_successorMatrix;
+   /**
+    * The Roy-Floyd-Warshall distance matrix. This 2D array holds fixed-point best-path distances between all tiles.
+    * Each row holds the distances from one source tile, and is indexed by destination tile.
+    */
+   Grid<std::uint16_t> m_distanceMatrix;
+
+   /**
+    * The Roy-Floyd-Warshall successor matrix. This 2D array holds the direction of the best tile to move to, given a source and a destination.
+    * Each row holds the successors for one source tile, and is indexed by destination tile.
+    */
+   Grid<std::uint8_t> m_successorMatrix;
+
+   /** The memory-mapped cache file holding the matrices, if they were loaded from disk instead of calculated. */
+   std::shared_ptr<const MappedFile> m_cacheFile;
+
+   /** The distance matrix within the mapped cache file (laid out like <code>m_distanceMatrix</code>). */
+   const std::uint16_t* m_cachedDistances = nullptr;
+
+   /** The successor matrix within the mapped cache file (laid out like <code>m_successorMatrix</code>). */
+   const std::uint8_t* m_cachedSuccessors = nullptr;
+
+   /**
+    * @param srcTileNum The matrix index of the source tile.
+    * @param dstTileNum The matrix index of the destination tile.
+    *
+    * @return The fixed-point distance between the two tiles.
+    */
+   std::uint16_t getDistanceEntry(int srcTileNum, int dstTileNum) const;
+
+   /**
+    * @param srcTileNum The matrix index of the source tile.
+    * @param dstTileNum The matrix index of the destination tile.
+    *
+    * @return The successor code for the path between the two tiles.
+    */
+   std::uint8_t getSuccessorEntry(int srcTileNum, int dstTileNum) const;
+
+   /**
+    * Computes a hash of everything that the matrices depend on, so that matrices
+    * cached for one collision map are never used for another.
+    *
+    * @param grid A grid of free spaces and obstacles.
+    * @param gridBounds The rectangle representing the bounds of the grid.
+    * @param movementTileSize The size (in pixels) of each tile in the grid.
+    *
+    * @return A hash of the grid dimensions, tile size and obstacle layout.
+    */
+   static std::uint64_t hashCollisionGrid(const Grid<TileState>& grid, const geometry::Rectangle& gridBounds, int movementTileSize);
+
+   /**
+    * @param collisionHash The hash of the collision grid.
+    *
+    * @return The path of the cache file for the collision grid with the given hash.
+    */
+   static std::string getCachePath(std::uint64_t collisionHash);
+
+   /**
+    * Maps previously calculated matrices from the cache, if they exist.
+    *
+    * @param path The path of the cache file.
+    * @param collisionHash The hash of the collision grid that the matrices must match.
+    *
+    * @return true iff the matrices were successfully loaded from the cache.
+    */
+   bool loadFromCache(const std::string& path, std::uint64_t collisionHash);
+
+   /**
+    * Writes the calculated matrices to the cache.
+    *
+    * @param path The path of the cache file.
+    * @param collisionHash The hash of the collision grid that the matrices were calculated for.
+    */
+   void saveToCache(const std::string& path, std::uint64_t collisionHash) const;
+
+   /**
+    * Deletes the least recently used cache files until the cache fits within MAX_CACHE_SIZE.
+    * Loading a cache file marks it as used, so the files of maps that are still visited are kept.
+    *
+    * @param keptPath The path of a cache file that must not be deleted (the one that was just written).
+    */
+   static void evictFromCache(const std::string& keptPath);
+
+   /**
+    * @param offset The offset from a tile to one of its neighbours.
+    *
+    * @return The successor code for a step in the given direction.
+    */
+   static std::uint8_t getDirectionCode(const geometry::Point2D& offset);
+
+   /**
+    * Initializes the matrices with the direct (single step) distances between adjacent tiles.
+    *
+    * @param grid A grid of free spaces and obstacles.
+    */
+   void initializeAdjacencies(const Grid<TileState>& grid);
+
+   /**
+    * Relaxes the paths through the pivot tiles of one block for every source and destination within another block.
+    *
+    * @param rowBlock The block of source tiles to update.
+    * @param columnBlock The block of destination tiles to update.
+    * @param pivotBlock The block of intermediate tiles to route paths through.
+    */
+   void relaxBlock(unsigned int rowBlock, unsigned int columnBlock, unsigned int pivotBlock);
+
+   /**
+    * Relaxes a range of paths from a single source through a single pivot tile.
+    * For each destination, the path through the pivot is kept (along with the
+    * successor of the path to the pivot) if it is shorter than the current path.
+    *
+    * @param distanceRow The distances from the source tile.
+    * @param successorRow The successors on the paths from the source tile.
+    * @param pivotRow The distances from the pivot tile.
+    * @param pivotDistance The distance from the source tile to the pivot tile.
+    * @param pivotSuccessor The successor on the path from the source tile to the pivot tile.
+    * @param begin The first destination tile to relax.
+    * @param end The destination tile after the last one to relax.
+    */
+   static void relaxRow(std::uint16_t* distanceRow, std::uint8_t* successorRow, const std::uint16_t* pivotRow, std::uint16_t pivotDistance, std::uint8_t pivotSuccessor, unsigned int begin, unsigned int end);
+
+   /**
+    * Copies the matrices out of the mapped cache file (if they were loaded from one),
+    * so that they can be modified.
+    */
+   void detachFromCache();
+
+   /**
+    * @param grid A grid of free spaces and obstacles.
+    * @param tile A tile on the grid.
+    * @param successorCode The direction of a step from the tile.
+    *
+    * @return true iff the step can still be taken on the grid.
+    */
+   bool isStepOpen(const Grid<TileState>& grid, const geometry::Point2D& tile, std::uint8_t successorCode) const;
+
+   /**
+    * Repairs the paths to a single destination after steps were removed from the grid.
+    * Only the sources whose paths used a removed step are recalculated, with a Dijkstra search
+    * that starts from their neighbours whose paths are still intact.
+    *
+    * @param grid A grid of free spaces and obstacles.
+    * @param dstTileNum The matrix index of the destination tile.
+    */
+   void repairDestination(const Grid<TileState>& grid, unsigned int dstTileNum);
 
    /**
     * @param tileNum The matrix index of the tile.
@@ -54,7 +241,7 @@ class RoyFloydWarshallMatrices final
     */
    static int coordsToTileNum(const geometry::Point2D& tileLocation, int width);
 
-   // Only making this public because MSVC's STL implementation requires std::async's result type to be default-constructible
+   // Only making this public because MSVC's STL implementation requires std::promise's result type to be default-constructible
    // see: https://developercommunity.visualstudio.com/content/problem/123622/stdasyncs-stdfuture-doesnt-support-types-that-are.html
    public:
    /**
@@ -88,13 +275,25 @@ class RoyFloydWarshallMatrices final
       float getDistance(geometry::Point2D src, geometry::Point2D dst) const;
 
       /**
-       * @param grid A grid of free spaces and obstacles.
+       * Repairs the matrices after an area of the grid has been blocked by new obstacles,
+       * without recalculating them from scratch. Blocking tiles can only remove steps from the grid,
+       * so only the destinations whose shortest paths used a removed step are recalculated.
+       *
+       * @param grid The grid of free spaces and obstacles, including the new obstacles.
+       * @param area The area (in tiles, with inclusive edges) containing the new obstacles.
+       */
+      void addObstacles(const Grid<TileState>& grid, const geometry::Rectangle& area);
+
+      /**
+       * @param grid A grid of free spaces and obstacles. The calculation holds on to its own copy,
+       *             so that it can safely finish in the background after it has been canceled.
        * @param gridBounds The rectangle representing the bounds of the grid.
+       * @param movementTileSize The size (in pixels) of each tile in the grid.
        * @param cancelCalculation An atomic flag used to determine if the calculation was canceled in flight.
        *
-       * @return the results of the RFW algorithm for the given grid.
+       * @return the results of the RFW algorithm for the given grid, loaded from the cache if the grid was seen before.
        */
-      static RoyFloydWarshallMatrices calculateRoyFloydWarshallMatrices(const Grid<TileState>* grid, const geometry::Rectangle* gridBounds, std::atomic<bool>& cancelCalculation);
+      static RoyFloydWarshallMatrices calculateRoyFloydWarshallMatrices(const std::shared_ptr<const Grid<TileState>>& grid, const geometry::Rectangle& gridBounds, int movementTileSize, std::atomic<bool>& cancelCalculation);
 };
 
 #endif
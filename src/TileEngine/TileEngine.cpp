@@ -306,6 +306,16 @@ NPC* TileEngine::getNPC(const std::string& npcName)
    return nullptr;
 }
 
+std::vector<Actor*> TileEngine::getActorsInArea(const geometry::Rectangle& area) const
+{
+   return m_entityGrid.getActorsInArea(area);
+}
+
+std::vector<Actor*> TileEngine::getActorsNear(const geometry::Point2D& center, int radius) const
+{
+   return m_entityGrid.getActorsInRadius(center, radius);
+}
+
 void TileEngine::addTriggerListener(const std::string& triggerName, std::unique_ptr<MapTriggerCallback> callback)
 {
    m_triggerScripts.emplace_back(triggerName, std::move(callback));
@@ -401,11 +411,33 @@ void TileEngine::draw()
          // Draw all the sprites
          for(const auto& nextActorToDraw : actors)
          {
-            nextActorToDraw->draw();
+            nextActorToDraw->draw(m_spriteBatch);
          }
+
+         m_spriteBatch.flush();
       }
       else
       {
+         // Only draw what can be seen through the camera
+         const geometry::Rectangle visibleArea = m_camera.getVisibleSceneBounds();
+         const geometry::Rectangle visibleTiles(
+            visibleArea.top / TILE_SIZE,
+            visibleArea.left / TILE_SIZE,
+            (visibleArea.bottom + TILE_SIZE - 1) / TILE_SIZE,
+            (visibleArea.right + TILE_SIZE - 1) / TILE_SIZE);
+
+         actors.erase(
+            std::remove_if(
+               actors.begin(),
+               actors.end(),
+               [&visibleArea](const Actor* actor)
+               {
+                  return !actor->getDrawBounds().intersects(visibleArea);
+               }
+            ),
+            actors.end()
+         );
+
          std::sort(
             actors.begin(),
             actors.end(),
@@ -415,34 +447,42 @@ void TileEngine::draw()
             }
          );
 
-         const unsigned int mapHeight = m_entityGrid.getMapBounds().getHeight();
-         for(int row = 0; row < mapHeight; ++row)
-         {
-            // Start by drawing a row of the background layers, if the map exists
-            if(m_entityGrid.hasMapData())
-            {
-               m_entityGrid.drawBackground(row);
-            }
-         }
+         // Start by drawing the background layers, which are never drawn over by the sprites
+         m_entityGrid.drawBackground(visibleTiles);
+
+         // Foreground rows below the visible area can still appear within it if they have a height offset
+         const int mapHeight = m_entityGrid.getMapBounds().getHeight();
+         const int lastRow = std::min(visibleTiles.bottom + m_entityGrid.getMaxHeightOffset(), mapHeight);
 
          auto nextActorToDraw = actors.begin();
 
-         for(int row = 0; row < mapHeight; ++row)
+         for(int row = visibleTiles.top; row < lastRow; ++row)
          {
             // Draw all the sprites on the row
             for(; nextActorToDraw != actors.end(); ++nextActorToDraw)
             {
                int nextActorTile = (*nextActorToDraw)->getLocation().y / TILE_SIZE;
                if(nextActorTile > row) break;
-               (*nextActorToDraw)->draw();
+               (*nextActorToDraw)->draw(m_spriteBatch);
             }
 
+            // The sprites must be on screen before the foreground row is drawn over them
+            m_spriteBatch.flush();
+
             // Draw a row of the foreground layers, if the map exists
             if(m_entityGrid.hasMapData())
             {
-               m_entityGrid.drawForeground(row);
+               m_entityGrid.drawForeground(row, visibleTiles);
             }
          }
+
+         // Draw the sprites that stand below the last drawn row, but are tall enough to be seen
+         for(; nextActorToDraw != actors.end(); ++nextActorToDraw)
+         {
+            (*nextActorToDraw)->draw(m_spriteBatch);
+         }
+
+         m_spriteBatch.flush();
       }
 
    m_camera.reset();
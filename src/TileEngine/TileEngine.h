@@ -16,6 +16,7 @@
 #include "Point2D.h"
 #include "PlayerCharacter.h"
 #include "Scheduler.h"
+#include "SpriteBatch.h"
 #include "TileEngineOverlay.h"
 #include "DialogueController.h"
 
@@ -95,6 +96,9 @@ class TileEngine final :
    /** An optional Actor target for the camera to follow. */
    const Actor* m_cameraTarget;
 
+   /** Collects the actors' sprites so that each row of them can be drawn in a few calls. */
+   SpriteBatch m_spriteBatch;
+
    /**
     * Loads a chapter script.
     *
@@ -319,6 +323,21 @@ class TileEngine final :
        */
       NPC* getNPC(const std::string& npcName);
 
+      /**
+       * @param area The area to search (in pixels).
+       *
+       * @return The actors in the current map that overlap the area.
+       */
+      std::vector<Actor*> getActorsInArea(const geometry::Rectangle& area) const;
+
+      /**
+       * @param center The center of the search (in pixels).
+       * @param radius The radius of the search (in pixels).
+       *
+       * @return The actors in the current map with any part of them within the radius of the center.
+       */
+      std::vector<Actor*> getActorsNear(const geometry::Point2D& center, int radius) const;
+
       /**
        * Adds a listener for a specific trigger zone on the Map, which will
        * execute the specified callback.
@@ -21,8 +21,7 @@
 #define DEBUG_FLAG DEBUG_RES_LOAD | DEBUG_TILE_ENG
 
 Tileset::Tileset(ResourceKey name) :
-   Resource(name),
-   m_texture(nullptr)
+   Resource(name)
 {
 }
 
@@ -62,8 +61,13 @@ void Tileset::load(const std::string& path)
    std::string imagePath = imageElement->Attribute("source");
    DEBUG("Loading tileset image \"%s\"...", imagePath.c_str());
 
-   m_texture.reset(new Texture(std::string("data/tilesets/") + imagePath));
-   m_size = m_texture->getSize() / TileEngine::TILE_SIZE;
+   m_texture = GraphicsUtil::getInstance()->getTextureAtlas().load(std::string("data/tilesets/") + imagePath);
+   if(!m_texture.isValid())
+   {
+      T_T("Failed to load tileset image.");
+   }
+
+   m_size = m_texture.getSize() / TileEngine::TILE_SIZE;
 
    m_collisionShapes.resize(m_size.getArea());
 
@@ -88,11 +92,12 @@ void Tileset::load(const std::string& path)
          const auto collisionElement = objectGroupElement->FirstChildElement("object");
          if(collisionElement)
          {
-            collisionShape.left = std::stoi(collisionElement->Attribute("x")) / TileEngine::TILE_SIZE;
-            collisionShape.top = std::stoi(collisionElement->Attribute("y")) / TileEngine::TILE_SIZE;
+            // Shapes are kept in pixels, so that maps with a finer movement resolution can use them.
+            collisionShape.left = std::stoi(collisionElement->Attribute("x"));
+            collisionShape.top = std::stoi(collisionElement->Attribute("y"));
 
-            const auto collisionWidth = std::stoi(collisionElement->Attribute("width")) / TileEngine::TILE_SIZE;
-            const auto collisionHeight = std::stoi(collisionElement->Attribute("height")) / TileEngine::TILE_SIZE;
+            const auto collisionWidth = std::stoi(collisionElement->Attribute("width"));
+            const auto collisionHeight = std::stoi(collisionElement->Attribute("height"));
 
             collisionShape.right = collisionShape.left + collisionWidth;
             collisionShape.bottom = collisionShape.top + collisionHeight;
@@ -101,7 +106,7 @@ void Tileset::load(const std::string& path)
    }
 }
 
-void Tileset::draw(int destX, int destY, int tileNum, bool useAlphaTesting)
+void Tileset::addTileVertices(int destX, int destY, int tileNum, std::vector<VertexBuffer::Vertex>& vertices) const
 {
    int tilesetX = tileNum % m_size.width;
    int tilesetY = tileNum / m_size.width;
@@ -111,14 +116,28 @@ void Tileset::draw(int destX, int destY, int tileNum, bool useAlphaTesting)
    float destTop = float(destY * TileEngine::TILE_SIZE);
    float destBottom = float((destY + 1) * TileEngine::TILE_SIZE);
 
-   float tileRight = float((tilesetX + 1) * TileEngine::TILE_SIZE - 1);
-   float tileBottom = float((tilesetY + 1) * TileEngine::TILE_SIZE - 1);
+   // The tileset shares its texture with other images, so find the tile's texels within the atlas page.
+   // Texture coordinates run to the outer edges of the tile's texels, so that each pixel of a tile drawn
+   // at its own size samples the centre of a single texel.
+   const geometry::Rectangle& bounds = m_texture.getBounds();
+   const geometry::Size& pageSize = m_texture.getTexture().getSize();
 
-   float top = float(tilesetY) / m_size.height;
-   float bottom = float(tileBottom) / (m_size.height * TileEngine::TILE_SIZE - 1);
-   float left = float(tilesetX) / m_size.width;
-   float right = float(tileRight) / (m_size.width * TileEngine::TILE_SIZE - 1);
+   float tileLeft = float(bounds.left + tilesetX * TileEngine::TILE_SIZE);
+   float tileTop = float(bounds.top + tilesetY * TileEngine::TILE_SIZE);
 
+   float left = tileLeft / pageSize.width;
+   float right = (tileLeft + TileEngine::TILE_SIZE) / pageSize.width;
+   float top = tileTop / pageSize.height;
+   float bottom = (tileTop + TileEngine::TILE_SIZE) / pageSize.height;
+
+   vertices.push_back({destLeft, destTop, left, top});
+   vertices.push_back({destRight, destTop, right, top});
+   vertices.push_back({destRight, destBottom, right, bottom});
+   vertices.push_back({destLeft, destBottom, left, bottom});
+}
+
+void Tileset::draw(const VertexBuffer& tiles, unsigned int firstVertex, unsigned int vertexCount, bool useAlphaTesting) const
+{
    glPushAttrib(GL_COLOR_BUFFER_BIT);
 
    if(useAlphaTesting)
@@ -133,14 +152,9 @@ void Tileset::draw(int destX, int destY, int tileNum, bool useAlphaTesting)
       glAlphaFunc(GL_GREATER, 0.1f);
    }
 
-   m_texture->bind();
+   m_texture.getTexture().bind();
 
-   glBegin(GL_QUADS);
-      glTexCoord2f(left, top); glVertex3f(destLeft, destTop, 0.0f);
-      glTexCoord2f(right, top); glVertex3f(destRight, destTop, 0.0f);
-      glTexCoord2f(right, bottom); glVertex3f(destRight, destBottom, 0.0f);
-      glTexCoord2f(left, bottom); glVertex3f(destLeft, destBottom, 0.0f);
-   glEnd();
+   tiles.draw(GL_QUADS, firstVertex, vertexCount);
 
    glPopAttrib();
 }
@@ -10,11 +10,11 @@
 #include "Rectangle.h"
 #include "Resource.h"
 #include "Size.h"
+#include "TextureAtlas.h"
+#include "VertexBuffer.h"
 
 #include <vector>
 
-class Texture;
-
 /**
  * This resource holds a tileset image texture and associated data
  * including dimensions (in tiles) and default passibility of each tile.
@@ -26,11 +26,11 @@ class Tileset : public Resource
    /** Tileset size (in tiles) */
    geometry::Size m_size;
 
-   /** Collision information for each tile */
+   /** Collision information for each tile (in pixels, relative to the top-left corner of the tile) */
    std::vector<geometry::Rectangle> m_collisionShapes;
 
-   /** The tile texture */
-   std::unique_ptr<Texture> m_texture;
+   /** The tileset image, packed into the texture atlas */
+   TextureAtlas::Region m_texture;
 
    void load(const std::string& path) override;
 
@@ -44,14 +44,24 @@ class Tileset : public Resource
       Tileset(ResourceKey name);
 
       /**
-       * Draws the specified tile to the coordinates specified
+       * Adds the vertices of a quad that draws the specified tile to the coordinates specified.
        *
        * @param destX The destination x-location (in tiles)
        * @param destY The destination y-location (in tiles)
        * @param tileNum The index of the tile to draw
-       * @param useAlphaTesting true iff transparent parts of the tile shouldn't be drawn
+       * @param vertices The vertex list to add the quad to
+       */
+      void addTileVertices(int destX, int destY, int tileNum, std::vector<VertexBuffer::Vertex>& vertices) const;
+
+      /**
+       * Draws a range of tile quads built with addTileVertices, using a single draw call.
+       *
+       * @param tiles The buffer holding the tile quads
+       * @param firstVertex The index of the first vertex to draw
+       * @param vertexCount The number of vertices to draw
+       * @param useAlphaTesting true iff transparent parts of the tiles shouldn't be drawn
        */
-      void draw(int destX, int destY, int tileNum, bool useAlphaTesting = false);
+      void draw(const VertexBuffer& tiles, unsigned int firstVertex, unsigned int vertexCount, bool useAlphaTesting = false) const;
 
       /**
        * Draws the specified color to the coordinates specified
@@ -68,7 +78,7 @@ class Tileset : public Resource
       /**
        * @param tileNum The index of the tile to check
        *
-       * @return the collision shape around the tile at tileNum
+       * @return the collision shape around the tile at tileNum (in pixels, relative to the top-left corner of the tile)
        */
       geometry::Rectangle getCollisionRect(int tileNum) const;
 };
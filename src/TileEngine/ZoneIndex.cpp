@@ -0,0 +1,63 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "ZoneIndex.h"
+#include "TileEngine.h"
+
+#include <algorithm>
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_TILE_ENG
+
+const int ZoneIndex::CELL_SIZE = TileEngine::TILE_SIZE * 4;
+
+void ZoneIndex::reset(const geometry::Size& size)
+{
+   m_size = geometry::Size((size.width + CELL_SIZE - 1) / CELL_SIZE, (size.height + CELL_SIZE - 1) / CELL_SIZE);
+   m_cells.clear();
+   m_cells.resize(m_size);
+}
+
+void ZoneIndex::addZone(unsigned int zoneIndex, const geometry::Rectangle& bounds)
+{
+   if(!bounds.isValid())
+   {
+      return;
+   }
+
+   // Zones sticking out of the indexed area are clipped to it, since nothing can move outside of it.
+   const int left = std::max(bounds.left, 0) / CELL_SIZE;
+   const int top = std::max(bounds.top, 0) / CELL_SIZE;
+   const int right = std::min((bounds.right - 1) / CELL_SIZE, int(m_size.width) - 1);
+   const int bottom = std::min((bounds.bottom - 1) / CELL_SIZE, int(m_size.height) - 1);
+
+   for(int y = top; y <= bottom; ++y)
+   {
+      for(int x = left; x <= right; ++x)
+      {
+         m_cells(x, y).push_back(zoneIndex);
+      }
+   }
+}
+
+const std::vector<unsigned int>& ZoneIndex::getZonesNear(const geometry::Point2D& point) const
+{
+   static const std::vector<unsigned int> NO_ZONES;
+
+   if(point.x < 0 || point.y < 0)
+   {
+      return NO_ZONES;
+   }
+
+   const unsigned int x = point.x / CELL_SIZE;
+   const unsigned int y = point.y / CELL_SIZE;
+   if(x >= m_size.width || y >= m_size.height)
+   {
+      return NO_ZONES;
+   }
+
+   return m_cells(x, y);
+}
@@ -0,0 +1,66 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ZONE_INDEX_H
+#define ZONE_INDEX_H
+
+#include <vector>
+
+#include "Grid.h"
+#include "Point2D.h"
+#include "Rectangle.h"
+#include "Size.h"
+
+/**
+ * A uniform grid over a map that lists the zones (exits, triggers, etc.)
+ * overlapping each of its cells. Zones are identified by their index in
+ * the list of zones that the index was built from, so that a point only
+ * has to be tested against the handful of zones sharing its cell.
+ *
+ * @author Noam Chitayat
+ */
+class ZoneIndex final
+{
+   /** The size (in pixels) of each cell of the index. */
+   static const int CELL_SIZE;
+
+   /** The indices of the zones overlapping each cell, in ascending order. */
+   Grid<std::vector<unsigned int>> m_cells;
+
+   /** The size of the index (in cells). */
+   geometry::Size m_size;
+
+   public:
+      /**
+       * Construct an empty index.
+       */
+      ZoneIndex() = default;
+
+      /**
+       * Clears the index and resizes it to cover an area.
+       *
+       * @param size The size of the indexed area (in pixels).
+       */
+      void reset(const geometry::Size& size);
+
+      /**
+       * Adds a zone to every cell that it overlaps.
+       * Zones must be added in ascending order of their indices.
+       *
+       * @param zoneIndex The index of the zone.
+       * @param bounds The bounds of the zone (in pixels).
+       */
+      void addZone(unsigned int zoneIndex, const geometry::Rectangle& bounds);
+
+      /**
+       * @param point A point (in pixels).
+       *
+       * @return The indices of the zones that could contain the point, in ascending order.
+       */
+      const std::vector<unsigned int>& getZonesNear(const geometry::Point2D& point) const;
+};
+
+#endif
@@ -19,15 +19,57 @@
 
 #include <EdenRocketRenderInterface.h>
 #include <Rocket/Core.h>
+#include <string>
 
 #include "GraphicsUtil.h"
 #include "Texture.h"
+#include "TextureAtlas.h"
 #include "Size.h"
 #include "DebugUtils.h"
 
 #define DEBUG_FLAG DEBUG_ROCKET
 
-#define GL_CLAMP_TO_EDGE 0x812F
+struct EdenRocketRenderInterface::RocketTexture
+{
+   /** The image's area of the texture atlas. */
+   TextureAtlas::Region region;
+
+   /** The file that the image was loaded from, or an empty string if Rocket generated the image. */
+   std::string source;
+
+   /** Whether the image is on a page of its own, where its texture coordinates wrap around. */
+   bool repeatable = false;
+};
+
+namespace
+{
+   /**
+    * Texture coordinates computed for an image's exact edges may stray
+    * slightly past [0,1] without the image actually being repeated.
+    */
+   const float TEXTURE_COORDINATE_TOLERANCE = 0.001f;
+
+   /**
+    * @param vertices The vertices of the geometry.
+    * @param numVertices The number of vertices.
+    *
+    * @return true iff the geometry tiles its texture, by using texture coordinates outside of [0,1].
+    */
+   bool isTextureRepeated(const Rocket::Core::Vertex* vertices, int numVertices)
+   {
+      for(int i = 0; i < numVertices; ++i)
+      {
+         const Rocket::Core::Vector2f& texCoord = vertices[i].tex_coord;
+         if(texCoord.x < -TEXTURE_COORDINATE_TOLERANCE || texCoord.x > 1.0f + TEXTURE_COORDINATE_TOLERANCE ||
+            texCoord.y < -TEXTURE_COORDINATE_TOLERANCE || texCoord.y > 1.0f + TEXTURE_COORDINATE_TOLERANCE)
+         {
+            return true;
+         }
+      }
+
+      return false;
+   }
+};
 
 void EdenRocketRenderInterface::RenderGeometry(
       Rocket::Core::Vertex* vertices,
@@ -59,14 +101,51 @@ void EdenRocketRenderInterface::RenderGeometry(
    }
    else
    {
+      RocketTexture& rocketTexture = *reinterpret_cast<RocketTexture*>(texture);
+      if(!rocketTexture.repeatable && !rocketTexture.source.empty() && isTextureRepeated(vertices, numVertices))
+      {
+         // Repeating the image on a shared page would sample the images next to it,
+         // so move the image to a page of its own, where its texture coordinates wrap around.
+         DEBUG("Texture %s is repeated. Moving it out of the shared atlas pages.", rocketTexture.source.c_str());
+         TextureAtlas::Region region = GraphicsUtil::getInstance()->getTextureAtlas().load(rocketTexture.source, true);
+         if(region.isValid())
+         {
+            rocketTexture.region = std::move(region);
+         }
+
+         // If the image can't be loaded again, keep drawing it from the shared page rather than retrying every frame.
+         rocketTexture.repeatable = true;
+      }
+
+      const TextureAtlas::Region& region = rocketTexture.region;
+      Texture& pageTexture = region.getTexture();
+      const geometry::Rectangle& bounds = region.getBounds();
+      const geometry::Size& pageSize = pageTexture.getSize();
+
       glEnable(GL_TEXTURE_2D);
-      reinterpret_cast<Texture*>(texture)->bind();
+      pageTexture.bind();
       glEnableClientState(GL_TEXTURE_COORD_ARRAY);
       glTexCoordPointer(2, GL_FLOAT, sizeof(Rocket::Core::Vertex), &vertices[0].tex_coord);
+
+      // Rocket's texture coordinates cover the whole image, so map them onto the image's area of the atlas page.
+      // Repeated images have pages of their own, where this mapping does nothing and the coordinates wrap around.
+      glMatrixMode(GL_TEXTURE);
+      glPushMatrix();
+      glLoadIdentity();
+      glTranslatef(float(bounds.left) / pageSize.width, float(bounds.top) / pageSize.height, 0);
+      glScalef(float(bounds.getWidth()) / pageSize.width, float(bounds.getHeight()) / pageSize.height, 1);
+      glMatrixMode(GL_MODELVIEW);
    }
 
    glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, indices);
 
+   if (texture)
+   {
+      glMatrixMode(GL_TEXTURE);
+      glPopMatrix();
+      glMatrixMode(GL_MODELVIEW);
+   }
+
    glPopAttrib();
    glPopClientAttrib();
    glPopMatrix();
@@ -95,14 +174,22 @@ bool EdenRocketRenderInterface::LoadTexture(
       Rocket::Core::Vector2i& textureDimensions,
       const Rocket::Core::String& source)
 {
-   Texture* texture = new Texture(std::string(source.CString()));
-   if(!texture->isValid())
+   // Decorators may tile a loaded image, but that can't be known until the image is drawn (see RenderGeometry),
+   // so the image starts out on a shared page. The source is kept in case the image has to be loaded again.
+   RocketTexture* rocketTexture = new RocketTexture();
+   rocketTexture->source = source.CString();
+   rocketTexture->region = GraphicsUtil::getInstance()->getTextureAtlas().load(rocketTexture->source);
+   if(!rocketTexture->region.isValid())
    {
-      delete texture;
+      delete rocketTexture;
       return false;
    }
 
-   textureHandle = reinterpret_cast<Rocket::Core::TextureHandle>(texture);
+   const geometry::Size& size = rocketTexture->region.getSize();
+   textureDimensions.x = size.width;
+   textureDimensions.y = size.height;
+
+   textureHandle = reinterpret_cast<Rocket::Core::TextureHandle>(rocketTexture);
    return true;
 }
 
@@ -111,19 +198,17 @@ bool EdenRocketRenderInterface::GenerateTexture(
       const Rocket::Core::byte* source,
       const Rocket::Core::Vector2i& sourceDimensions)
 {
-   Texture* texture = new Texture(reinterpret_cast<const void*>(source),
-         GL_RGBA, geometry::Size(sourceDimensions.x, sourceDimensions.y), 4);
-
-   texture->bind();
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   // Generated textures (such as font glyphs) are never repeated, so they always share pages.
+   RocketTexture* rocketTexture = new RocketTexture();
+   rocketTexture->region = GraphicsUtil::getInstance()->getTextureAtlas().add(source,
+         geometry::Size(sourceDimensions.x, sourceDimensions.y), sourceDimensions.x * 4);
 
-   textureHandle = reinterpret_cast<Rocket::Core::TextureHandle>(texture);
+   textureHandle = reinterpret_cast<Rocket::Core::TextureHandle>(rocketTexture);
    return true;
 }
 
 void EdenRocketRenderInterface::ReleaseTexture(Rocket::Core::TextureHandle textureHandle)
 {
-   delete reinterpret_cast<Texture*>(textureHandle);
+   delete reinterpret_cast<RocketTexture*>(textureHandle);
 }
 
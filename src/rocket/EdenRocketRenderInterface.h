@@ -29,6 +29,11 @@
  */
 class EdenRocketRenderInterface final : public Rocket::Core::RenderInterface
 {
+   /**
+    * A texture handed to Rocket: an image in the texture atlas, along with where it came from.
+    */
+   struct RocketTexture;
+
    public:
       /**
        * Called by Rocket when it wants to render geometry that it does not wish to optimise.
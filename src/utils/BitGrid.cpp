@@ -0,0 +1,125 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "BitGrid.h"
+
+namespace
+{
+   /** The number of cells stored in each word. */
+   const int BITS_PER_WORD = 64;
+
+   /**
+    * @param word A word with at least one bit set.
+    *
+    * @return The index of the lowest set bit in the word.
+    */
+   int findLowestSetBit(std::uint64_t word)
+   {
+#if defined(__GNUC__)
+      return __builtin_ctzll(word);
+#else
+      int index = 0;
+      while((word & 1) == 0)
+      {
+         word >>= 1;
+         ++index;
+      }
+
+      return index;
+#endif
+   }
+};
+
+bool BitGrid::empty() const noexcept
+{
+   return m_words.empty();
+}
+
+void BitGrid::clear() noexcept
+{
+   m_size = {0, 0};
+   m_wordsPerRow = 0;
+   m_words.clear();
+}
+
+void BitGrid::resize(const geometry::Size& size)
+{
+   m_size = size;
+   m_wordsPerRow = (size.width + BITS_PER_WORD - 1) / BITS_PER_WORD;
+   m_words.assign(m_wordsPerRow * size.height, 0);
+}
+
+bool BitGrid::get(int x, int y) const
+{
+   const std::uint64_t word = m_words[y * m_wordsPerRow + x / BITS_PER_WORD];
+   return (word >> (x % BITS_PER_WORD)) & 1;
+}
+
+std::uint64_t BitGrid::getSpanMask(int left, int right, int wordIndex)
+{
+   std::uint64_t mask = ~std::uint64_t(0);
+   if(left / BITS_PER_WORD == wordIndex)
+   {
+      mask &= ~std::uint64_t(0) << (left % BITS_PER_WORD);
+   }
+
+   if(right / BITS_PER_WORD == wordIndex)
+   {
+      mask &= ~std::uint64_t(0) >> (BITS_PER_WORD - 1 - right % BITS_PER_WORD);
+   }
+
+   return mask;
+}
+
+void BitGrid::setSpan(int y, int left, int right, bool value)
+{
+   std::uint64_t* row = &m_words[y * m_wordsPerRow];
+   for(int wordIndex = left / BITS_PER_WORD; wordIndex <= right / BITS_PER_WORD; ++wordIndex)
+   {
+      const std::uint64_t mask = getSpanMask(left, right, wordIndex);
+      if(value)
+      {
+         row[wordIndex] |= mask;
+      }
+      else
+      {
+         row[wordIndex] &= ~mask;
+      }
+   }
+}
+
+void BitGrid::copySpan(const BitGrid& source, int y, int left, int right)
+{
+   std::uint64_t* row = &m_words[y * m_wordsPerRow];
+   const std::uint64_t* sourceRow = &source.m_words[y * m_wordsPerRow];
+   for(int wordIndex = left / BITS_PER_WORD; wordIndex <= right / BITS_PER_WORD; ++wordIndex)
+   {
+      const std::uint64_t mask = getSpanMask(left, right, wordIndex);
+      row[wordIndex] = (row[wordIndex] & ~mask) | (sourceRow[wordIndex] & mask);
+   }
+}
+
+int BitGrid::findFirstSet(int y, int left, int right) const
+{
+   if(left > right) return -1;
+
+   const std::uint64_t* row = &m_words[y * m_wordsPerRow];
+   for(int wordIndex = left / BITS_PER_WORD; wordIndex <= right / BITS_PER_WORD; ++wordIndex)
+   {
+      const std::uint64_t bits = row[wordIndex] & getSpanMask(left, right, wordIndex);
+      if(bits != 0)
+      {
+         return wordIndex * BITS_PER_WORD + findLowestSetBit(bits);
+      }
+   }
+
+   return -1;
+}
+
+bool BitGrid::isSpanClear(int y, int left, int right) const
+{
+   return findFirstSet(y, left, right) < 0;
+}
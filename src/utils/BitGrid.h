@@ -0,0 +1,113 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef BIT_GRID_H
+#define BIT_GRID_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Size.h"
+
+/**
+ * A 2-dimensional array of bits, packed into 64-bit words.
+ * Each row starts at a new word, so a span of cells in a row can be
+ * tested or modified a whole word (64 cells) at a time with a mask.
+ *
+ * @author Noam Chitayat
+ */
+class BitGrid final
+{
+   /** The bits of the grid, row by row. */
+   std::vector<std::uint64_t> m_words;
+
+   /** The number of words used by each row. */
+   unsigned int m_wordsPerRow = 0;
+
+   /** The size of the grid. */
+   geometry::Size m_size;
+
+   /**
+    * @param left The x-coordinate of the first cell in the span.
+    * @param right The x-coordinate of the last cell in the span.
+    * @param wordIndex The index of a word (within its row) that overlaps the span.
+    *
+    * @return A mask of the bits in the word that are within the span.
+    */
+   static std::uint64_t getSpanMask(int left, int right, int wordIndex);
+
+   public:
+      /**
+       * Construct an empty, zero-length grid.
+       */
+      BitGrid() = default;
+
+      /**
+       * @return true iff the grid has no contents.
+       */
+      bool empty() const noexcept;
+
+      /**
+       * Clears out the contents of the grid.
+       */
+      void clear() noexcept;
+
+      /**
+       * Resizes the grid, clearing every bit.
+       *
+       * @param size The new size for the grid.
+       */
+      void resize(const geometry::Size& size);
+
+      /**
+       * @param x The x-coordinate of the cell.
+       * @param y The y-coordinate of the cell.
+       *
+       * @return true iff the bit for the cell is set.
+       */
+      bool get(int x, int y) const;
+
+      /**
+       * Sets or clears the bits for a span of cells in a row.
+       *
+       * @param y The row of the span.
+       * @param left The x-coordinate of the first cell in the span.
+       * @param right The x-coordinate of the last cell in the span (inclusive).
+       * @param value true to set the bits, false to clear them.
+       */
+      void setSpan(int y, int left, int right, bool value);
+
+      /**
+       * Copies the bits for a span of cells in a row from another grid of the same size.
+       *
+       * @param source The grid to copy the bits from.
+       * @param y The row of the span.
+       * @param left The x-coordinate of the first cell in the span.
+       * @param right The x-coordinate of the last cell in the span (inclusive).
+       */
+      void copySpan(const BitGrid& source, int y, int left, int right);
+
+      /**
+       * @param y The row of the span.
+       * @param left The x-coordinate of the first cell in the span.
+       * @param right The x-coordinate of the last cell in the span (inclusive).
+       *
+       * @return The x-coordinate of the first cell in the span whose bit is set,
+       *         or -1 if there is none (or the span is empty).
+       */
+      int findFirstSet(int y, int left, int right) const;
+
+      /**
+       * @param y The row of the span.
+       * @param left The x-coordinate of the first cell in the span.
+       * @param right The x-coordinate of the last cell in the span (inclusive).
+       *
+       * @return true iff no bit in the span is set.
+       */
+      bool isSpanClear(int y, int left, int right) const;
+};
+
+#endif
@@ -8,34 +8,43 @@
 #define CANCELABLE_TASK_H
 
 #include <atomic>
+#include <exception>
+#include <functional>
 #include <future>
+#include <memory>
 #include <type_traits>
+#include <utility>
+
+#include "WorkerPool.h"
 
 /**
- * A wrapper for an std::async task. Exposes the ability
- * to cancel the task in the middle of execution.
+ * A task run in the background on the engine's shared WorkerPool.
+ * Exposes the ability to cancel the task in the middle of execution.
  *
  * NOTE: CancelableTask relies on CO-OPERATIVE cancelation.
- * In other words, if the running task does not actually
- * check the cancel signal and exit early, then canceling
- * this task will just cause the current thread to block
- * until the task completes.
+ * The running task is handed a cancel flag, which it should check
+ * regularly in order to exit early. Canceling never blocks: the task
+ * is abandoned right away, and keeps running in the background until
+ * it notices the flag. For this reason, the arguments given to the task
+ * are copied into it, and the task must not refer to anything that the
+ * caller might destroy after canceling it.
  *
  * @author Noam Chitayat
  */
 template<typename Return> class CancelableTask final
 {
-   /** Cancel flag, used to signal a task to end ASAP. */
-   std::atomic<bool> m_cancel;
-   
+   /** Cancel flag for the current run, shared with the running job so that it outlives an abandoned run. */
+   std::shared_ptr<std::atomic<bool>> m_cancel;
+
    /** The future that will hold the result of the task. */
    std::shared_future<Return> m_future;
 
    public:
       /**
-       * Launch an async task that can be signaled with a cancel flag.
+       * Launch a background task that can be signaled with a cancel flag.
+       * Any task that is already running is canceled first.
        *
-       * @param func The function to run asynchronously.
+       * @param func The function to run in the background.
        * @param args The arguments to supply to the function.
        */
       template<typename Func, typename... Args> void runTask(Func&& func, Args&&... args)
@@ -43,27 +52,37 @@ template<typename Return> class CancelableTask final
          // This assert just helps debug what may otherwise be a difficult-to-decipher
          // template complaint from the compiler.
          static_assert(
-           std::is_same<decltype(func(args..., std::ref(m_cancel))), Return>::value,
+           std::is_same<decltype(func(args..., std::declval<std::atomic<bool>&>())), Return>::value,
            "CancelableTask<Return>: func does not return type Return for the given args.");
 
-         // Signal the current task to cancel before the new one begins,
-         // since reassigning m_future will cause the current thread to
-         // block until the current task completes.
          cancel();
 
-         m_cancel = false;
-         m_future = std::async(
-                      std::launch::async,
-                      std::forward<Func>(func),
-                      std::forward<Args>(args)...,
-                      // Without std::ref, m_cancel is passed by copy to std::async, which
-                      // doesn't work (can't copy atomics, also it's a template mismatch).
-                      std::ref(m_cancel));
+         const auto cancelFlag = std::make_shared<std::atomic<bool>>(false);
+         const auto promise = std::make_shared<std::promise<Return>>();
+         const auto work = std::bind(std::forward<Func>(func), std::forward<Args>(args)..., std::ref(*cancelFlag));
+
+         m_cancel = cancelFlag;
+         m_future = promise->get_future().share();
+
+         WorkerPool::getSharedPool().submit([cancelFlag, promise, work](unsigned int) mutable
+         {
+            // A task canceled before it started has been abandoned, so nobody is waiting for its result.
+            if(*cancelFlag) return;
+
+            try
+            {
+               promise->set_value(work());
+            }
+            catch(...)
+            {
+               promise->set_exception(std::current_exception());
+            }
+         });
       }
 
       /**
        * Destructor.
-       * Signals the task to cancel, and then blocks until it does so.
+       * Signals the task to cancel, without waiting for it to stop.
        */
       ~CancelableTask()
       {
@@ -100,7 +119,7 @@ template<typename Return> class CancelableTask final
       {
          return m_future.get();
       }
-   
+
       /**
        * Gets the result of the assigned task. If the task
        * has not yet completed, then this function blocks
@@ -110,19 +129,24 @@ template<typename Return> class CancelableTask final
        */
       Return& get()
       {
-         return m_future.get();
+         // std::shared_future only hands out const results, but this task is
+         // the sole owner of the shared state, so the result may be modified.
+         return const_cast<Return&>(m_future.get());
       }
-   
+
       /**
-       * Signals the task to cancel, and then blocks until it does so.
+       * Signals the task to cancel and abandons it (along with its result), so that the task is no longer valid.
+       * Does not wait for the task to stop.
        */
       void cancel()
       {
-         m_cancel = true;
-         if(m_future.valid())
+         if(m_cancel)
          {
-            m_future.wait();
+            *m_cancel = true;
+            m_cancel.reset();
          }
+
+         m_future = std::shared_future<Return>();
       }
 };
 
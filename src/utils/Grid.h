@@ -7,6 +7,7 @@
 #ifndef GRID_H
 #define GRID_H
 
+#include "GridLayout.h"
 #include "Rectangle.h"
 #include "Size.h"
 #include <vector>
@@ -14,13 +15,19 @@
 /**
  * A utility class to help maintain and manage access
  * to a 2-dimensional array.
+ *
+ * @tparam Layout The policy deciding where each cell is stored in the array
+ *                (RowMajorGridLayout, TiledGridLayout or MortonGridLayout).
  */
-template<typename T> class Grid final
+template<typename T, typename Layout = RowMajorGridLayout> class Grid final
 {
    /** The array representing the 2D grid. */
    std::vector<T> m_grid;
 
-   /** The size of the grid (used for proper 2D grid indexing). */
+   /** The layout mapping grid coordinates to positions in the array. */
+   Layout m_layout;
+
+   /** The size of the grid. */
    geometry::Size m_size;
 
    public:
@@ -47,7 +54,7 @@ template<typename T> class Grid final
        */
       const T& operator()(unsigned int x, unsigned int y) const
       {
-         return m_grid[y * m_size.width + x];
+         return m_grid[m_layout.getIndex(x, y)];
       }
 
       /**
@@ -58,7 +65,7 @@ template<typename T> class Grid final
        */
       T& operator()(unsigned int x, unsigned int y)
       {
-         return m_grid[y * m_size.width + x];
+         return m_grid[m_layout.getIndex(x, y)];
       }
 
       /**
@@ -74,6 +81,7 @@ template<typename T> class Grid final
       void clear() noexcept
       {
          m_size = {0,0};
+         m_layout.resize(m_size);
          m_grid.clear();
       }
 
@@ -85,7 +93,7 @@ template<typename T> class Grid final
       void resize(const geometry::Size& size, const T& defaultValue = T())
       {
          m_size = size;
-         m_grid.resize(m_size.getArea(), defaultValue);
+         m_grid.resize(m_layout.resize(m_size), defaultValue);
       }
    
       /**
@@ -109,6 +117,28 @@ template<typename T> class Grid final
             }
          }
       }
+
+      /**
+       * Copies the grid cells in a given rectangle from another grid of the same size.
+       *
+       * @param source The grid to copy the cells from.
+       * @param rect The Rectangle representing the subregion to copy.
+       */
+      void copyRect(const Grid& source, const geometry::Rectangle& rect)
+      {
+         if(!rect.isValid())
+         {
+            return;
+         }
+
+         for(int y = rect.top; y < rect.bottom; ++y)
+         {
+            for(int x = rect.left; x < rect.right; ++x)
+            {
+               operator()(x, y) = source(x, y);
+            }
+         }
+      }
 };
 
 #endif
@@ -0,0 +1,151 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef GRID_LAYOUT_H
+#define GRID_LAYOUT_H
+
+#include "Size.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Lays out the cells of a Grid row by row.
+ * Horizontal neighbours are adjacent in memory, but vertical neighbours
+ * are a full row apart.
+ */
+class RowMajorGridLayout final
+{
+   /** The width of the grid. */
+   unsigned int m_width = 0;
+
+   public:
+      /**
+       * Prepares the layout for a grid of the given size.
+       *
+       * @param size The size of the grid.
+       *
+       * @return The number of cells needed to store the grid.
+       */
+      std::size_t resize(const geometry::Size& size)
+      {
+         m_width = size.width;
+         return size.getArea();
+      }
+
+      /**
+       * @param x The x-coordinate of the cell.
+       * @param y The y-coordinate of the cell.
+       *
+       * @return The position of the cell in the grid storage.
+       */
+      std::size_t getIndex(unsigned int x, unsigned int y) const
+      {
+         return y * m_width + x;
+      }
+};
+
+/**
+ * Lays out the cells of a Grid in square tiles, which are stored row by row.
+ * The cells within each tile are also stored row by row, so that the cells
+ * around any point are usually within the same few cache lines.
+ *
+ * @tparam TILE_LENGTH The width and height of each tile (a power of 2).
+ */
+template<unsigned int TILE_LENGTH> class TiledGridLayout final
+{
+   static_assert(TILE_LENGTH > 0 && (TILE_LENGTH & (TILE_LENGTH - 1)) == 0, "Grid tile length must be a power of 2.");
+
+   /** The number of cells in each tile. */
+   static const unsigned int TILE_AREA = TILE_LENGTH * TILE_LENGTH;
+
+   /** The number of tiles in each row of tiles. */
+   unsigned int m_tilesPerRow = 0;
+
+   public:
+      /**
+       * Prepares the layout for a grid of the given size.
+       * The grid is padded out to a whole number of tiles.
+       *
+       * @param size The size of the grid.
+       *
+       * @return The number of cells needed to store the grid.
+       */
+      std::size_t resize(const geometry::Size& size)
+      {
+         m_tilesPerRow = (size.width + TILE_LENGTH - 1) / TILE_LENGTH;
+         const unsigned int tileRows = (size.height + TILE_LENGTH - 1) / TILE_LENGTH;
+         return std::size_t(m_tilesPerRow) * tileRows * TILE_AREA;
+      }
+
+      /**
+       * @param x The x-coordinate of the cell.
+       * @param y The y-coordinate of the cell.
+       *
+       * @return The position of the cell in the grid storage.
+       */
+      std::size_t getIndex(unsigned int x, unsigned int y) const
+      {
+         const std::size_t tileIndex = (y / TILE_LENGTH) * m_tilesPerRow + x / TILE_LENGTH;
+         return tileIndex * TILE_AREA + (y % TILE_LENGTH) * TILE_LENGTH + x % TILE_LENGTH;
+      }
+};
+
+/**
+ * Lays out the cells of a Grid along a Z-order (Morton) curve, which
+ * interleaves the bits of the x- and y-coordinates. Cells that are close
+ * together in either direction are close together in memory at every scale.
+ * The grid is padded out to a square with a power-of-2 side, so this layout
+ * wastes memory on grids that are far from square.
+ */
+class MortonGridLayout final
+{
+   /**
+    * @param value A coordinate (up to 16 bits).
+    *
+    * @return The coordinate, with a 0 bit inserted above each of its bits.
+    */
+   static std::size_t spreadBits(std::uint32_t value)
+   {
+      value &= 0x0000FFFF;
+      value = (value | (value << 8)) & 0x00FF00FF;
+      value = (value | (value << 4)) & 0x0F0F0F0F;
+      value = (value | (value << 2)) & 0x33333333;
+      value = (value | (value << 1)) & 0x55555555;
+      return value;
+   }
+
+   public:
+      /**
+       * Prepares the layout for a grid of the given size.
+       *
+       * @param size The size of the grid (at most 65536 cells per side).
+       *
+       * @return The number of cells needed to store the grid.
+       */
+      std::size_t resize(const geometry::Size& size)
+      {
+         std::size_t side = 1;
+         while(side < size.width || side < size.height)
+         {
+            side <<= 1;
+         }
+
+         return side * side;
+      }
+
+      /**
+       * @param x The x-coordinate of the cell.
+       * @param y The y-coordinate of the cell.
+       *
+       * @return The position of the cell in the grid storage.
+       */
+      std::size_t getIndex(unsigned int x, unsigned int y) const
+      {
+         return spreadBits(x) | (spreadBits(y) << 1);
+      }
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "DebugUtils.h"
+#define DEBUG_FLAG DEBUG_RES_LOAD
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+   HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if(fileHandle == INVALID_HANDLE_VALUE)
+   {
+      return;
+   }
+
+   m_fileHandle = fileHandle;
+
+   LARGE_INTEGER fileSize;
+   if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+   {
+      close();
+      return;
+   }
+
+   m_mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if(m_mappingHandle == nullptr)
+   {
+      close();
+      return;
+   }
+
+   m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+   if(m_data == nullptr)
+   {
+      DEBUG("Failed to map file %s into memory.", path.c_str());
+      close();
+      return;
+   }
+
+   m_size = static_cast<std::size_t>(fileSize.QuadPart);
+}
+
+void MappedFile::close()
+{
+   if(m_data != nullptr)
+   {
+      UnmapViewOfFile(m_data);
+      m_data = nullptr;
+   }
+
+   if(m_mappingHandle != nullptr)
+   {
+      CloseHandle(m_mappingHandle);
+      m_mappingHandle = nullptr;
+   }
+
+   if(m_fileHandle != nullptr)
+   {
+      CloseHandle(m_fileHandle);
+      m_fileHandle = nullptr;
+   }
+
+   m_size = 0;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+   m_fileDescriptor = open(path.c_str(), O_RDONLY);
+   if(m_fileDescriptor < 0)
+   {
+      return;
+   }
+
+   struct stat fileStatus;
+   if(fstat(m_fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+   {
+      close();
+      return;
+   }
+
+   void* data = mmap(nullptr, static_cast<std::size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+   if(data == MAP_FAILED)
+   {
+      DEBUG("Failed to map file %s into memory.", path.c_str());
+      close();
+      return;
+   }
+
+   m_data = static_cast<const char*>(data);
+   m_size = static_cast<std::size_t>(fileStatus.st_size);
+}
+
+void MappedFile::close()
+{
+   if(m_data != nullptr)
+   {
+      munmap(const_cast<char*>(m_data), m_size);
+      m_data = nullptr;
+   }
+
+   if(m_fileDescriptor >= 0)
+   {
+      ::close(m_fileDescriptor);
+      m_fileDescriptor = -1;
+   }
+
+   m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+   close();
+}
+
+bool MappedFile::isValid() const
+{
+   return m_data != nullptr;
+}
+
+const char* MappedFile::getData() const
+{
+   return m_data;
+}
+
+std::size_t MappedFile::getSize() const
+{
+   return m_size;
+}
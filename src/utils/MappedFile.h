@@ -0,0 +1,78 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * A read-only view of a file that is mapped into memory.
+ * The operating system pages the file contents in on demand,
+ * so large files can be opened without reading them up front.
+ *
+ * @author Noam Chitayat
+ */
+class MappedFile final
+{
+   /** The start of the mapped file contents (or nullptr if the file could not be mapped). */
+   const char* m_data = nullptr;
+
+   /** The size (in bytes) of the mapped file. */
+   std::size_t m_size = 0;
+
+#ifdef _WIN32
+   /** The handle of the opened file. */
+   void* m_fileHandle = nullptr;
+
+   /** The handle of the file mapping object. */
+   void* m_mappingHandle = nullptr;
+#else
+   /** The descriptor of the opened file. */
+   int m_fileDescriptor = -1;
+#endif
+
+   /**
+    * Unmaps the file and closes any open handles.
+    */
+   void close();
+
+   public:
+      /**
+       * Constructor. Maps the file at the given path into memory.
+       * If the file doesn't exist or can't be mapped, the resulting
+       * view will be invalid.
+       *
+       * @param path The path of the file to map.
+       */
+      MappedFile(const std::string& path);
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      /**
+       * Destructor. Unmaps the file.
+       */
+      ~MappedFile();
+
+      /**
+       * @return true iff the file was successfully mapped into memory.
+       */
+      bool isValid() const;
+
+      /**
+       * @return The start of the mapped file contents.
+       */
+      const char* getData() const;
+
+      /**
+       * @return The size (in bytes) of the mapped file.
+       */
+      std::size_t getSize() const;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "SkylinePacker.h"
+#include <algorithm>
+
+SkylinePacker::SkylinePacker(const geometry::Size& size) :
+   m_size(size)
+{
+   clear();
+}
+
+void SkylinePacker::clear()
+{
+   m_skyline.assign(1, {0, 0, static_cast<int>(m_size.width)});
+}
+
+const geometry::Size& SkylinePacker::getSize() const
+{
+   return m_size;
+}
+
+int SkylinePacker::findTop(unsigned int segmentIndex, const geometry::Size& size) const
+{
+   const int left = m_skyline[segmentIndex].x;
+   const int width = size.width;
+   if(left + width > static_cast<int>(m_size.width))
+   {
+      return -1;
+   }
+
+   // The rectangle has to sit under every span that it covers
+   int top = 0;
+   int remainingWidth = width;
+   for(unsigned int i = segmentIndex; remainingWidth > 0; ++i)
+   {
+      top = std::max(top, m_skyline[i].y);
+      remainingWidth -= m_skyline[i].width;
+   }
+
+   if(top + static_cast<int>(size.height) > static_cast<int>(m_size.height))
+   {
+      return -1;
+   }
+
+   return top;
+}
+
+bool SkylinePacker::pack(const geometry::Size& size, geometry::Point2D& location)
+{
+   if(size.width == 0 || size.height == 0)
+   {
+      return false;
+   }
+
+   int bestIndex = -1;
+   int bestBottom = 0;
+   for(unsigned int i = 0; i < m_skyline.size(); ++i)
+   {
+      const int top = findTop(i, size);
+      if(top < 0)
+      {
+         continue;
+      }
+
+      const int bottom = top + size.height;
+      if(bestIndex < 0 || bottom < bestBottom)
+      {
+         bestIndex = i;
+         bestBottom = bottom;
+      }
+   }
+
+   if(bestIndex < 0)
+   {
+      return false;
+   }
+
+   const int left = m_skyline[bestIndex].x;
+   const int right = left + size.width;
+   location = geometry::Point2D(left, bestBottom - size.height);
+
+   // Raise the skyline under the new rectangle, trimming the spans that it covers
+   m_skyline.insert(m_skyline.begin() + bestIndex, {left, bestBottom, static_cast<int>(size.width)});
+
+   unsigned int next = bestIndex + 1;
+   while(next < m_skyline.size() && m_skyline[next].x < right)
+   {
+      Segment& segment = m_skyline[next];
+      const int segmentRight = segment.x + segment.width;
+      if(segmentRight <= right)
+      {
+         m_skyline.erase(m_skyline.begin() + next);
+      }
+      else
+      {
+         segment.width = segmentRight - right;
+         segment.x = right;
+         break;
+      }
+   }
+
+   // Merge neighbouring spans at the same height
+   for(unsigned int i = 0; i + 1 < m_skyline.size();)
+   {
+      if(m_skyline[i].y == m_skyline[i + 1].y)
+      {
+         m_skyline[i].width += m_skyline[i + 1].width;
+         m_skyline.erase(m_skyline.begin() + i + 1);
+      }
+      else
+      {
+         ++i;
+      }
+   }
+
+   return true;
+}
@@ -0,0 +1,88 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SKYLINE_PACKER_H
+#define SKYLINE_PACKER_H
+
+#include <vector>
+
+#include "Point2D.h"
+#include "Size.h"
+
+/**
+ * Packs rectangles into a fixed-size bin, using the skyline bottom-left heuristic.
+ * The packer tracks the lowest free row (the "skyline") across each span of
+ * the bin's width, and places each rectangle where its bottom edge ends up
+ * as high as possible (here, "up" is towards the top of the bin at y = 0).
+ *
+ * Space below the skyline that a rectangle leaves uncovered is never reused,
+ * which keeps packing fast at the cost of some wasted space.
+ *
+ * @author Noam Chitayat
+ */
+class SkylinePacker final
+{
+   /**
+    * A horizontal span of the skyline.
+    */
+   struct Segment
+   {
+      /** The left edge of the span */
+      int x;
+
+      /** The first free row under the span */
+      int y;
+
+      /** The width of the span */
+      int width;
+   };
+
+   /** The size of the bin */
+   geometry::Size m_size;
+
+   /** The skyline, as spans ordered from left to right that together cover the width of the bin */
+   std::vector<Segment> m_skyline;
+
+   /**
+    * Finds where a rectangle would be placed if its left edge lined up with a span of the skyline.
+    *
+    * @param segmentIndex The index of the span.
+    * @param size The size of the rectangle.
+    *
+    * @return The top edge that the rectangle would have, or -1 if the rectangle wouldn't fit there.
+    */
+   int findTop(unsigned int segmentIndex, const geometry::Size& size) const;
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param size The size of the bin.
+       */
+      explicit SkylinePacker(const geometry::Size& size);
+
+      /**
+       * Finds a place for a rectangle in the bin and marks it as used.
+       *
+       * @param size The size of the rectangle to place.
+       * @param location Set to the top-left corner of the placed rectangle.
+       *
+       * @return true iff there was room for the rectangle.
+       */
+      bool pack(const geometry::Size& size, geometry::Point2D& location);
+
+      /**
+       * Marks the whole bin as free.
+       */
+      void clear();
+
+      /**
+       * @return The size of the bin.
+       */
+      const geometry::Size& getSize() const;
+};
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::JobGroup::~JobGroup()
+{
+   wait();
+}
+
+void WorkerPool::JobGroup::wait()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_jobsFinished.wait(lock, [this]() { return m_pendingJobs == 0; });
+}
+
+void WorkerPool::JobGroup::waitForRunningJobs()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_jobsFinished.wait(lock, [this]() { return m_runningJobs == 0; });
+}
+
+void WorkerPool::JobGroup::startJob()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   ++m_runningJobs;
+}
+
+void WorkerPool::JobGroup::finishJob()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   --m_runningJobs;
+
+   // Notify while still holding the lock, since a waiting thread may destroy the group as soon as it sees no pending jobs.
+   if(--m_pendingJobs == 0 || m_runningJobs == 0)
+   {
+      m_jobsFinished.notify_all();
+   }
+}
+
+WorkerPool::WorkerPool(unsigned int numWorkers)
+{
+   numWorkers = std::max(numWorkers, 1u);
+   m_workers.reserve(numWorkers);
+   for(unsigned int i = 0; i < numWorkers; ++i)
+   {
+      m_workers.emplace_back(&WorkerPool::runWorker, this, i);
+   }
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+   }
+
+   m_jobQueued.notify_all();
+   for(auto& worker : m_workers)
+   {
+      worker.join();
+   }
+}
+
+WorkerPool& WorkerPool::getSharedPool()
+{
+   // Leave a core for the main thread.
+   static WorkerPool sharedPool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+   return sharedPool;
+}
+
+unsigned int WorkerPool::getNumWorkers() const
+{
+   return m_workers.size();
+}
+
+void WorkerPool::submit(Job job, Priority priority)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs[static_cast<unsigned int>(priority)].push_back(std::move(job));
+   }
+
+   m_jobQueued.notify_one();
+}
+
+void WorkerPool::submit(Job job, JobGroup& group, Priority priority)
+{
+   {
+      std::lock_guard<std::mutex> lock(group.m_mutex);
+      ++group.m_pendingJobs;
+   }
+
+   submit([job, &group](unsigned int workerIndex)
+   {
+      group.startJob();
+      job(workerIndex);
+      group.finishJob();
+   }, priority);
+}
+
+std::deque<WorkerPool::Job>* WorkerPool::getNextQueue()
+{
+   for(auto& jobs : m_jobs)
+   {
+      if(!jobs.empty())
+      {
+         return &jobs;
+      }
+   }
+
+   return nullptr;
+}
+
+void WorkerPool::runWorker(unsigned int workerIndex)
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   for(;;)
+   {
+      std::deque<Job>* jobs = nullptr;
+      m_jobQueued.wait(lock, [this, &jobs]() { return (jobs = getNextQueue()) != nullptr || m_stopping; });
+      if(jobs == nullptr)
+      {
+         // The pool is stopping and there is nothing left to run.
+         return;
+      }
+
+      Job job = std::move(jobs->front());
+      jobs->pop_front();
+
+      lock.unlock();
+      job(workerIndex);
+      lock.lock();
+   }
+}
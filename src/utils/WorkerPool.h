@@ -0,0 +1,180 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2016 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run queued jobs, highest priority first
+ * and in the order they were submitted within each priority.
+ * Unlike std::async, the threads are started once and reused, so submitting a job
+ * does not pay for creating a thread.
+ *
+ * The engine shares a single pool (see getSharedPool) between all of its background
+ * work, so that the number of busy threads stays bounded by the number of cores.
+ *
+ * Each job is given the index of the worker running it, so that callers can keep
+ * per-worker scratch space without any locking.
+ *
+ * @author Noam Chitayat
+ */
+class WorkerPool final
+{
+   public:
+      /** A job to run. Receives the index of the worker running it. */
+      typedef std::function<void(unsigned int)> Job;
+
+      /**
+       * The priority of a job. Queued jobs with a higher priority are always started first.
+       */
+      enum class Priority
+      {
+         /** Work that the game is waiting on this frame or the next (e.g. path requests). */
+         HIGH,
+
+         /** Background work that should be done soon (e.g. precalculating data for the current map). */
+         NORMAL,
+
+         /** Background work with no deadline. */
+         LOW,
+      };
+
+      /**
+       * A set of submitted jobs that can be waited on, without waiting on every other job in the pool.
+       * Destroying the group waits for its jobs, so jobs may safely refer to anything that outlives the group.
+       */
+      class JobGroup final
+      {
+         friend class WorkerPool;
+
+         /** The number of jobs in the group that haven't finished yet. */
+         unsigned int m_pendingJobs = 0;
+
+         /** The number of jobs in the group that have started but haven't finished yet. */
+         unsigned int m_runningJobs = 0;
+
+         /** Guards the pending and running job counts. */
+         std::mutex m_mutex;
+
+         /** Signaled when a job in the group finishes. */
+         std::condition_variable m_jobsFinished;
+
+         /**
+          * Marks a job in the group as started.
+          */
+         void startJob();
+
+         /**
+          * Marks a job in the group as finished.
+          */
+         void finishJob();
+
+         public:
+            JobGroup() = default;
+            JobGroup(const JobGroup&) = delete;
+            JobGroup& operator=(const JobGroup&) = delete;
+
+            /**
+             * Destructor. Blocks until every job in the group has finished.
+             */
+            ~JobGroup();
+
+            /**
+             * Blocks until every job in the group has finished.
+             */
+            void wait();
+
+            /**
+             * Blocks until the jobs in the group that have already started have finished.
+             * Jobs that are still queued are not waited on, so a job that may start after
+             * this returns must check for itself whether its work is still wanted.
+             */
+            void waitForRunningJobs();
+      };
+
+   private:
+      /** The number of job priorities. */
+      static const unsigned int NUM_PRIORITIES = 3;
+
+      /** The worker threads. */
+      std::vector<std::thread> m_workers;
+
+      /** The jobs that have been submitted but not yet started, for each priority. */
+      std::deque<Job> m_jobs[NUM_PRIORITIES];
+
+      /** Set when the pool is being destroyed, to signal the workers to exit once the queue is empty. */
+      bool m_stopping = false;
+
+      /** Guards the job queues. */
+      std::mutex m_mutex;
+
+      /** Signaled when a job is queued or the pool is stopping. */
+      std::condition_variable m_jobQueued;
+
+      /**
+       * @return The queue holding the highest priority jobs that are waiting to start, or nullptr if no jobs are waiting.
+       */
+      std::deque<Job>* getNextQueue();
+
+      /**
+       * The loop run by each worker thread: take the next job, run it, repeat.
+       *
+       * @param workerIndex The index of the worker.
+       */
+      void runWorker(unsigned int workerIndex);
+
+   public:
+      /**
+       * Constructor. Starts the worker threads.
+       *
+       * @param numWorkers The number of worker threads to start (at least one is always started).
+       */
+      explicit WorkerPool(unsigned int numWorkers);
+
+      WorkerPool(const WorkerPool&) = delete;
+      WorkerPool& operator=(const WorkerPool&) = delete;
+
+      /**
+       * Destructor. Runs any jobs that are still queued, then stops the worker threads.
+       */
+      ~WorkerPool();
+
+      /**
+       * @return The pool shared by the whole engine, started on first use with a worker for every core but one.
+       */
+      static WorkerPool& getSharedPool();
+
+      /**
+       * @return The number of worker threads in the pool.
+       */
+      unsigned int getNumWorkers() const;
+
+      /**
+       * Queues a job to be run by the next available worker.
+       *
+       * @param job The job to run.
+       * @param priority The priority of the job.
+       */
+      void submit(Job job, Priority priority = Priority::NORMAL);
+
+      /**
+       * Queues a job to be run by the next available worker, as part of a group of jobs.
+       *
+       * @param job The job to run.
+       * @param group The group to add the job to.
+       * @param priority The priority of the job.
+       */
+      void submit(Job job, JobGroup& group, Priority priority = Priority::NORMAL);
+};
+
+#endif